@@ -0,0 +1,213 @@
+/*
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+        Authors:    David Ducos, Percona (david dot ducos at percona dot com)
+*/
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "config.h"
+#include "bench.h"
+
+guint bench_rows = 100000;
+guint bench_columns = 10;
+guint bench_column_width = 32;
+guint bench_iterations = 5;
+guint bench_split_rows = 0;
+enum bench_charset bench_charset = BENCH_ASCII;
+
+static guint bench_seed = 1;
+static gchar *bench_output = NULL;
+static const gchar *bench_program = NULL;
+static GString *bench_results = NULL;
+
+static const gchar *charset_names[] = {"ascii", "latin1", "utf8", "binary"};
+
+static
+gboolean charset_callback(const gchar *option_name, const gchar *value, gpointer data, GError **error){
+  (void) option_name;
+  (void) data;
+  guint i;
+  for (i=0; i<G_N_ELEMENTS(charset_names); i++){
+    if (!g_ascii_strcasecmp(value, charset_names[i])){
+      bench_charset=i;
+      return TRUE;
+    }
+  }
+  g_set_error(error, G_OPTION_ERROR, G_OPTION_ERROR_BAD_VALUE, "Unknown charset %s, it must be ascii, latin1, utf8 or binary", value);
+  return FALSE;
+}
+
+static GOptionEntry bench_entries[] = {
+    {"rows", 0, 0, G_OPTION_ARG_INT, &bench_rows,
+     "Rows of the synthetic table, default 100000", NULL},
+    {"columns", 0, 0, G_OPTION_ARG_INT, &bench_columns,
+     "Columns of the synthetic table, including the integer id, default 10", NULL},
+    {"column-width", 0, 0, G_OPTION_ARG_INT, &bench_column_width,
+     "Bytes of every string column, default 32", NULL},
+    {"charset", 0, 0, G_OPTION_ARG_CALLBACK, &charset_callback,
+     "Characters of the string columns: ascii, latin1, utf8 or binary. Default ascii", NULL},
+    {"iterations", 0, 0, G_OPTION_ARG_INT, &bench_iterations,
+     "Times that every benchmark is executed, the fastest one is reported. Default 5", NULL},
+    {"split-rows", 0, 0, G_OPTION_ARG_INT, &bench_split_rows,
+     "Rows of the statements when myloader splits the INSERTs, like myloader --rows. Default 0", NULL},
+    {"seed", 0, 0, G_OPTION_ARG_INT, &bench_seed,
+     "Seed of the synthetic data, default 1", NULL},
+    {"output", 0, 0, G_OPTION_ARG_FILENAME, &bench_output,
+     "File where the JSON results are written, default stdout", NULL},
+    {NULL, 0, 0, G_OPTION_ARG_NONE, NULL, NULL, NULL}};
+
+void bench_initialize(int *argc, char ***argv, const gchar *program){
+  GError *error = NULL;
+  GOptionContext *context = g_option_context_new("microbenchmarks");
+  g_option_context_add_main_entries(context, bench_entries, NULL);
+  if (!g_option_context_parse(context, argc, argv, &error)) {
+    g_printerr("option parsing failed: %s, try --help\n", error->message);
+    exit(EXIT_FAILURE);
+  }
+  g_option_context_free(context);
+  if (bench_rows == 0 || bench_columns < 2 || bench_iterations == 0){
+    g_printerr("--rows and --iterations must be greater than 0 and --columns greater than 1\n");
+    exit(EXIT_FAILURE);
+  }
+  bench_program=program;
+  bench_results=g_string_new("");
+}
+
+/* Special characters are included to exercise the escaping */
+static const gchar ascii_chars[] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789 ,.-_";
+static const gchar special_chars[] = "'\"\\\n";
+static const gchar *utf8_chars[] = {"a", "z", "\xc3\xa9", "\xc3\xb1", "\xe2\x82\xac", "\xe4\xb8\xad", "\xf0\x9f\x98\x80"};
+
+static
+gchar *new_value(GRand *rand, gulong *length){
+  gchar *value=g_new(gchar, bench_column_width + 1);
+  guint i=0, c;
+  const gchar *s;
+  while (i < bench_column_width){
+    if (bench_charset != BENCH_BINARY && g_rand_int_range(rand, 0, 32) == 0){
+      value[i++]=special_chars[g_rand_int_range(rand, 0, sizeof(special_chars) - 1)];
+      continue;
+    }
+    switch (bench_charset){
+      case BENCH_ASCII:
+        value[i++]=ascii_chars[g_rand_int_range(rand, 0, sizeof(ascii_chars) - 1)];
+        break;
+      case BENCH_LATIN1:
+        c=g_rand_int_range(rand, 0, 95 + 96);
+        value[i++]=c < 95 ? 0x20 + c : 0xa0 + c - 95;
+        break;
+      case BENCH_UTF8:
+        s=utf8_chars[g_rand_int_range(rand, 0, G_N_ELEMENTS(utf8_chars))];
+        if (i + strlen(s) > bench_column_width)
+          s="a";
+        for (; *s; s++)
+          value[i++]=*s;
+        break;
+      case BENCH_BINARY:
+        value[i++]=g_rand_int_range(rand, 0, 256);
+        break;
+    }
+  }
+  value[i]='\0';
+  *length=i;
+  return value;
+}
+
+struct bench_table *bench_new_table(){
+  struct bench_table *table=g_new0(struct bench_table, 1);
+  GRand *rand=g_rand_new_with_seed(bench_seed);
+  guint r, c;
+  table->rows=bench_rows;
+  table->columns=bench_columns;
+  table->values=g_new(gchar **, bench_rows);
+  table->lengths=g_new(gulong *, bench_rows);
+  for (r=0; r<bench_rows; r++){
+    table->values[r]=g_new(gchar *, bench_columns);
+    table->lengths[r]=g_new(gulong, bench_columns);
+    table->values[r][0]=g_strdup_printf("%u", r + 1);
+    table->lengths[r][0]=strlen(table->values[r][0]);
+    for (c=1; c<bench_columns; c++)
+      table->values[r][c]=new_value(rand, &(table->lengths[r][c]));
+    for (c=0; c<bench_columns; c++)
+      table->bytes+=table->lengths[r][c];
+  }
+  g_rand_free(rand);
+  return table;
+}
+
+void bench_free_table(struct bench_table *table){
+  guint r, c;
+  for (r=0; r<table->rows; r++){
+    for (c=0; c<table->columns; c++)
+      g_free(table->values[r][c]);
+    g_free(table->values[r]);
+    g_free(table->lengths[r]);
+  }
+  g_free(table->values);
+  g_free(table->lengths);
+  g_free(table);
+}
+
+gint64 bench_now(){
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (gint64)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/* Executes run --iterations times and returns the nanoseconds of the fastest one */
+gint64 bench_run(void (*run)(gpointer data), gpointer data){
+  gint64 start, elapsed, best=G_MAXINT64;
+  guint i;
+  for (i=0; i<bench_iterations; i++){
+    start=bench_now();
+    run(data);
+    elapsed=bench_now() - start;
+    if (elapsed < best)
+      best=elapsed;
+  }
+  return best;
+}
+
+/* bytes are the input bytes of the benchmark, MB/s uses 10^6 bytes */
+void bench_report(const gchar *name, guint64 rows, guint64 bytes, gint64 best_ns){
+  gdouble seconds=(gdouble)best_ns / 1000000000;
+  if (bench_results->len > 0)
+    g_string_append(bench_results, ",\n");
+  g_string_append_printf(bench_results,
+      "    {\"name\": \"%s\", \"rows\": %"G_GUINT64_FORMAT", \"bytes\": %"G_GUINT64_FORMAT", \"seconds\": %.6f, \"mb_per_second\": %.2f, \"ns_per_row\": %.2f}",
+      name, rows, bytes, seconds, seconds > 0 ? bytes / seconds / 1000000 : 0, rows > 0 ? (gdouble)best_ns / rows : 0);
+  g_printerr("%s: %.2f MB/s, %.2f ns/row\n", name, seconds > 0 ? bytes / seconds / 1000000 : 0, rows > 0 ? (gdouble)best_ns / rows : 0);
+}
+
+void bench_finish(){
+  FILE *output=stdout;
+  if (bench_output){
+    output=g_fopen(bench_output, "w");
+    if (output == NULL){
+      g_printerr("Could not open %s\n", bench_output);
+      exit(EXIT_FAILURE);
+    }
+  }
+  fprintf(output, "{\n  \"program\": \"%s\",\n  \"version\": \"%s\",\n"
+                  "  \"rows\": %u,\n  \"columns\": %u,\n  \"column_width\": %u,\n  \"charset\": \"%s\",\n  \"iterations\": %u,\n  \"split_rows\": %u,\n  \"seed\": %u,\n"
+                  "  \"results\": [\n%s\n  ]\n}\n",
+          bench_program, VERSION, bench_rows, bench_columns, bench_column_width, charset_names[bench_charset], bench_iterations, bench_split_rows, bench_seed, bench_results->str);
+  if (output != stdout)
+    fclose(output);
+  g_string_free(bench_results, TRUE);
+}
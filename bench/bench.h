@@ -0,0 +1,54 @@
+/*
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+        Authors:    David Ducos, Percona (david dot ducos at percona dot com)
+*/
+#ifndef _bench_bench_h
+#define _bench_bench_h
+#include <glib.h>
+
+/*
+  Helpers shared by the microbenchmarks of the bench target.
+
+  Every benchmark runs over the same synthetic table: the first column is an
+  integer id and the others are strings of --column-width bytes made of
+  characters of --charset. The values only depend on --seed, so two runs with
+  the same options process exactly the same data and they can be compared.
+*/
+
+enum bench_charset { BENCH_ASCII, BENCH_LATIN1, BENCH_UTF8, BENCH_BINARY };
+
+struct bench_table {
+  guint rows;
+  guint columns;
+  gchar ***values;
+  gulong **lengths;
+  guint64 bytes;
+};
+
+extern guint bench_rows;
+extern guint bench_columns;
+extern guint bench_column_width;
+extern guint bench_iterations;
+extern guint bench_split_rows;
+extern enum bench_charset bench_charset;
+
+void bench_initialize(int *argc, char ***argv, const gchar *program);
+struct bench_table *bench_new_table();
+void bench_free_table(struct bench_table *table);
+gint64 bench_now();
+gint64 bench_run(void (*run)(gpointer data), gpointer data);
+void bench_report(const gchar *name, guint64 rows, guint64 bytes, gint64 best_ns);
+void bench_finish();
+#endif
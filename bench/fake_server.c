@@ -0,0 +1,1356 @@
+/*
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+        Authors:    David Ducos, Percona (david dot ducos at percona dot com)
+*/
+#include <glib.h>
+#include <gio/gio.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "config.h"
+#include "synthetic.h"
+
+/*
+  Fake MySQL server used to measure the throughput ceiling of mydumper.
+
+  It speaks the text protocol that mydumper needs: the handshake, the version
+  and variable queries, the locks and transactions, SHOW TABLE STATUS, the
+  information_schema lookups of the discovery and the MIN/MAX, EXPLAIN and
+  chunked SELECTs over the integer primary key. The statements that it does not
+  understand are answered with OK, so a new query in mydumper does not break
+  the benchmark, it just gets an empty answer.
+
+  The tables are described with --schema, --scale or with --tables, --rows
+  and --columns, see synthetic.h. Rows are generated at memory speed, so the
+  server is never the bottleneck of the dump. Tables with a UUID key return
+  string MIN/MAX values and mydumper dumps them with a full scan.
+*/
+
+#define PROTOCOL_VERSION 10
+#define SERVER_VERSION "8.0.36"
+#define SERVER_VERSION_COMMENT "MySQL Community Server - GPL (mydumper fake server)"
+#define SERVER_CHARSET 45
+#define SERVER_STATUS_AUTOCOMMIT 0x0002
+#define AUTH_PLUGIN "mysql_native_password"
+#define SCRAMBLE_LENGTH 20
+#define MAX_PACKET_LENGTH 0xffffff
+#define FLUSH_SIZE 262144
+
+#define CLIENT_LONG_PASSWORD 0x00000001
+#define CLIENT_FOUND_ROWS 0x00000002
+#define CLIENT_LONG_FLAG 0x00000004
+#define CLIENT_CONNECT_WITH_DB 0x00000008
+#define CLIENT_PROTOCOL_41 0x00000200
+#define CLIENT_TRANSACTIONS 0x00002000
+#define CLIENT_SECURE_CONNECTION 0x00008000
+#define CLIENT_MULTI_STATEMENTS 0x00010000
+#define CLIENT_MULTI_RESULTS 0x00020000
+#define CLIENT_PLUGIN_AUTH 0x00080000
+#define SERVER_CAPABILITIES (CLIENT_LONG_PASSWORD | CLIENT_FOUND_ROWS | CLIENT_LONG_FLAG | CLIENT_CONNECT_WITH_DB | \
+                             CLIENT_PROTOCOL_41 | CLIENT_TRANSACTIONS | CLIENT_SECURE_CONNECTION | \
+                             CLIENT_MULTI_STATEMENTS | CLIENT_MULTI_RESULTS | CLIENT_PLUGIN_AUTH)
+
+#define COM_QUIT 0x01
+#define COM_INIT_DB 0x02
+#define COM_QUERY 0x03
+#define COM_FIELD_LIST 0x04
+#define COM_PING 0x0e
+#define COM_SET_OPTION 0x1b
+
+#define TYPE_LONG 3
+#define TYPE_LONGLONG 8
+#define TYPE_DATETIME 12
+#define TYPE_NEWDECIMAL 246
+#define TYPE_BLOB 252
+#define TYPE_VAR_STRING 253
+#define TYPE_STRING 254
+
+#define FLAG_NOT_NULL 0x0001
+#define FLAG_PRIMARY_KEY 0x0002
+#define FLAG_BLOB 0x0010
+#define FLAG_UNSIGNED 0x0020
+#define FLAG_BINARY 0x0080
+
+#define CHARSET_BINARY 63
+
+/* Column of a result set, only what the client library needs */
+struct result_column {
+  const gchar *name;
+  guint8 type;
+  guint16 flags;
+  guint16 charset;
+  guint32 length;
+};
+
+struct client {
+  guint id;
+  GSocketConnection *connection;
+  GInputStream *input;
+  GOutputStream *output;
+  GString *out;
+  guint8 sequence;
+  gchar *database;
+  gboolean failed;
+};
+
+static guint port = 3307;
+static gchar *address = NULL;
+static gchar *schema_file = NULL;
+static gchar *database_name = NULL;
+static guint table_count = 4;
+static guint64 table_rows = 100000;
+static guint64 key_step = 1;
+static gdouble scale = 0;
+static gchar *column_list = NULL;
+static gboolean log_queries = FALSE;
+
+static volatile gint connection_counter = 0;
+
+static GRegex *from_regex = NULL;
+static GRegex *range_regex = NULL;
+static GRegex *equal_regex = NULL;
+static GRegex *limit_regex = NULL;
+static GRegex *condition_regex = NULL;
+static GRegex *like_regex = NULL;
+
+static GOptionEntry entries[] = {
+    {"port", 'P', 0, G_OPTION_ARG_INT, &port,
+     "TCP port to listen on, default 3307", NULL},
+    {"address", 0, 0, G_OPTION_ARG_STRING, &address,
+     "Address to listen on, default 127.0.0.1", NULL},
+    {"schema", 0, 0, G_OPTION_ARG_FILENAME, &schema_file,
+     "Key file with a [database.table] section per table, with rows, key_step and columns", NULL},
+    {"database", 'B', 0, G_OPTION_ARG_STRING, &database_name,
+     "Database of the tables when --schema is not used, default bench", NULL},
+    {"tables", 0, 0, G_OPTION_ARG_INT, &table_count,
+     "Tables when --schema is not used, default 4", NULL},
+    {"rows", 'r', 0, G_OPTION_ARG_INT64, &table_rows,
+     "Rows of every table when --schema is not used, default 100000", NULL},
+    {"key-step", 0, 0, G_OPTION_ARG_INT64, &key_step,
+     "Distance between two consecutive ids, a value greater than 1 makes sparse keys. Default 1", NULL},
+    {"columns", 0, 0, G_OPTION_ARG_STRING, &column_list,
+     "Comma separated types of the columns after the id: int, bigint, decimal, datetime, char(n), varchar(n), uuid and blob(n). "
+     "Default int,bigint,decimal,datetime,varchar(32),varchar(255)", NULL},
+    {"scale", 0, 0, G_OPTION_ARG_DOUBLE, &scale,
+     "Serve about 1GB and 100 small tables per unit of scale instead of --tables, --rows and --columns", NULL},
+    {"log-queries", 0, 0, G_OPTION_ARG_NONE, &log_queries,
+     "Log every query received", NULL},
+    {NULL, 0, 0, G_OPTION_ARG_NONE, NULL, NULL, NULL}};
+
+/* Packets */
+
+static
+void flush_client(struct client *c){
+  GError *error=NULL;
+  if (c->out->len == 0 || c->failed)
+    return;
+  if (!g_output_stream_write_all(c->output, c->out->str, c->out->len, NULL, NULL, &error)){
+    g_warning("Connection %u: write failed: %s", c->id, error->message);
+    g_error_free(error);
+    c->failed=TRUE;
+  }
+  g_string_set_size(c->out, 0);
+}
+
+static inline
+gsize packet_begin(struct client *c){
+  gsize start=c->out->len;
+  g_string_append_len(c->out, "\0\0\0\0", 4);
+  return start;
+}
+
+static inline
+void packet_end(struct client *c, gsize start){
+  gsize length=c->out->len - start - 4;
+  c->out->str[start]=length & 0xff;
+  c->out->str[start + 1]=(length >> 8) & 0xff;
+  c->out->str[start + 2]=(length >> 16) & 0xff;
+  c->out->str[start + 3]=c->sequence++;
+  if (c->out->len >= FLUSH_SIZE)
+    flush_client(c);
+}
+
+static inline
+void append_int(GString *s, guint64 value, guint bytes){
+  guint i;
+  for (i=0; i<bytes; i++)
+    g_string_append_c(s, (value >> (8 * i)) & 0xff);
+}
+
+static inline
+void append_lenenc_int(GString *s, guint64 value){
+  if (value < 251){
+    g_string_append_c(s, value);
+  }else if (value < 65536){
+    g_string_append_c(s, 0xfc);
+    append_int(s, value, 2);
+  }else if (value < 16777216){
+    g_string_append_c(s, 0xfd);
+    append_int(s, value, 3);
+  }else{
+    g_string_append_c(s, 0xfe);
+    append_int(s, value, 8);
+  }
+}
+
+static inline
+void append_lenenc_string(GString *s, const gchar *value, gsize length){
+  if (value == NULL){
+    g_string_append_c(s, 0xfb);
+    return;
+  }
+  append_lenenc_int(s, length);
+  g_string_append_len(s, value, length);
+}
+
+static inline
+void append_lenenc_str(GString *s, const gchar *value){
+  append_lenenc_string(s, value, value ? strlen(value) : 0);
+}
+
+static
+void send_ok(struct client *c, guint64 affected_rows){
+  gsize p=packet_begin(c);
+  g_string_append_c(c->out, 0x00);
+  append_lenenc_int(c->out, affected_rows);
+  append_lenenc_int(c->out, 0);
+  append_int(c->out, SERVER_STATUS_AUTOCOMMIT, 2);
+  append_int(c->out, 0, 2);
+  packet_end(c, p);
+}
+
+static
+void send_eof(struct client *c){
+  gsize p=packet_begin(c);
+  g_string_append_c(c->out, 0xfe);
+  append_int(c->out, 0, 2);
+  append_int(c->out, SERVER_STATUS_AUTOCOMMIT, 2);
+  packet_end(c, p);
+}
+
+static
+void send_error(struct client *c, guint16 code, const gchar *state, const gchar *format, ...){
+  va_list args;
+  gsize p=packet_begin(c);
+  g_string_append_c(c->out, 0xff);
+  append_int(c->out, code, 2);
+  g_string_append_c(c->out, '#');
+  g_string_append_len(c->out, state, 5);
+  va_start(args, format);
+  g_string_append_vprintf(c->out, format, args);
+  va_end(args);
+  packet_end(c, p);
+}
+
+static
+void send_columns(struct client *c, const gchar *table, const struct result_column *columns, guint n){
+  gsize p;
+  guint i;
+  p=packet_begin(c);
+  append_lenenc_int(c->out, n);
+  packet_end(c, p);
+  for (i=0; i<n; i++){
+    p=packet_begin(c);
+    append_lenenc_str(c->out, "def");
+    append_lenenc_str(c->out, "");
+    append_lenenc_str(c->out, table);
+    append_lenenc_str(c->out, table);
+    append_lenenc_str(c->out, columns[i].name);
+    append_lenenc_str(c->out, columns[i].name);
+    g_string_append_c(c->out, 0x0c);
+    append_int(c->out, columns[i].charset ? columns[i].charset : SERVER_CHARSET, 2);
+    append_int(c->out, columns[i].length ? columns[i].length : 255, 4);
+    g_string_append_c(c->out, columns[i].type ? columns[i].type : TYPE_VAR_STRING);
+    append_int(c->out, columns[i].flags, 2);
+    g_string_append_c(c->out, 0);
+    append_int(c->out, 0, 2);
+    packet_end(c, p);
+  }
+  send_eof(c);
+}
+
+/* Result set of strings, names is NULL terminated */
+static
+void send_string_columns(struct client *c, const gchar **names){
+  struct result_column columns[32];
+  guint n=0;
+  memset(columns, 0, sizeof(columns));
+  for (n=0; names[n] != NULL && n < G_N_ELEMENTS(columns); n++)
+    columns[n].name=names[n];
+  send_columns(c, "", columns, n);
+}
+
+static
+void send_string_row(struct client *c, const gchar **values, guint n){
+  gsize p=packet_begin(c);
+  guint i;
+  for (i=0; i<n; i++)
+    append_lenenc_str(c->out, values[i]);
+  packet_end(c, p);
+}
+
+/* Result set of one row */
+static
+void send_single_row(struct client *c, const gchar **names, const gchar **values){
+  guint n=0;
+  while (names[n] != NULL)
+    n++;
+  send_string_columns(c, names);
+  send_string_row(c, values, n);
+  send_eof(c);
+}
+
+static
+void send_empty_result(struct client *c, const gchar **names){
+  send_string_columns(c, names);
+  send_eof(c);
+}
+
+/* Values */
+
+static
+void result_column_of(struct synthetic_column *column, struct result_column *rc){
+  memset(rc, 0, sizeof(*rc));
+  rc->name=column->name;
+  switch (column->kind){
+    case SYNTHETIC_KEY:
+      rc->type=TYPE_LONGLONG;
+      rc->flags=FLAG_NOT_NULL | FLAG_PRIMARY_KEY | FLAG_UNSIGNED;
+      rc->charset=CHARSET_BINARY;
+      rc->length=20;
+      break;
+    case SYNTHETIC_INT:
+      rc->type=TYPE_LONG;
+      rc->charset=CHARSET_BINARY;
+      rc->length=11;
+      break;
+    case SYNTHETIC_BIGINT:
+      rc->type=TYPE_LONGLONG;
+      rc->charset=CHARSET_BINARY;
+      rc->length=20;
+      break;
+    case SYNTHETIC_DECIMAL:
+      rc->type=TYPE_NEWDECIMAL;
+      rc->charset=CHARSET_BINARY;
+      rc->length=12;
+      break;
+    case SYNTHETIC_DATETIME:
+      rc->type=TYPE_DATETIME;
+      rc->flags=FLAG_BINARY;
+      rc->charset=CHARSET_BINARY;
+      rc->length=19;
+      break;
+    case SYNTHETIC_UUID:
+    case SYNTHETIC_CHAR:
+      rc->type=TYPE_STRING;
+      rc->length=column->length * 4;
+      break;
+    case SYNTHETIC_VARCHAR:
+      rc->type=TYPE_VAR_STRING;
+      rc->length=column->length * 4;
+      break;
+    case SYNTHETIC_BLOB:
+      rc->type=TYPE_BLOB;
+      rc->flags=FLAG_BLOB | FLAG_BINARY;
+      rc->charset=CHARSET_BINARY;
+      rc->length=65535;
+      break;
+  }
+}
+
+/* Query parsing */
+
+static
+gchar *regex_group(GMatchInfo *match_info, gint group){
+  gchar *s=g_match_info_fetch(match_info, group);
+  if (s != NULL && *s == '\0'){
+    g_free(s);
+    return NULL;
+  }
+  return s;
+}
+
+/* The first `db`.`table` or `table` after FROM */
+static
+struct synthetic_table *table_of_query(struct client *c, const gchar *query){
+  GMatchInfo *match_info=NULL;
+  struct synthetic_table *table=NULL;
+  gchar *database=NULL, *name=NULL;
+  if (g_regex_match(from_regex, query, 0, &match_info)){
+    database=regex_group(match_info, 1);
+    name=regex_group(match_info, 2);
+    table=synthetic_find_table(database ? database : c->database ? c->database : "", name);
+    g_free(database);
+    g_free(name);
+  }
+  g_match_info_free(match_info);
+  return table;
+}
+
+/* Rows of table between first and last, from the conditions over `id` */
+static
+void rows_of_query(struct synthetic_table *table, const gchar *query, guint64 *first, guint64 *last){
+  GMatchInfo *match_info=NULL;
+  gchar *s=NULL;
+  guint64 low=0, high=G_MAXUINT64, value;
+  g_regex_match(range_regex, query, 0, &match_info);
+  while (g_match_info_matches(match_info)){
+    s=g_match_info_fetch(match_info, 1);
+    value=g_ascii_strtoull(s, NULL, 10);
+    g_free(s);
+    if (value > low)
+      low=value;
+    s=g_match_info_fetch(match_info, 2);
+    value=g_ascii_strtoull(s, NULL, 10);
+    g_free(s);
+    if (value < high)
+      high=value;
+    g_match_info_next(match_info, NULL);
+  }
+  g_match_info_free(match_info);
+  g_regex_match(equal_regex, query, 0, &match_info);
+  while (g_match_info_matches(match_info)){
+    s=g_match_info_fetch(match_info, 1);
+    value=g_ascii_strtoull(s, NULL, 10);
+    g_free(s);
+    if (value > low)
+      low=value;
+    if (value < high)
+      high=value;
+    g_match_info_next(match_info, NULL);
+  }
+  g_match_info_free(match_info);
+  // ids are 1 + row * key_step
+  *first=low <= 1 ? 0 : (low - 1 + table->key_step - 1) / table->key_step;
+  *last=high == 0 ? 0 : (high - 1) / table->key_step + 1;
+  if (*last > table->rows)
+    *last=table->rows;
+  if (*first > *last || high == 0)
+    *first=*last;
+}
+
+static
+guint64 limit_of_query(const gchar *query){
+  GMatchInfo *match_info=NULL;
+  gchar *s=NULL;
+  guint64 limit=G_MAXUINT64;
+  if (g_regex_match(limit_regex, query, 0, &match_info)){
+    s=g_match_info_fetch(match_info, 1);
+    limit=g_ascii_strtoull(s, NULL, 10);
+    g_free(s);
+  }
+  g_match_info_free(match_info);
+  return limit;
+}
+
+/* The expressions between SELECT and FROM, without the comments */
+static
+gchar **projection_of_query(const gchar *query){
+  const gchar *start=query + strlen("SELECT"), *end=NULL;
+  gchar *projection=NULL, *comment=NULL, *comment_end=NULL, **items=NULL;
+  guint i, depth=0;
+  gchar *p;
+  end=strstr(start, " FROM ");
+  if (end == NULL)
+    end=strstr(start, " from ");
+  projection=end ? g_strndup(start, end - start) : g_strdup(start);
+  while ((comment=strstr(projection, "/*")) != NULL && (comment_end=strstr(comment, "*/")) != NULL)
+    memmove(comment, comment_end + 2, strlen(comment_end + 2) + 1);
+  // Commas inside functions do not split the expressions
+  for (p=projection; *p; p++){
+    if (*p == '(')
+      depth++;
+    else if (*p == ')' && depth > 0)
+      depth--;
+    else if (*p == ',' && depth > 0)
+      *p='\x01';
+  }
+  items=g_strsplit(projection, ",", 0);
+  for (i=0; items[i] != NULL; i++){
+    g_strdelimit(items[i], "\x01", ',');
+    g_strstrip(items[i]);
+    if (!g_ascii_strncasecmp(items[i], "DISTINCT ", 9))
+      memmove(items[i], items[i] + 9, strlen(items[i] + 9) + 1);
+  }
+  g_free(projection);
+  return items;
+}
+
+static
+const gchar *unquote(gchar *name){
+  g_strdelimit(name, "`\"", ' ');
+  return g_strstrip(name);
+}
+
+/* information_schema */
+
+enum is_table {
+  IS_COLUMNS,
+  IS_STATISTICS,
+  IS_TABLES,
+  IS_COLLATIONS,
+  IS_OTHER
+};
+
+static const gchar *is_columns_names[] = {"TABLE_SCHEMA", "TABLE_NAME", "COLUMN_NAME", "ORDINAL_POSITION", "COLUMN_TYPE", "DATA_TYPE", "COLUMN_KEY", "EXTRA", NULL};
+static const gchar *is_statistics_names[] = {"TABLE_SCHEMA", "TABLE_NAME", "INDEX_NAME", "NON_UNIQUE", "SEQ_IN_INDEX", "COLUMN_NAME", "CARDINALITY", NULL};
+static const gchar *is_tables_names[] = {"TABLE_SCHEMA", "TABLE_NAME", "TABLE_TYPE", "ENGINE", "TABLE_ROWS", "DATA_LENGTH", "UPDATE_TIME", NULL};
+static const gchar *is_collations_names[] = {"COLLATION_NAME", "CHARACTER_SET_NAME", NULL};
+
+static const gchar *collations[][2] = {
+  {"utf8mb4_0900_ai_ci", "utf8mb4"}, {"utf8mb4_general_ci", "utf8mb4"}, {"utf8mb4_bin", "utf8mb4"},
+  {"utf8mb3_general_ci", "utf8mb3"}, {"latin1_swedish_ci", "latin1"}, {"binary", "binary"}};
+
+struct is_filter {
+  gchar *column;
+  gchar *value;
+  GPatternSpec *pattern;
+  gboolean negate;
+};
+
+static
+gint column_index(const gchar **names, const gchar *name){
+  gint i;
+  for (i=0; names[i] != NULL; i++)
+    if (!g_ascii_strcasecmp(names[i], name))
+      return i;
+  return -1;
+}
+
+/* Conditions like COLUMN='value', COLUMN<>'value' and COLUMN [NOT] LIKE 'pattern' */
+static
+GList *filters_of_query(const gchar *query){
+  GMatchInfo *match_info=NULL;
+  GList *filters=NULL;
+  struct is_filter *f=NULL;
+  gchar *op=NULL, *pattern=NULL;
+  g_regex_match(condition_regex, query, 0, &match_info);
+  while (g_match_info_matches(match_info)){
+    f=g_new0(struct is_filter, 1);
+    f->column=g_match_info_fetch(match_info, 1);
+    op=g_match_info_fetch(match_info, 2);
+    f->value=g_match_info_fetch(match_info, 3);
+    f->negate=!g_strcmp0(op, "<>") || !g_strcmp0(op, "!=");
+    filters=g_list_prepend(filters, f);
+    g_free(op);
+    g_match_info_next(match_info, NULL);
+  }
+  g_match_info_free(match_info);
+  g_regex_match(like_regex, query, 0, &match_info);
+  while (g_match_info_matches(match_info)){
+    f=g_new0(struct is_filter, 1);
+    f->column=g_match_info_fetch(match_info, 1);
+    op=g_match_info_fetch(match_info, 2);
+    f->negate=op != NULL && *op != '\0';
+    pattern=g_match_info_fetch(match_info, 3);
+    g_strdelimit(pattern, "%", '*');
+    f->pattern=g_pattern_spec_new(pattern);
+    filters=g_list_prepend(filters, f);
+    g_free(op);
+    g_free(pattern);
+    g_match_info_next(match_info, NULL);
+  }
+  g_match_info_free(match_info);
+  return filters;
+}
+
+static
+void free_filter(struct is_filter *f){
+  g_free(f->column);
+  g_free(f->value);
+  if (f->pattern)
+    g_pattern_spec_free(f->pattern);
+  g_free(f);
+}
+
+static
+gboolean row_matches(const gchar **names, const gchar **values, GList *filters){
+  struct is_filter *f=NULL;
+  gchar *upper=NULL;
+  gboolean match;
+  gint i;
+  for (; filters != NULL; filters=filters->next){
+    f=filters->data;
+    i=column_index(names, f->column);
+    if (i < 0)
+      continue;
+    if (f->pattern){
+      upper=g_ascii_strup(values[i] ? values[i] : "", -1);
+      match=g_pattern_match_string(f->pattern, values[i] ? values[i] : "") || g_pattern_match_string(f->pattern, upper);
+      g_free(upper);
+    }else{
+      match=values[i] != NULL && !g_ascii_strcasecmp(values[i], f->value);
+    }
+    if (match == f->negate)
+      return FALSE;
+  }
+  return TRUE;
+}
+
+static
+void send_is_row(struct client *c, const gchar **names, const gchar **values, gchar **projection, GList *filters){
+  const gchar *row[32];
+  gint i, j;
+  if (!row_matches(names, values, filters))
+    return;
+  for (i=0; projection[i] != NULL && i < 32; i++){
+    j=column_index(names, projection[i]);
+    row[i]=j < 0 ? NULL : values[j];
+  }
+  send_string_row(c, row, i);
+}
+
+static
+void handle_information_schema(struct client *c, const gchar *query){
+  gchar **projection=projection_of_query(query);
+  GList *filters=filters_of_query(query);
+  enum is_table ist=IS_OTHER;
+  const gchar **names=NULL;
+  const gchar *values[8];
+  gchar position[16], rows[24], data_length[24];
+  struct synthetic_table *table=NULL;
+  struct synthetic_column *column=NULL;
+  guint i, j;
+  gchar *upper=g_ascii_strup(query, -1);
+  if (strstr(upper, "INFORMATION_SCHEMA.COLUMNS")){
+    ist=IS_COLUMNS;
+    names=is_columns_names;
+  }else if (strstr(upper, "INFORMATION_SCHEMA.STATISTICS")){
+    ist=IS_STATISTICS;
+    names=is_statistics_names;
+  }else if (strstr(upper, "INFORMATION_SCHEMA.TABLES")){
+    ist=IS_TABLES;
+    names=is_tables_names;
+  }else if (strstr(upper, "INFORMATION_SCHEMA.COLLATIONS")){
+    ist=IS_COLLATIONS;
+    names=is_collations_names;
+  }
+  g_free(upper);
+  for (i=0; projection[i] != NULL; i++)
+    unquote(projection[i]);
+  send_string_columns(c, (const gchar **)projection);
+  switch (ist){
+    case IS_COLUMNS:
+      for (i=0; i<synthetic_tables->len; i++){
+        table=g_ptr_array_index(synthetic_tables, i);
+        for (j=0; j<table->columns->len; j++){
+          column=g_ptr_array_index(table->columns, j);
+          g_snprintf(position, sizeof(position), "%u", j + 1);
+          values[0]=table->database;
+          values[1]=table->name;
+          values[2]=column->name;
+          values[3]=position;
+          values[4]=column->sql_type;
+          values[5]=column->sql_type;
+          values[6]=j == 0 ? "PRI" : "";
+          values[7]="";
+          send_is_row(c, names, values, projection, filters);
+        }
+      }
+      break;
+    case IS_STATISTICS:
+      for (i=0; i<synthetic_tables->len; i++){
+        table=g_ptr_array_index(synthetic_tables, i);
+        g_snprintf(rows, sizeof(rows), "%"G_GUINT64_FORMAT, table->rows);
+        values[0]=table->database;
+        values[1]=table->name;
+        values[2]="PRIMARY";
+        values[3]="0";
+        values[4]="1";
+        values[5]="id";
+        values[6]=rows;
+        send_is_row(c, names, values, projection, filters);
+      }
+      break;
+    case IS_TABLES:
+      for (i=0; i<synthetic_tables->len; i++){
+        table=g_ptr_array_index(synthetic_tables, i);
+        g_snprintf(rows, sizeof(rows), "%"G_GUINT64_FORMAT, table->rows);
+        g_snprintf(data_length, sizeof(data_length), "%"G_GUINT64_FORMAT, table->rows * 128);
+        values[0]=table->database;
+        values[1]=table->name;
+        values[2]="BASE TABLE";
+        values[3]="InnoDB";
+        values[4]=rows;
+        values[5]=data_length;
+        values[6]=NULL;
+        send_is_row(c, names, values, projection, filters);
+      }
+      break;
+    case IS_COLLATIONS:
+      for (i=0; i<G_N_ELEMENTS(collations); i++)
+        send_is_row(c, names, collations[i], projection, filters);
+      break;
+    case IS_OTHER:
+      // Triggers, routines, events, views: there are none
+      break;
+  }
+  send_eof(c);
+  g_list_free_full(filters, (GDestroyNotify)&free_filter);
+  g_strfreev(projection);
+}
+
+/* Variables */
+
+static const gchar *variables[][2] = {
+  {"version", SERVER_VERSION},
+  {"version_comment", SERVER_VERSION_COMMENT},
+  {"sql_mode", "ONLY_FULL_GROUP_BY,STRICT_TRANS_TABLES,NO_ZERO_IN_DATE,NO_ZERO_DATE,ERROR_FOR_DIVISION_BY_ZERO,NO_ENGINE_SUBSTITUTION"},
+  {"hostname", "fake_server"},
+  {"server_id", "1"},
+  {"datadir", "/var/lib/mysql/"},
+  {"character_set_client", "utf8mb4"},
+  {"character_set_results", "utf8mb4"},
+  {"character_set_server", "utf8mb4"},
+  {"collation_server", "utf8mb4_0900_ai_ci"},
+  {"time_zone", "SYSTEM"},
+  {"max_allowed_packet", "67108864"},
+  {"net_write_timeout", "60"},
+  {"wait_timeout", "28800"},
+  {"lower_case_table_names", "0"},
+  {"autocommit", "1"},
+  {"gtid_mode", "OFF"},
+  {"log_bin", "1"},
+  {"innodb_page_size", "16384"},
+  {"foreign_key_checks", "1"},
+  {"unique_checks", "1"}};
+
+static
+void handle_variables(struct client *c, const gchar *query){
+  gchar **projection=projection_of_query(query);
+  const gchar *values[32];
+  gchar *name=NULL;
+  guint j, n=0;
+  for (n=0; projection[n] != NULL && n < G_N_ELEMENTS(values); n++){
+    name=projection[n];
+    while (*name == '@')
+      name++;
+    if (!g_ascii_strncasecmp(name, "SESSION.", 8))
+      name+=8;
+    else if (!g_ascii_strncasecmp(name, "GLOBAL.", 7))
+      name+=7;
+    values[n]=NULL;
+    for (j=0; j<G_N_ELEMENTS(variables); j++)
+      if (!g_ascii_strcasecmp(name, variables[j][0]))
+        values[n]=variables[j][1];
+    if (values[n] == NULL){
+      send_error(c, 1193, "HY000", "Unknown system variable '%s'", name);
+      g_strfreev(projection);
+      return;
+    }
+  }
+  send_string_columns(c, (const gchar **)projection);
+  send_string_row(c, values, n);
+  send_eof(c);
+  g_strfreev(projection);
+}
+
+/* SHOW */
+
+static
+void handle_show_table_status(struct client *c, const gchar *query){
+  static const gchar *names[] = {"Name", "Engine", "Version", "Row_format", "Rows", "Avg_row_length", "Data_length",
+                                 "Max_data_length", "Index_length", "Data_free", "Auto_increment", "Create_time",
+                                 "Update_time", "Check_time", "Collation", "Checksum", "Create_options", "Comment", NULL};
+  const gchar *values[18];
+  GMatchInfo *match_info=NULL;
+  gchar *database=NULL, *like=NULL, rows[24], data_length[24], auto_increment[24];
+  GPatternSpec *pattern=NULL;
+  struct synthetic_table *table=NULL;
+  guint i;
+  if (g_regex_match(from_regex, query, 0, &match_info)){
+    // SHOW TABLE STATUS FROM `db`, the table group is the database
+    database=regex_group(match_info, 2);
+  }
+  g_match_info_free(match_info);
+  match_info=NULL;
+  if (g_regex_match(like_regex, query, 0, &match_info)){
+    like=g_match_info_fetch(match_info, 3);
+    g_strdelimit(like, "%", '*');
+    pattern=g_pattern_spec_new(like);
+    g_free(like);
+  }
+  g_match_info_free(match_info);
+  send_string_columns(c, names);
+  for (i=0; i<synthetic_tables->len; i++){
+    table=g_ptr_array_index(synthetic_tables, i);
+    if (g_strcmp0(table->database, database ? database : c->database))
+      continue;
+    if (pattern && !g_pattern_match_string(pattern, table->name))
+      continue;
+    g_snprintf(rows, sizeof(rows), "%"G_GUINT64_FORMAT, table->rows);
+    g_snprintf(data_length, sizeof(data_length), "%"G_GUINT64_FORMAT, table->rows * 128);
+    g_snprintf(auto_increment, sizeof(auto_increment), "%"G_GUINT64_FORMAT, synthetic_key_of_row(table, table->rows));
+    values[0]=table->name;
+    values[1]="InnoDB";
+    values[2]="10";
+    values[3]="Dynamic";
+    values[4]=rows;
+    values[5]="128";
+    values[6]=data_length;
+    values[7]="0";
+    values[8]="0";
+    values[9]="0";
+    values[10]=auto_increment;
+    values[11]="2024-01-01 00:00:00";
+    values[12]=NULL;
+    values[13]=NULL;
+    values[14]="utf8mb4_0900_ai_ci";
+    values[15]=NULL;
+    values[16]="";
+    values[17]="";
+    send_string_row(c, values, 18);
+  }
+  send_eof(c);
+  if (pattern)
+    g_pattern_spec_free(pattern);
+  g_free(database);
+}
+
+static
+void handle_show(struct client *c, const gchar *query){
+  static const gchar *database_names[] = {"Database", NULL};
+  static const gchar *create_database_names[] = {"Database", "Create Database", NULL};
+  static const gchar *create_table_names[] = {"Table", "Create Table", NULL};
+  static const gchar *index_names[] = {"Table", "Non_unique", "Key_name", "Seq_in_index", "Column_name", "Collation",
+                                       "Cardinality", "Sub_part", "Packed", "Null", "Index_type", "Comment", NULL};
+  static const gchar *field_names[] = {"Field", "Type", "Null", "Key", "Default", "Extra", NULL};
+  static const gchar *processlist_names[] = {"Id", "User", "Host", "db", "Command", "Time", "State", "Info", NULL};
+  static const gchar *master_names[] = {"File", "Position", "Binlog_Do_DB", "Binlog_Ignore_DB", "Executed_Gtid_Set", NULL};
+  static const gchar *master_values[] = {"binlog.000001", "157", "", "", ""};
+  static const gchar *variable_names[] = {"Variable_name", "Value", NULL};
+  const gchar *values[12];
+  const gchar *rest=query + strlen("SHOW ");
+  struct synthetic_table *table=NULL;
+  struct synthetic_column *column=NULL;
+  gchar *statement=NULL, *database=NULL, rows[24];
+  guint i;
+  if (!g_ascii_strncasecmp(rest, "FULL ", 5))
+    rest+=5;
+  if (!g_ascii_strncasecmp(rest, "DATABASES", 9)){
+    send_string_columns(c, database_names);
+    for (i=0; i<synthetic_databases->len; i++){
+      values[0]=g_ptr_array_index(synthetic_databases, i);
+      send_string_row(c, values, 1);
+    }
+    send_eof(c);
+  }else if (!g_ascii_strncasecmp(rest, "TABLE STATUS", 12)){
+    handle_show_table_status(c, query);
+  }else if (!g_ascii_strncasecmp(rest, "CREATE DATABASE", 15)){
+    database=g_strdup(rest + 15);
+    if (!g_ascii_strncasecmp(g_strstrip(database), "IF NOT EXISTS", 13))
+      memmove(database, database + 13, strlen(database + 13) + 1);
+    unquote(database);
+    if (!synthetic_database_exists(database)){
+      send_error(c, 1049, "42000", "Unknown database '%s'", database);
+    }else{
+      statement=g_strdup_printf("CREATE DATABASE /*!32312 IF NOT EXISTS*/ `%s` /*!40100 DEFAULT CHARACTER SET utf8mb4 COLLATE utf8mb4_0900_ai_ci */ /*!80016 DEFAULT ENCRYPTION='N' */", database);
+      values[0]=database;
+      values[1]=statement;
+      send_single_row(c, create_database_names, values);
+      g_free(statement);
+    }
+    g_free(database);
+  }else if (!g_ascii_strncasecmp(rest, "CREATE TABLE", 12)){
+    // SHOW CREATE TABLE `db`.`table` has the same form than FROM `db`.`table`
+    statement=g_strdup_printf("FROM %s", rest + 12);
+    table=table_of_query(c, statement);
+    g_free(statement);
+    if (table == NULL){
+      send_error(c, 1146, "42S02", "Table doesn't exist");
+    }else{
+      statement=synthetic_create_table(table);
+      values[0]=table->name;
+      values[1]=statement;
+      send_single_row(c, create_table_names, values);
+      g_free(statement);
+    }
+  }else if (!g_ascii_strncasecmp(rest, "INDEX", 5) || !g_ascii_strncasecmp(rest, "KEYS", 4)){
+    table=table_of_query(c, query);
+    send_string_columns(c, index_names);
+    if (table){
+      g_snprintf(rows, sizeof(rows), "%"G_GUINT64_FORMAT, table->rows);
+      values[0]=table->name;
+      values[1]="0";
+      values[2]="PRIMARY";
+      values[3]="1";
+      values[4]="id";
+      values[5]="A";
+      values[6]=rows;
+      values[7]=NULL;
+      values[8]=NULL;
+      values[9]="";
+      values[10]="BTREE";
+      values[11]="";
+      send_string_row(c, values, 12);
+    }
+    send_eof(c);
+  }else if (!g_ascii_strncasecmp(rest, "FIELDS", 6) || !g_ascii_strncasecmp(rest, "COLUMNS", 7)){
+    table=table_of_query(c, query);
+    send_string_columns(c, field_names);
+    for (i=0; table && i<table->columns->len; i++){
+      column=g_ptr_array_index(table->columns, i);
+      values[0]=column->name;
+      values[1]=column->sql_type;
+      values[2]=i == 0 ? "NO" : "YES";
+      values[3]=i == 0 ? "PRI" : "";
+      values[4]=NULL;
+      values[5]="";
+      send_string_row(c, values, 6);
+    }
+    send_eof(c);
+  }else if (!g_ascii_strncasecmp(rest, "PROCESSLIST", 11)){
+    send_empty_result(c, processlist_names);
+  }else if (!g_ascii_strncasecmp(rest, "MASTER STATUS", 13) || !g_ascii_strncasecmp(rest, "BINARY LOG STATUS", 17)){
+    send_single_row(c, master_names, master_values);
+  }else{
+    // SHOW SLAVE STATUS, SHOW WARNINGS, SHOW VARIABLES, SHOW TRIGGERS...
+    send_empty_result(c, variable_names);
+  }
+}
+
+/* SELECT over a fake table */
+
+static
+void handle_explain(struct client *c, const gchar *query){
+  static const gchar *names[] = {"id", "select_type", "table", "partitions", "type", "possible_keys", "key",
+                                 "key_len", "ref", "rows", "filtered", "Extra", NULL};
+  const gchar *values[12];
+  struct synthetic_table *table=table_of_query(c, query);
+  guint64 first=0, last=0;
+  gchar rows[24];
+  if (table == NULL){
+    send_error(c, 1146, "42S02", "Table doesn't exist");
+    return;
+  }
+  rows_of_query(table, query, &first, &last);
+  g_snprintf(rows, sizeof(rows), "%"G_GUINT64_FORMAT, last - first);
+  values[0]="1";
+  values[1]="SIMPLE";
+  values[2]=table->name;
+  values[3]=NULL;
+  values[4]="range";
+  values[5]="PRIMARY";
+  values[6]="PRIMARY";
+  values[7]="8";
+  values[8]=NULL;
+  values[9]=rows;
+  values[10]="100.00";
+  values[11]="Using where";
+  send_single_row(c, names, values);
+}
+
+/* MIN(), MAX(), LEFT(MIN(),1), LEFT(MAX(),1) and COUNT(*) return a single row */
+static
+void handle_aggregate(struct client *c, struct synthetic_table *table, gchar **projection, guint64 first, guint64 last){
+  struct result_column columns[32];
+  const gchar *values[32];
+  gchar buffers[32][64];
+  struct synthetic_column *key=g_ptr_array_index(table->columns, 0);
+  const gchar *value=NULL;
+  gsize length=0;
+  guint n;
+  memset(columns, 0, sizeof(columns));
+  for (n=0; projection[n] != NULL && n < G_N_ELEMENTS(columns); n++){
+    columns[n].name=projection[n];
+    values[n]=NULL;
+    if (!g_ascii_strncasecmp(projection[n], "COUNT(", 6)){
+      columns[n].type=TYPE_LONGLONG;
+      columns[n].charset=CHARSET_BINARY;
+      g_snprintf(buffers[n], sizeof(buffers[n]), "%"G_GUINT64_FORMAT, last - first);
+      values[n]=buffers[n];
+    }else if (key->kind != SYNTHETIC_KEY && (!g_ascii_strncasecmp(projection[n], "MIN(", 4) || !g_ascii_strncasecmp(projection[n], "MAX(", 4))){
+      columns[n].type=TYPE_STRING;
+      if (first < last){
+        synthetic_value(key, 0, synthetic_key_of_row(table, !g_ascii_strncasecmp(projection[n], "MIN(", 4) ? first : last - 1),
+                        buffers[n], sizeof(buffers[n]), &value, &length);
+        values[n]=buffers[n];
+      }
+    }else if (!g_ascii_strncasecmp(projection[n], "MIN(", 4) || !g_ascii_strncasecmp(projection[n], "MAX(", 4)){
+      columns[n].type=TYPE_LONGLONG;
+      columns[n].flags=FLAG_UNSIGNED;
+      columns[n].charset=CHARSET_BINARY;
+      if (first < last){
+        g_snprintf(buffers[n], sizeof(buffers[n]), "%"G_GUINT64_FORMAT,
+                   synthetic_key_of_row(table, !g_ascii_strncasecmp(projection[n], "MIN(", 4) ? first : last - 1));
+        values[n]=buffers[n];
+      }
+    }else if (!g_ascii_strncasecmp(projection[n], "LEFT(", 5)){
+      if (first < last){
+        g_snprintf(buffers[n], sizeof(buffers[n]), "%"G_GUINT64_FORMAT,
+                   synthetic_key_of_row(table, !g_ascii_strncasecmp(projection[n], "LEFT(MIN(", 9) ? first : last - 1));
+        buffers[n][1]='\0';
+        values[n]=buffers[n];
+      }
+    }else{
+      // Like the checksums, a constant that is the same in every run
+      values[n]="0";
+    }
+  }
+  send_columns(c, table->name, columns, n);
+  send_string_row(c, values, n);
+  send_eof(c);
+}
+
+static
+void handle_select(struct client *c, const gchar *query){
+  static const gchar *one_names[] = {"1", NULL};
+  static const gchar *one_values[] = {"1"};
+  struct synthetic_table *table=table_of_query(c, query);
+  gchar **projection=NULL;
+  struct result_column columns[256];
+  struct synthetic_column *selected[256];
+  guint positions[256];
+  gchar buffers[256][64];
+  struct synthetic_column *column=NULL;
+  guint64 first, last, limit, r, sent=0;
+  gboolean descending, all;
+  const gchar *value=NULL;
+  gsize length=0, p;
+  guint i, j, n=0;
+  if (table == NULL){
+    if (g_strrstr(query, " FROM ") || g_strrstr(query, " from ")){
+      send_error(c, 1146, "42S02", "Table doesn't exist");
+      return;
+    }
+    // SELECT 1, SELECT FIND_IN_SET(...) and other expressions without tables
+    if (!g_ascii_strncasecmp(query, "SELECT FIND_IN_SET", 18)){
+      static const gchar *zero_values[] = {"0"};
+      send_single_row(c, one_names, zero_values);
+    }else{
+      send_single_row(c, one_names, one_values);
+    }
+    return;
+  }
+  rows_of_query(table, query, &first, &last);
+  limit=limit_of_query(query);
+  projection=projection_of_query(query);
+  for (i=0; projection[i] != NULL; i++){
+    if (!g_ascii_strncasecmp(projection[i], "MIN(", 4) || !g_ascii_strncasecmp(projection[i], "MAX(", 4) ||
+        !g_ascii_strncasecmp(projection[i], "LEFT(", 5) || !g_ascii_strncasecmp(projection[i], "COUNT(", 6) ||
+        !g_ascii_strncasecmp(projection[i], "COALESCE(", 9)){
+      handle_aggregate(c, table, projection, first, last);
+      g_strfreev(projection);
+      return;
+    }
+  }
+  // The columns of the result, * or a list of columns
+  for (i=0; projection[i] != NULL; i++){
+    all=!g_strcmp0(projection[i], "*");
+    unquote(projection[i]);
+    for (j=0; j<table->columns->len && n < G_N_ELEMENTS(columns); j++){
+      column=g_ptr_array_index(table->columns, j);
+      if (all || !g_strcmp0(column->name, projection[i])){
+        selected[n]=column;
+        positions[n]=j;
+        result_column_of(column, &(columns[n]));
+        n++;
+      }
+    }
+  }
+  descending=g_strrstr(query, " DESC") != NULL;
+  send_columns(c, table->name, columns, n);
+  for (r=0; r < last - first && sent < limit && !c->failed; r++, sent++){
+    p=packet_begin(c);
+    for (i=0; i<n; i++){
+      synthetic_value(selected[i], positions[i], synthetic_key_of_row(table, descending ? last - 1 - r : first + r),
+                   buffers[i], sizeof(buffers[i]), &value, &length);
+      append_lenenc_string(c->out, value, length);
+    }
+    packet_end(c, p);
+  }
+  send_eof(c);
+  g_strfreev(projection);
+}
+
+static
+gboolean contains_information_schema(const gchar *query){
+  gchar *upper=g_ascii_strup(query, -1);
+  gboolean r=strstr(upper, "INFORMATION_SCHEMA.") != NULL;
+  g_free(upper);
+  return r;
+}
+
+static
+void handle_query(struct client *c, const gchar *query){
+  static const gchar *one_names[] = {"1", NULL};
+  static const gchar *one_values[] = {"1"};
+  gchar *database=NULL;
+  while (g_ascii_isspace(*query))
+    query++;
+  if (log_queries)
+    g_message("Connection %u: %s", c->id, query);
+  if (!g_ascii_strncasecmp(query, "SELECT @@", 9)){
+    handle_variables(c, query);
+  }else if (contains_information_schema(query)){
+    handle_information_schema(c, query);
+  }else if (!g_ascii_strncasecmp(query, "SHOW ", 5)){
+    handle_show(c, query);
+  }else if (!g_ascii_strncasecmp(query, "EXPLAIN ", 8)){
+    handle_explain(c, query);
+  }else if (!g_ascii_strncasecmp(query, "SELECT ", 7)){
+    handle_select(c, query);
+  }else if (!g_ascii_strncasecmp(query, "USE ", 4)){
+    database=g_strdup(query + 4);
+    unquote(database);
+    if (synthetic_database_exists(database)){
+      g_free(c->database);
+      c->database=database;
+      send_ok(c, 0);
+    }else{
+      send_error(c, 1049, "42000", "Unknown database '%s'", database);
+      g_free(database);
+    }
+  }else if (!g_ascii_strncasecmp(query, "DO ", 3)){
+    send_single_row(c, one_names, one_values);
+  }else{
+    // SET, FLUSH, LOCK, UNLOCK, START TRANSACTION, SAVEPOINT, ROLLBACK, BACKUP, KILL...
+    send_ok(c, 0);
+  }
+}
+
+/* Connection */
+
+static
+gboolean read_packet(struct client *c, GByteArray *packet){
+  guint8 header[4];
+  gsize length, bytes=0;
+  GError *error=NULL;
+  if (!g_input_stream_read_all(c->input, header, 4, &bytes, NULL, &error) || bytes != 4){
+    if (error){
+      g_warning("Connection %u: read failed: %s", c->id, error->message);
+      g_error_free(error);
+    }
+    return FALSE;
+  }
+  length=header[0] | (header[1] << 8) | (header[2] << 16);
+  c->sequence=header[3] + 1;
+  g_byte_array_set_size(packet, length + 1);
+  if (!g_input_stream_read_all(c->input, packet->data, length, &bytes, NULL, &error) || bytes != length){
+    if (error){
+      g_warning("Connection %u: read failed: %s", c->id, error->message);
+      g_error_free(error);
+    }
+    return FALSE;
+  }
+  // The queries are handled as strings
+  packet->data[length]='\0';
+  g_byte_array_set_size(packet, length);
+  return TRUE;
+}
+
+static
+void send_handshake(struct client *c, const gchar *scramble){
+  gsize p=packet_begin(c);
+  g_string_append_c(c->out, PROTOCOL_VERSION);
+  g_string_append_len(c->out, SERVER_VERSION, strlen(SERVER_VERSION) + 1);
+  append_int(c->out, c->id, 4);
+  g_string_append_len(c->out, scramble, 8);
+  g_string_append_c(c->out, 0);
+  append_int(c->out, SERVER_CAPABILITIES & 0xffff, 2);
+  g_string_append_c(c->out, SERVER_CHARSET);
+  append_int(c->out, SERVER_STATUS_AUTOCOMMIT, 2);
+  append_int(c->out, SERVER_CAPABILITIES >> 16, 2);
+  g_string_append_c(c->out, SCRAMBLE_LENGTH + 1);
+  g_string_append_len(c->out, "\0\0\0\0\0\0\0\0\0\0", 10);
+  g_string_append_len(c->out, scramble + 8, SCRAMBLE_LENGTH - 8);
+  g_string_append_c(c->out, 0);
+  g_string_append_len(c->out, AUTH_PLUGIN, strlen(AUTH_PLUGIN) + 1);
+  packet_end(c, p);
+  flush_client(c);
+}
+
+/* Any user and password are accepted, the plugin is switched to AUTH_PLUGIN when needed */
+static
+gboolean authenticate(struct client *c, GByteArray *packet, const gchar *scramble){
+  const gchar *data=(const gchar *)packet->data, *end=(const gchar *)packet->data + packet->len, *plugin=NULL;
+  guint32 capabilities;
+  gsize p;
+  if (packet->len < 32)
+    return FALSE;
+  capabilities=packet->data[0] | (packet->data[1] << 8) | (packet->data[2] << 16) | ((guint32)packet->data[3] << 24);
+  data+=32;
+  // user
+  data+=strnlen(data, end - data) + 1;
+  // auth response
+  if (data < end && (capabilities & CLIENT_SECURE_CONNECTION))
+    data+=1 + (guint8)*data;
+  else if (data < end)
+    data+=strnlen(data, end - data) + 1;
+  if (data < end && (capabilities & CLIENT_CONNECT_WITH_DB)){
+    if (*data != '\0')
+      c->database=g_strndup(data, end - data);
+    data+=strnlen(data, end - data) + 1;
+  }
+  if (data < end && (capabilities & CLIENT_PLUGIN_AUTH))
+    plugin=data;
+  if (c->database && !synthetic_database_exists(c->database)){
+    send_error(c, 1049, "42000", "Unknown database '%s'", c->database);
+    flush_client(c);
+    return FALSE;
+  }
+  if (plugin != NULL && *plugin != '\0' && g_strcmp0(plugin, AUTH_PLUGIN)){
+    p=packet_begin(c);
+    g_string_append_c(c->out, 0xfe);
+    g_string_append_len(c->out, AUTH_PLUGIN, strlen(AUTH_PLUGIN) + 1);
+    g_string_append_len(c->out, scramble, SCRAMBLE_LENGTH);
+    g_string_append_c(c->out, 0);
+    packet_end(c, p);
+    flush_client(c);
+    if (!read_packet(c, packet))
+      return FALSE;
+  }
+  send_ok(c, 0);
+  flush_client(c);
+  return TRUE;
+}
+
+static
+void *client_thread(struct client *c){
+  GByteArray *packet=g_byte_array_new();
+  gchar scramble[SCRAMBLE_LENGTH];
+  gchar *database=NULL;
+  guint i;
+  for (i=0; i<SCRAMBLE_LENGTH; i++)
+    scramble[i]=g_random_int_range(1, 128);
+  c->sequence=0;
+  send_handshake(c, scramble);
+  if (!read_packet(c, packet) || !authenticate(c, packet, scramble))
+    goto cleanup;
+  while (!c->failed && read_packet(c, packet)){
+    if (packet->len == 0)
+      break;
+    switch (packet->data[0]){
+      case COM_QUIT:
+        goto cleanup;
+      case COM_QUERY:
+        handle_query(c, (const gchar *)packet->data + 1);
+        break;
+      case COM_INIT_DB:
+        database=g_strndup((const gchar *)packet->data + 1, packet->len - 1);
+        if (synthetic_database_exists(database)){
+          g_free(c->database);
+          c->database=database;
+          send_ok(c, 0);
+        }else{
+          send_error(c, 1049, "42000", "Unknown database '%s'", database);
+          g_free(database);
+        }
+        break;
+      case COM_PING:
+        send_ok(c, 0);
+        break;
+      case COM_SET_OPTION:
+      case COM_FIELD_LIST:
+        send_eof(c);
+        break;
+      default:
+        send_error(c, 1047, "08S01", "Unknown command %u", packet->data[0]);
+        break;
+    }
+    flush_client(c);
+  }
+cleanup:
+  if (log_queries)
+    g_message("Connection %u closed", c->id);
+  g_io_stream_close(G_IO_STREAM(c->connection), NULL, NULL);
+  g_object_unref(c->connection);
+  g_byte_array_free(packet, TRUE);
+  g_string_free(c->out, TRUE);
+  g_free(c->database);
+  g_free(c);
+  return NULL;
+}
+
+static
+void load_schema(){
+  gchar *name=NULL;
+  guint t;
+  synthetic_initialize();
+  if (schema_file != NULL){
+    synthetic_load_schema(schema_file);
+  }else if (scale > 0){
+    synthetic_scale_schema(database_name ? database_name : "bench", scale);
+  }else{
+    for (t=0; t<table_count; t++){
+      name=g_strdup_printf("t%u", t + 1);
+      synthetic_add_table(database_name ? database_name : "bench", name, table_rows, key_step, "int",
+                          column_list ? column_list : "int,bigint,decimal,datetime,varchar(32),varchar(255)");
+      g_free(name);
+    }
+  }
+}
+
+static
+void initialize_regexes(){
+  // `db`.`table`, db.table or `table` after FROM
+  from_regex=g_regex_new("\\bFROM\\s+(?:[`\"]?(\\w+)[`\"]?\\.)?[`\"]?(\\w+)[`\"]?", G_REGEX_CASELESS | G_REGEX_OPTIMIZE, 0, NULL);
+  range_regex=g_regex_new("(\\d+)\\s*<=\\s*[`\"]?id[`\"]?\\s+AND\\s+[`\"]?id[`\"]?\\s*<=\\s*(\\d+)", G_REGEX_CASELESS | G_REGEX_OPTIMIZE, 0, NULL);
+  equal_regex=g_regex_new("[`\"]id[`\"]\\s*=\\s*(\\d+)", G_REGEX_CASELESS | G_REGEX_OPTIMIZE, 0, NULL);
+  limit_regex=g_regex_new("\\bLIMIT\\s+(\\d+)\\s*$", G_REGEX_CASELESS | G_REGEX_OPTIMIZE, 0, NULL);
+  condition_regex=g_regex_new("(\\w+)\\s*(=|<>|!=)\\s*'([^']*)'", G_REGEX_CASELESS | G_REGEX_OPTIMIZE, 0, NULL);
+  like_regex=g_regex_new("(\\w+)\\s+(NOT\\s+)?LIKE\\s+'([^']*)'", G_REGEX_CASELESS | G_REGEX_OPTIMIZE, 0, NULL);
+}
+
+int main(int argc, char *argv[]){
+  GError *error=NULL;
+  GOptionContext *context=g_option_context_new("fake MySQL server for the mydumper benchmarks");
+  GSocketListener *listener=NULL;
+  GSocketAddress *socket_address=NULL;
+  GInetAddress *inet_address=NULL;
+  GSocketConnection *connection=NULL;
+  struct client *c=NULL;
+
+  g_option_context_add_main_entries(context, entries, NULL);
+  if (!g_option_context_parse(context, &argc, &argv, &error)){
+    g_printerr("option parsing failed: %s, try --help\n", error->message);
+    exit(EXIT_FAILURE);
+  }
+  g_option_context_free(context);
+
+  initialize_regexes();
+  load_schema();
+
+  inet_address=g_inet_address_new_from_string(address ? address : "127.0.0.1");
+  if (inet_address == NULL){
+    g_printerr("Invalid address %s\n", address);
+    exit(EXIT_FAILURE);
+  }
+  socket_address=g_inet_socket_address_new(inet_address, port);
+  listener=g_socket_listener_new();
+  if (!g_socket_listener_add_address(listener, socket_address, G_SOCKET_TYPE_STREAM, G_SOCKET_PROTOCOL_TCP, NULL, NULL, &error)){
+    g_printerr("Could not listen on %s:%u: %s\n", address ? address : "127.0.0.1", port, error->message);
+    exit(EXIT_FAILURE);
+  }
+  g_object_unref(socket_address);
+  g_object_unref(inet_address);
+  g_message("%s %s fake server listening on %s:%u with %u tables and %"G_GUINT64_FORMAT" rows",
+            SERVER_VERSION, VERSION, address ? address : "127.0.0.1", port, synthetic_tables->len, synthetic_total_rows());
+
+  while ((connection=g_socket_listener_accept(listener, NULL, NULL, &error)) != NULL){
+    c=g_new0(struct client, 1);
+    c->id=g_atomic_int_add(&connection_counter, 1) + 1;
+    c->connection=connection;
+    c->input=g_io_stream_get_input_stream(G_IO_STREAM(connection));
+    c->output=g_io_stream_get_output_stream(G_IO_STREAM(connection));
+    c->out=g_string_sized_new(FLUSH_SIZE + 65536);
+    g_thread_unref(g_thread_new("fake_server", (GThreadFunc)client_thread, c));
+  }
+  g_printerr("Accept failed: %s\n", error->message);
+  g_socket_listener_close(listener);
+  return EXIT_FAILURE;
+}
@@ -0,0 +1,147 @@
+/*
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+        Authors:    David Ducos, Percona (david dot ducos at percona dot com)
+*/
+#include <mysql.h>
+#include <glib.h>
+#include <string.h>
+#include "mydumper_start_dump.h"
+#include "mydumper_common.h"
+#include "mydumper_global.h"
+#include "mydumper_arguments.h"
+#include "mydumper_write.h"
+#include "bench.h"
+
+/*
+  Microbenchmarks of the mydumper hot paths that do not need a server: the
+  escaping of the values, the serialization of the rows in every output
+  format and the INSERT prefix of the tables. MYSQL_FIELD and MYSQL_ROW are
+  built from the synthetic table, the connection is never connected as it is
+  only used to know the charset of the escaping.
+*/
+
+struct mydumper_bench {
+  MYSQL *conn;
+  struct bench_table *table;
+  MYSQL_FIELD *fields;
+  struct db_table *dbt;
+  struct thread_data_buffers buffers;
+  void (*write_column_into_string)(MYSQL *, gchar **, MYSQL_FIELD , gulong , struct thread_data_buffers);
+};
+
+static
+void run_m_real_escape_string(gpointer data){
+  struct mydumper_bench *b=data;
+  guint r, c;
+  gulong length;
+  for (r=0; r<b->table->rows; r++)
+    for (c=1; c<b->table->columns; c++){
+      length=b->table->lengths[r][c];
+      g_string_set_size(b->buffers.escaped, length * 2 + 1);
+      m_real_escape_string(b->conn, b->buffers.escaped->str, b->table->values[r][c], length);
+    }
+}
+
+static
+void run_write_row_into_string(gpointer data){
+  struct mydumper_bench *b=data;
+  guint r;
+  for (r=0; r<b->table->rows; r++){
+    g_string_set_size(b->buffers.row, 0);
+    write_row_into_string(b->conn, b->dbt, b->table->values[r], b->fields, b->table->lengths[r], b->table->columns, b->buffers, b->write_column_into_string);
+  }
+}
+
+static
+void run_build_insert_statement(gpointer data){
+  struct mydumper_bench *b=data;
+  guint r;
+  for (r=0; r<b->table->rows; r++){
+    build_insert_statement(b->dbt, b->fields, b->table->columns);
+    g_string_free(b->dbt->insert_statement, TRUE);
+    b->dbt->insert_statement=NULL;
+  }
+}
+
+/* Same separators than a real dump with --format */
+static
+void set_output_format(guint format){
+  fields_enclosed_by="\"";
+  fields_enclosed_by_ld=NULL;
+  fields_escaped_by=NULL;
+  fields_terminated_by_ld=NULL;
+  lines_starting_by_ld=NULL;
+  lines_terminated_by_ld=NULL;
+  statement_terminated_by_ld=NULL;
+  output_format=format;
+  initialize_write();
+}
+
+int main(int argc, char *argv[]){
+  struct mydumper_bench b;
+  guint c;
+  const gchar *format_names[] = {"SQL_INSERT", "LOAD_DATA", "CSV", "CLICKHOUSE"};
+  guint format;
+  gchar *name=NULL;
+  guint64 escaped_bytes=0;
+  guint r;
+
+  bench_initialize(&argc, &argv, "mydumper");
+  b.conn=mysql_init(NULL);
+  b.table=bench_new_table();
+  b.fields=g_new0(MYSQL_FIELD, b.table->columns);
+  for (c=0; c<b.table->columns; c++){
+    b.fields[c].name=g_strdup_printf("c%u", c);
+    b.fields[c].type=c == 0 ? MYSQL_TYPE_LONGLONG : (bench_charset == BENCH_BINARY ? MYSQL_TYPE_BLOB : MYSQL_TYPE_VAR_STRING);
+    b.fields[c].flags=c == 0 ? NUM_FLAG : 0;
+  }
+  b.dbt=g_new0(struct db_table, 1);
+  b.dbt->table=g_strdup("bench");
+  b.dbt->complete_insert=TRUE;
+  b.buffers.statement=g_string_sized_new(statement_size);
+  b.buffers.row=g_string_sized_new(statement_size);
+  b.buffers.escaped=g_string_sized_new(statement_size);
+  b.buffers.column=g_string_sized_new(statement_size);
+
+  // The integer id is not escaped
+  for (r=0; r<b.table->rows; r++)
+    escaped_bytes+=b.table->lengths[r][0];
+  escaped_bytes=b.table->bytes - escaped_bytes;
+  fields_escaped_by=g_strdup("\\");
+  bench_report("m_real_escape_string", b.table->rows, escaped_bytes, bench_run(&run_m_real_escape_string, &b));
+
+  for (format=SQL_INSERT; format<=CLICKHOUSE; format++){
+    set_output_format(format);
+    b.write_column_into_string=format == LOAD_DATA || format == CSV ? &write_load_data_column_into_string : &write_sql_column_into_string;
+    name=g_strdup_printf("write_row_into_string/%s", format_names[format]);
+    bench_report(name, b.table->rows, b.table->bytes, bench_run(&run_write_row_into_string, &b));
+    g_free(name);
+    finalize_write();
+  }
+
+  // A row is a statement prefix built for a table with --columns columns
+  set_output_format(SQL_INSERT);
+  build_insert_statement(b.dbt, b.fields, b.table->columns);
+  gsize prefix_len=b.dbt->insert_statement->len;
+  g_string_free(b.dbt->insert_statement, TRUE);
+  b.dbt->insert_statement=NULL;
+  bench_report("build_insert_statement", b.table->rows, b.table->rows * prefix_len, bench_run(&run_build_insert_statement, &b));
+  finalize_write();
+
+  bench_finish();
+  bench_free_table(b.table);
+  mysql_close(b.conn);
+  return 0;
+}
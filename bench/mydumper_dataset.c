@@ -0,0 +1,310 @@
+/*
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+        Authors:    David Ducos, Percona (david dot ducos at percona dot com)
+*/
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "config.h"
+#include "synthetic.h"
+
+/*
+  Synthetic dataset generator, it writes a backup in the layout of mydumper
+  without a server: metadata, schema-create, schema and data files with
+  INSERT statements, like mydumper with its default options. The tables are
+  the ones of --scale, about 1GB per unit, or the ones described by --schema
+  (see synthetic.h), so myloader and the chunking of mydumper can be tested on
+  large and repeatable workloads. Data files are written in parallel.
+*/
+
+#define HEADERS "/*!40101 SET NAMES binary*/;\n/*!40014 SET FOREIGN_KEY_CHECKS=0*/;\n" \
+                "/*!40101 SET SQL_MODE='NO_AUTO_VALUE_ON_ZERO,ONLY_FULL_GROUP_BY,NO_ZERO_IN_DATE,NO_ZERO_DATE,ERROR_FOR_DIVISION_BY_ZERO,NO_ENGINE_SUBSTITUTION'*/;\n" \
+                "/*!40103 SET TIME_ZONE='+00:00' */;\n"
+#define SQL_MODE "'NO_AUTO_VALUE_ON_ZERO,ONLY_FULL_GROUP_BY,NO_ZERO_IN_DATE,NO_ZERO_DATE,ERROR_FOR_DIVISION_BY_ZERO,NO_ENGINE_SUBSTITUTION'"
+
+struct data_file_job {
+  struct synthetic_table *table;
+  guint64 part;
+};
+
+static gdouble scale = 1;
+static gchar *schema_file = NULL;
+static gchar *database_name = NULL;
+static gchar *output_directory = NULL;
+static guint num_threads = 4;
+static guint64 rows_per_file = 1000000;
+static guint statement_size = 1000000;
+
+static GMutex *totals_mutex = NULL;
+static guint64 total_bytes = 0;
+static guint64 total_files = 0;
+static gboolean failed = FALSE;
+
+static GOptionEntry entries[] = {
+    {"scale", 0, 0, G_OPTION_ARG_DOUBLE, &scale,
+     "Scale factor of the dataset, about 1GB and 100 small tables per unit. Default 1", NULL},
+    {"schema", 0, 0, G_OPTION_ARG_FILENAME, &schema_file,
+     "Key file with a [database.table] section per table, with rows, key_step, key and columns, instead of --scale", NULL},
+    {"database", 'B', 0, G_OPTION_ARG_STRING, &database_name,
+     "Database of the --scale tables, the small tables go to <database>_small. Default bench", NULL},
+    {"outputdir", 'o', 0, G_OPTION_ARG_FILENAME, &output_directory,
+     "Directory to output files to", NULL},
+    {"threads", 't', 0, G_OPTION_ARG_INT, &num_threads,
+     "Number of threads writing data files, default 4", NULL},
+    {"rows", 'r', 0, G_OPTION_ARG_INT64, &rows_per_file,
+     "Rows of every data file, default 1000000", NULL},
+    {"statement-size", 's', 0, G_OPTION_ARG_INT, &statement_size,
+     "Attempted size of INSERT statement in bytes, default 1000000", NULL},
+    {NULL, 0, 0, G_OPTION_ARG_NONE, NULL, NULL, NULL}};
+
+static
+void write_file(const gchar *filename, const gchar *content, gsize length){
+  GError *error=NULL;
+  if (!g_file_set_contents(filename, content, length, &error)){
+    g_critical("Could not write %s: %s", filename, error->message);
+    g_error_free(error);
+    failed=TRUE;
+  }
+}
+
+/* Same escaping than mysql_real_escape_string() */
+static inline
+void append_escaped(GString *s, const gchar *value, gsize length){
+  gsize i;
+  for (i=0; i<length; i++){
+    switch (value[i]){
+      case '\0':
+        g_string_append(s, "\\0");
+        break;
+      case '\n':
+        g_string_append(s, "\\n");
+        break;
+      case '\r':
+        g_string_append(s, "\\r");
+        break;
+      case '\\':
+        g_string_append(s, "\\\\");
+        break;
+      case '\'':
+        g_string_append(s, "\\'");
+        break;
+      case '"':
+        g_string_append(s, "\\\"");
+        break;
+      case '\032':
+        g_string_append(s, "\\Z");
+        break;
+      default:
+        g_string_append_c(s, value[i]);
+    }
+  }
+}
+
+static
+void append_row(GString *statement, struct synthetic_table *table, guint64 id){
+  struct synthetic_column *column=NULL;
+  gchar buffer[64];
+  const gchar *value=NULL;
+  gsize length=0;
+  guint i;
+  g_string_append_c(statement, '(');
+  for (i=0; i<table->columns->len; i++){
+    column=g_ptr_array_index(table->columns, i);
+    synthetic_value(column, i, id, buffer, sizeof(buffer), &value, &length);
+    if (i > 0)
+      g_string_append_c(statement, ',');
+    if (synthetic_is_quoted(column->kind)){
+      g_string_append_c(statement, '"');
+      append_escaped(statement, value, length);
+      g_string_append_c(statement, '"');
+    }else{
+      g_string_append_len(statement, value, length);
+    }
+  }
+  g_string_append(statement, ")\n");
+}
+
+static
+gboolean write_statement(FILE *file, GString *statement, guint64 *bytes){
+  if (fwrite(statement->str, 1, statement->len, file) != statement->len)
+    return FALSE;
+  *bytes+=statement->len;
+  g_string_set_size(statement, 0);
+  return TRUE;
+}
+
+/* Rows [part * rows_per_file, (part + 1) * rows_per_file) of the table */
+static
+void write_data_file(struct data_file_job *job, gpointer user_data){
+  (void) user_data;
+  struct synthetic_table *table=job->table;
+  gchar *basename=g_strdup_printf("%s.%s.%05"G_GUINT64_FORMAT".sql", table->database, table->name, job->part);
+  gchar *filename=g_build_filename(output_directory, basename, NULL);
+  gchar *insert=g_strdup_printf("INSERT INTO `%s` VALUES", table->name);
+  GString *statement=g_string_sized_new(statement_size + 65536);
+  guint64 row=job->part * rows_per_file, last=MIN(row + rows_per_file, table->rows), rows_in_statement=0, bytes=0;
+  gboolean ok=TRUE;
+  FILE *file=g_fopen(filename, "w");
+  if (file == NULL){
+    g_critical("Could not create %s: %s", filename, g_strerror(errno));
+    failed=TRUE;
+    goto cleanup;
+  }
+  g_string_append(statement, HEADERS);
+  for (; row < last && ok; row++){
+    if (rows_in_statement == 0)
+      g_string_append(statement, insert);
+    else
+      g_string_append_c(statement, ',');
+    append_row(statement, table, synthetic_key_of_row(table, row));
+    rows_in_statement++;
+    if (statement->len >= statement_size){
+      g_string_append(statement, ";\n");
+      ok=write_statement(file, statement, &bytes);
+      rows_in_statement=0;
+    }
+  }
+  if (ok && rows_in_statement > 0){
+    g_string_append(statement, ";\n");
+    ok=write_statement(file, statement, &bytes);
+  }
+  if (fclose(file) != 0 || !ok){
+    g_critical("Could not write %s: %s", filename, g_strerror(errno));
+    failed=TRUE;
+  }
+  g_mutex_lock(totals_mutex);
+  total_bytes+=bytes;
+  total_files++;
+  g_mutex_unlock(totals_mutex);
+cleanup:
+  g_string_free(statement, TRUE);
+  g_free(insert);
+  g_free(filename);
+  g_free(basename);
+  g_free(job);
+}
+
+static
+void write_schema_files(){
+  struct synthetic_table *table=NULL;
+  gchar *filename=NULL, *create=NULL, *content=NULL;
+  const gchar *database=NULL;
+  guint i;
+  for (i=0; i<synthetic_databases->len; i++){
+    database=g_ptr_array_index(synthetic_databases, i);
+    filename=g_strdup_printf("%s/%s-schema-create.sql", output_directory, database);
+    content=g_strdup_printf("%sCREATE DATABASE /*!32312 IF NOT EXISTS*/ `%s` /*!40100 DEFAULT CHARACTER SET utf8mb4 COLLATE utf8mb4_0900_ai_ci */;\n", HEADERS, database);
+    write_file(filename, content, strlen(content));
+    g_free(content);
+    g_free(filename);
+  }
+  for (i=0; i<synthetic_tables->len; i++){
+    table=g_ptr_array_index(synthetic_tables, i);
+    filename=g_strdup_printf("%s/%s.%s-schema.sql", output_directory, table->database, table->name);
+    create=synthetic_create_table(table);
+    content=g_strdup_printf("%s%s;\n", HEADERS, create);
+    write_file(filename, content, strlen(content));
+    g_free(content);
+    g_free(create);
+    g_free(filename);
+  }
+}
+
+static
+void write_metadata(const gchar *started){
+  GString *content=g_string_new("");
+  struct synthetic_table *table=NULL;
+  GDateTime *datetime=g_date_time_new_now_local();
+  gchar *finished=g_date_time_format(datetime, "%Y-%m-%d %H:%M:%S");
+  gchar *filename=g_build_filename(output_directory, "metadata", NULL);
+  guint i;
+  g_string_append_printf(content, "# Started dump at: %s\n", started);
+  g_string_append(content, "[config]\nquote_character = BACKTICK\n");
+  g_string_append(content, "\n[myloader_session_variables]");
+  g_string_append_printf(content, "\nSQL_MODE=%s /*!40101\n\n", SQL_MODE);
+  for (i=0; i<synthetic_tables->len; i++){
+    table=g_ptr_array_index(synthetic_tables, i);
+    g_string_append_printf(content, "\n[`%s`.`%s`]\nreal_table_name=%s\nrows = %"G_GUINT64_FORMAT"\n", table->database, table->name, table->name, table->rows);
+  }
+  g_string_append_printf(content, "# Finished dump at: %s\n", finished);
+  write_file(filename, content->str, content->len);
+  g_free(filename);
+  g_free(finished);
+  g_date_time_unref(datetime);
+  g_string_free(content, TRUE);
+}
+
+int main(int argc, char *argv[]){
+  GError *error=NULL;
+  GOptionContext *context=g_option_context_new("synthetic dataset in the mydumper format");
+  GThreadPool *pool=NULL;
+  struct synthetic_table *table=NULL;
+  struct data_file_job *job=NULL;
+  GDateTime *datetime=NULL;
+  gchar *started=NULL;
+  gint64 start=g_get_monotonic_time();
+  gdouble seconds;
+  guint64 part;
+  guint i;
+
+  g_option_context_add_main_entries(context, entries, NULL);
+  if (!g_option_context_parse(context, &argc, &argv, &error)){
+    g_printerr("option parsing failed: %s, try --help\n", error->message);
+    exit(EXIT_FAILURE);
+  }
+  g_option_context_free(context);
+  if (output_directory == NULL || num_threads == 0 || rows_per_file == 0 || scale <= 0){
+    g_printerr("--outputdir is needed and --threads, --rows and --scale must be greater than 0\n");
+    exit(EXIT_FAILURE);
+  }
+  if (g_mkdir_with_parents(output_directory, 0750) == -1){
+    g_printerr("Could not create %s: %s\n", output_directory, g_strerror(errno));
+    exit(EXIT_FAILURE);
+  }
+
+  datetime=g_date_time_new_now_local();
+  started=g_date_time_format(datetime, "%Y-%m-%d %H:%M:%S");
+  g_date_time_unref(datetime);
+  totals_mutex=g_mutex_new();
+  synthetic_initialize();
+  if (schema_file)
+    synthetic_load_schema(schema_file);
+  else
+    synthetic_scale_schema(database_name ? database_name : "bench", scale);
+  g_message("Generating %u tables and %"G_GUINT64_FORMAT" rows in %s", synthetic_tables->len, synthetic_total_rows(), output_directory);
+
+  write_schema_files();
+  pool=g_thread_pool_new((GFunc)write_data_file, NULL, num_threads, TRUE, NULL);
+  for (i=0; i<synthetic_tables->len; i++){
+    table=g_ptr_array_index(synthetic_tables, i);
+    for (part=0; part * rows_per_file < table->rows; part++){
+      job=g_new0(struct data_file_job, 1);
+      job->table=table;
+      job->part=part;
+      g_thread_pool_push(pool, job, NULL);
+    }
+  }
+  g_thread_pool_free(pool, FALSE, TRUE);
+  write_metadata(started);
+  g_free(started);
+
+  seconds=(gdouble)(g_get_monotonic_time() - start) / G_USEC_PER_SEC;
+  g_message("%"G_GUINT64_FORMAT" data files and %.2f MB written in %.2f seconds, %.2f MB/s",
+            total_files, (gdouble)total_bytes / 1000000, seconds, seconds > 0 ? total_bytes / seconds / 1000000 : 0);
+  return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
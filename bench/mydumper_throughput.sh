@@ -0,0 +1,62 @@
+#!/bin/bash
+# Throughput ceiling of mydumper per thread count, against mydumper_fake_server
+# Usage: mydumper_throughput.sh <mydumper_fake_server> <mydumper> [output.json]
+# Environment: THREADS (default "1 2 4 8"), PORT (default 3307),
+#              FAKE_SERVER_ARGS (like --rows=1000000 --tables=8) and MYDUMPER_ARGS (like --compress)
+
+die()
+{
+    [ -n "$1" ] && echo "$1" >&2;
+    exit 1
+}
+
+fake_server=$1
+mydumper=$2
+output=${3:-/dev/stdout}
+threads=${THREADS:-"1 2 4 8"}
+port=${PORT:-3307}
+
+[ -x "$fake_server" ] || die "Usage: $0 <mydumper_fake_server> <mydumper> [output.json]"
+[ -x "$mydumper" ] || die "Usage: $0 <mydumper_fake_server> <mydumper> [output.json]"
+
+outdir=$(mktemp -d) || die "Could not create the output directory"
+"$fake_server" --port="$port" $FAKE_SERVER_ARGS &
+server_pid=$!
+trap 'kill $server_pid 2>/dev/null; rm -rf "$outdir"' EXIT
+# Waits up to 30 seconds until the port accepts connections
+listening=0
+for i in $(seq 300)
+do
+  kill -0 $server_pid 2>/dev/null || die "mydumper_fake_server did not start"
+  (exec 3<>"/dev/tcp/127.0.0.1/$port") 2>/dev/null && listening=1 && break
+  sleep 0.1
+done
+[ $listening -eq 1 ] || die "mydumper_fake_server is not listening on port $port"
+
+results=""
+for t in $threads
+do
+  rm -rf "$outdir/dump"
+  start=$(date +%s%N)
+  "$mydumper" --host=127.0.0.1 --port="$port" --user=bench --password=bench --threads="$t" \
+    --outputdir="$outdir/dump" --rows=100000 --no-locks $MYDUMPER_ARGS >/dev/null 2>&1 ||
+    die "mydumper failed with $t threads"
+  end=$(date +%s%N)
+  bytes=$(du -sb "$outdir/dump" | cut -f1)
+  seconds=$(echo "scale=6; ($end - $start) / 1000000000" | bc)
+  mbs=$(echo "scale=2; $bytes / $seconds / 1000000" | bc)
+  echo "$t threads: $mbs MB/s" >&2
+  [ -n "$results" ] && results="$results,"$'\n'
+  results="$results    {\"threads\": $t, \"bytes\": $bytes, \"seconds\": $seconds, \"mb_per_second\": $mbs}"
+done
+
+cat > "$output" <<EOF
+{
+  "program": "mydumper",
+  "server": "mydumper_fake_server $FAKE_SERVER_ARGS",
+  "options": "$MYDUMPER_ARGS",
+  "results": [
+$results
+  ]
+}
+EOF
@@ -0,0 +1,207 @@
+/*
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+        Authors:    David Ducos, Percona (david dot ducos at percona dot com)
+*/
+#include <mysql.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <stdio.h>
+#include <string.h>
+#include "common.h"
+#include "myloader.h"
+#include "myloader_global.h"
+#include "myloader_restore.h"
+#include "myloader_stream.h"
+#include "bench.h"
+
+/*
+  Microbenchmarks of the myloader hot paths that do not need a server: reading
+  the lines of the data files, splitting the INSERTs before they are sent and
+  receiving the files of a --stream. The synthetic table is serialized as the
+  INSERT statements that mydumper writes with the default --statement-size,
+  every statement is a file of the stream.
+*/
+
+#define BENCH_STATEMENT_SIZE 1000000
+
+struct myloader_bench {
+  GPtrArray *statements;
+  guint64 bytes;
+  gchar *tmp_directory;
+  gchar *data_file;
+  gchar *stream_file;
+  GPtrArray *received;
+};
+
+static
+void append_escaped(GString *s, const gchar *value, gulong length){
+  gulong i;
+  g_string_append_c(s, '\'');
+  for (i=0; i<length; i++)
+    switch (value[i]){
+      case 0:    g_string_append(s, "\\0"); break;
+      case '\n': g_string_append(s, "\\n"); break;
+      case '\r': g_string_append(s, "\\r"); break;
+      case '\\': g_string_append(s, "\\\\"); break;
+      case '\'': g_string_append(s, "\\'"); break;
+      case '"':  g_string_append(s, "\\\""); break;
+      case '\032': g_string_append(s, "\\Z"); break;
+      default:   g_string_append_c(s, value[i]);
+    }
+  g_string_append_c(s, '\'');
+}
+
+/* Same layout than write_result_into_file() with --format SQL_INSERT */
+static
+GPtrArray *new_statements(struct bench_table *table){
+  GPtrArray *statements=g_ptr_array_new();
+  GString *statement=NULL, *row=g_string_new("");
+  guint r, c;
+  for (r=0; r<table->rows; r++){
+    g_string_assign(row, "(");
+    g_string_append(row, table->values[r][0]);
+    for (c=1; c<table->columns; c++){
+      g_string_append_c(row, ',');
+      append_escaped(row, table->values[r][c], table->lengths[r][c]);
+    }
+    g_string_append_c(row, ')');
+    if (statement != NULL && statement->len + row->len + 1 > BENCH_STATEMENT_SIZE){
+      g_string_append(statement, ";\n");
+      statement=NULL;
+    }
+    if (statement == NULL){
+      statement=g_string_new("INSERT INTO `bench` VALUES");
+      g_ptr_array_add(statements, statement);
+    }else
+      g_string_append_c(statement, ',');
+    g_string_append_c(statement, '\n');
+    g_string_append(statement, row->str);
+  }
+  g_string_append(statement, ";\n");
+  g_string_free(row, TRUE);
+  return statements;
+}
+
+static
+void run_read_data(gpointer data){
+  struct myloader_bench *b=data;
+  FILE *file=g_fopen(b->data_file, "r");
+  GString *line=g_string_sized_new(BENCH_STATEMENT_SIZE);
+  gboolean eof=FALSE;
+  guint line_number=0;
+  while (read_data(file, line, &eof, &line_number) && !eof){
+    // myloader keeps the lines until the statement is complete
+    if (line->len > 1 && line->str[line->len - 2] == ';')
+      g_string_set_size(line, 0);
+  }
+  fclose(file);
+  g_string_free(line, TRUE);
+}
+
+static
+int execute_nothing(GString *statement, guint statement_rows, guint from_line, guint to_line, gpointer user_data){
+  (void) statement;
+  (void) statement_rows;
+  (void) from_line;
+  (void) to_line;
+  (void) user_data;
+  return 0;
+}
+
+static
+void run_split_insert(gpointer data){
+  struct myloader_bench *b=data;
+  guint i;
+  for (i=0; i<b->statements->len; i++)
+    split_insert(g_ptr_array_index(b->statements, i), 1, bench_split_rows, &execute_nothing, NULL);
+}
+
+static struct myloader_bench *receiving=NULL;
+
+static
+void file_received(gchar *filename, guint size){
+  (void) size;
+  g_ptr_array_add(receiving->received, filename);
+}
+
+static
+void run_receive_stream(gpointer data){
+  struct myloader_bench *b=data;
+  FILE *input=g_fopen(b->stream_file, "r");
+  gchar *path=NULL;
+  guint i;
+  directory=g_build_filename(b->tmp_directory, "stream", NULL);
+  g_mkdir(directory, 0700);
+  receiving=b;
+  receive_stream(input, &file_received);
+  fclose(input);
+  for (i=0; i<b->received->len; i++){
+    path=g_build_filename(directory, g_ptr_array_index(b->received, i), NULL);
+    g_unlink(path);
+    g_free(path);
+    g_free(g_ptr_array_index(b->received, i));
+  }
+  g_ptr_array_set_size(b->received, 0);
+  g_rmdir(directory);
+  g_free(directory);
+  directory=NULL;
+}
+
+int main(int argc, char *argv[]){
+  struct myloader_bench b;
+  struct bench_table *table=NULL;
+  GError *error=NULL;
+  FILE *data_file=NULL, *stream_file=NULL;
+  GString *statement=NULL;
+  guint i;
+
+  bench_initialize(&argc, &argv, "myloader");
+  table=bench_new_table();
+  b.statements=new_statements(table);
+  b.received=g_ptr_array_new();
+  b.bytes=0;
+  b.tmp_directory=g_dir_make_tmp("myloader_bench_XXXXXX", &error);
+  if (b.tmp_directory == NULL){
+    g_printerr("Could not create the temporary directory: %s\n", error->message);
+    return 1;
+  }
+  b.data_file=g_build_filename(b.tmp_directory, "bench.bench.00000.sql", NULL);
+  b.stream_file=g_build_filename(b.tmp_directory, "stream.bin", NULL);
+  data_file=g_fopen(b.data_file, "w");
+  stream_file=g_fopen(b.stream_file, "w");
+  for (i=0; i<b.statements->len; i++){
+    statement=g_ptr_array_index(b.statements, i);
+    fwrite(statement->str, 1, statement->len, data_file);
+    fprintf(stream_file, "\n-- bench.bench.%05u.sql %"G_GSIZE_FORMAT"\n", i, statement->len);
+    fwrite(statement->str, 1, statement->len, stream_file);
+    b.bytes+=statement->len;
+  }
+  fclose(data_file);
+  fclose(stream_file);
+
+  bench_report("read_data", table->rows, b.bytes, bench_run(&run_read_data, &b));
+  bench_report("split_insert", table->rows, b.bytes, bench_run(&run_split_insert, &b));
+  bench_report("receive_stream", table->rows, b.bytes, bench_run(&run_receive_stream, &b));
+  bench_finish();
+
+  g_unlink(b.data_file);
+  g_unlink(b.stream_file);
+  g_rmdir(b.tmp_directory);
+  for (i=0; i<b.statements->len; i++)
+    g_string_free(g_ptr_array_index(b.statements, i), TRUE);
+  g_ptr_array_free(b.statements, TRUE);
+  bench_free_table(table);
+  return 0;
+}
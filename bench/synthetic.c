@@ -0,0 +1,281 @@
+/*
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+        Authors:    David Ducos, Percona (david dot ducos at percona dot com)
+*/
+#include <glib.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "synthetic.h"
+
+GPtrArray *synthetic_tables = NULL;
+GPtrArray *synthetic_databases = NULL;
+
+static GHashTable *table_hash = NULL;
+static gchar *text_pool = NULL;
+static gchar *binary_pool = NULL;
+
+/* splitmix64, the values of a row only depend on its id and the column */
+static inline
+guint64 value_hash(guint64 id, guint column){
+  guint64 z=id * 0x9e3779b97f4a7c15ULL + column * 0xbf58476d1ce4e5b9ULL;
+  z=(z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z=(z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  return z ^ (z >> 31);
+}
+
+void synthetic_initialize(){
+  static const gchar chars[] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789 ,.-_'\"\\";
+  GRand *rand=g_rand_new_with_seed(1);
+  guint i;
+  text_pool=g_new(gchar, SYNTHETIC_POOL_SIZE);
+  binary_pool=g_new(gchar, SYNTHETIC_POOL_SIZE);
+  for (i=0; i<SYNTHETIC_POOL_SIZE; i++){
+    text_pool[i]=chars[g_rand_int_range(rand, 0, sizeof(chars) - 1)];
+    binary_pool[i]=g_rand_int_range(rand, 0, 256);
+  }
+  g_rand_free(rand);
+  synthetic_tables=g_ptr_array_new();
+  synthetic_databases=g_ptr_array_new();
+  table_hash=g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+}
+
+static
+struct synthetic_column *new_synthetic_column(const gchar *name, const gchar *definition){
+  struct synthetic_column *column=g_new0(struct synthetic_column, 1);
+  gchar *type=g_ascii_strdown(definition, -1);
+  gchar *parenthesis=NULL;
+  g_strstrip(type);
+  column->name=g_strdup(name);
+  if ((parenthesis=strchr(type, '(')) != NULL){
+    column->length=strtoul(parenthesis + 1, NULL, 10);
+    *parenthesis='\0';
+  }
+  if (!g_strcmp0(type, "int")){
+    column->kind=SYNTHETIC_INT;
+    column->sql_type=g_strdup("int");
+  }else if (!g_strcmp0(type, "bigint")){
+    column->kind=SYNTHETIC_BIGINT;
+    column->sql_type=g_strdup("bigint");
+  }else if (!g_strcmp0(type, "decimal")){
+    column->kind=SYNTHETIC_DECIMAL;
+    column->sql_type=g_strdup("decimal(10,2)");
+  }else if (!g_strcmp0(type, "datetime")){
+    column->kind=SYNTHETIC_DATETIME;
+    column->sql_type=g_strdup("datetime");
+  }else if (!g_strcmp0(type, "uuid")){
+    column->kind=SYNTHETIC_UUID;
+    column->length=36;
+    column->sql_type=g_strdup("char(36)");
+  }else if (!g_strcmp0(type, "char") || !g_strcmp0(type, "varchar") || !g_strcmp0(type, "blob")){
+    if (column->length == 0)
+      column->length=!g_strcmp0(type, "blob") ? 1024 : 32;
+    if (column->length > SYNTHETIC_POOL_SIZE / 2)
+      column->length=SYNTHETIC_POOL_SIZE / 2;
+    column->kind=!g_strcmp0(type, "char") ? SYNTHETIC_CHAR : !g_strcmp0(type, "varchar") ? SYNTHETIC_VARCHAR : SYNTHETIC_BLOB;
+    column->sql_type=column->kind == SYNTHETIC_BLOB ? g_strdup(column->length < 65536 ? "blob" : "mediumblob") : g_strdup_printf("%s(%u)", type, column->length);
+  }else{
+    g_printerr("Unknown column type %s\n", definition);
+    exit(EXIT_FAILURE);
+  }
+  g_free(type);
+  return column;
+}
+
+/* key is int or uuid, columns is a comma separated list of types */
+void synthetic_add_table(const gchar *database, const gchar *name, guint64 rows, guint64 key_step, const gchar *key, const gchar *columns){
+  struct synthetic_table *table=g_new0(struct synthetic_table, 1);
+  struct synthetic_column *column=NULL;
+  gchar **definitions=g_strsplit(columns, ",", 0);
+  gchar *column_name=NULL;
+  guint i;
+  table->database=g_strdup(database);
+  table->name=g_strdup(name);
+  table->rows=rows;
+  table->key_step=key_step > 0 ? key_step : 1;
+  table->columns=g_ptr_array_new();
+  if (key != NULL && !g_ascii_strcasecmp(key, "uuid")){
+    column=new_synthetic_column("id", "uuid");
+  }else{
+    column=g_new0(struct synthetic_column, 1);
+    column->name=g_strdup("id");
+    column->kind=SYNTHETIC_KEY;
+    column->sql_type=g_strdup("bigint unsigned");
+  }
+  g_ptr_array_add(table->columns, column);
+  for (i=0; definitions[i] != NULL; i++){
+    if (*g_strstrip(definitions[i]) == '\0')
+      continue;
+    column_name=g_strdup_printf("c%u", i + 1);
+    g_ptr_array_add(table->columns, new_synthetic_column(column_name, definitions[i]));
+    g_free(column_name);
+  }
+  g_strfreev(definitions);
+  g_ptr_array_add(synthetic_tables, table);
+  g_hash_table_insert(table_hash, g_strdup_printf("%s.%s", database, name), table);
+  if (!synthetic_database_exists(database))
+    g_ptr_array_add(synthetic_databases, g_strdup(database));
+}
+
+/* A [database.table] section per table, with rows, key_step, key and columns */
+void synthetic_load_schema(const gchar *filename){
+  GKeyFile *kf=g_key_file_new();
+  GError *error=NULL;
+  gchar **groups=NULL, *dot=NULL, *key=NULL, *columns=NULL;
+  guint64 rows, key_step;
+  gsize i, len=0;
+  if (!g_key_file_load_from_file(kf, filename, G_KEY_FILE_NONE, &error)){
+    g_printerr("Could not read %s: %s\n", filename, error->message);
+    exit(EXIT_FAILURE);
+  }
+  groups=g_key_file_get_groups(kf, &len);
+  for (i=0; i<len; i++){
+    dot=strchr(groups[i], '.');
+    if (dot == NULL){
+      g_printerr("Section [%s] of %s must be [database.table]\n", groups[i], filename);
+      exit(EXIT_FAILURE);
+    }
+    rows=g_key_file_get_uint64(kf, groups[i], "rows", NULL);
+    key_step=g_key_file_get_uint64(kf, groups[i], "key_step", NULL);
+    key=g_key_file_get_string(kf, groups[i], "key", NULL);
+    columns=g_key_file_get_string(kf, groups[i], "columns", NULL);
+    *dot='\0';
+    synthetic_add_table(groups[i], dot + 1, rows, key_step, key, columns ? columns : "");
+    g_free(key);
+    g_free(columns);
+  }
+  g_strfreev(groups);
+  g_key_file_free(kf);
+}
+
+static inline
+guint64 scaled(gdouble scale, guint64 value){
+  guint64 r=(guint64)(scale * value);
+  return r > 0 ? r : 1;
+}
+
+/*
+  About 1GB of data by scale unit, with the shapes that change the behavior of
+  mydumper and myloader: dense and sparse integer keys, UUID keys that cannot
+  be chunked, wide rows, blobs and many small tables in their own database.
+*/
+void synthetic_scale_schema(const gchar *database, gdouble scale){
+  gchar *small_database=g_strdup_printf("%s_small", database);
+  gchar *name=NULL;
+  GString *wide=g_string_new("");
+  guint64 i, small_tables=scaled(scale, 100);
+  for (i=0; i<8; i++)
+    g_string_append_printf(wide, "%sint,varchar(32),datetime,decimal,char(16),bigint,varchar(128),uuid", i > 0 ? "," : "");
+  synthetic_add_table(database, "orders", scaled(scale, 1000000), 1, "int", "int,bigint,decimal,datetime,varchar(32),varchar(255)");
+  synthetic_add_table(database, "sparse_keys", scaled(scale, 1000000), 1009, "int", "int,datetime,varchar(64)");
+  synthetic_add_table(database, "uuid_keys", scaled(scale, 1000000), 1, "uuid", "bigint,datetime,varchar(64)");
+  synthetic_add_table(database, "wide_rows", scaled(scale, 100000), 1, "int", wide->str);
+  synthetic_add_table(database, "blobs", scaled(scale, 10000), 1, "int", "int,blob(65535),varchar(255)");
+  for (i=0; i<small_tables; i++){
+    name=g_strdup_printf("small_%05"G_GUINT64_FORMAT, i + 1);
+    synthetic_add_table(small_database, name, 100, 1, "int", "int,varchar(32),datetime");
+    g_free(name);
+  }
+  g_string_free(wide, TRUE);
+  g_free(small_database);
+}
+
+struct synthetic_table *synthetic_find_table(const gchar *database, const gchar *table){
+  gchar *key=g_strdup_printf("%s.%s", database, table);
+  struct synthetic_table *t=g_hash_table_lookup(table_hash, key);
+  g_free(key);
+  return t;
+}
+
+gboolean synthetic_database_exists(const gchar *database){
+  guint i;
+  for (i=0; i<synthetic_databases->len; i++)
+    if (!g_strcmp0(g_ptr_array_index(synthetic_databases, i), database))
+      return TRUE;
+  return FALSE;
+}
+
+guint64 synthetic_total_rows(){
+  guint64 rows=0;
+  guint i;
+  for (i=0; i<synthetic_tables->len; i++)
+    rows+=((struct synthetic_table *)g_ptr_array_index(synthetic_tables, i))->rows;
+  return rows;
+}
+
+/* value points to buffer or to one of the pools, it is not NUL terminated */
+void synthetic_value(struct synthetic_column *column, guint position, guint64 id, gchar *buffer, gsize size, const gchar **value, gsize *length){
+  guint64 h=value_hash(id, position);
+  time_t t;
+  struct tm tm;
+  switch (column->kind){
+    case SYNTHETIC_KEY:
+      *length=g_snprintf(buffer, size, "%"G_GUINT64_FORMAT, id);
+      *value=buffer;
+      break;
+    case SYNTHETIC_INT:
+      *length=g_snprintf(buffer, size, "%d", (gint32)(h % G_MAXINT32));
+      *value=buffer;
+      break;
+    case SYNTHETIC_BIGINT:
+      *length=g_snprintf(buffer, size, "%"G_GINT64_FORMAT, (gint64)(h >> 1));
+      *value=buffer;
+      break;
+    case SYNTHETIC_DECIMAL:
+      *length=g_snprintf(buffer, size, "%u.%02u", (guint)(h % 100000000), (guint)((h >> 32) % 100));
+      *value=buffer;
+      break;
+    case SYNTHETIC_DATETIME:
+      // Between 2020-01-01 and 2024-12-30
+      t=1577836800 + h % 157680000;
+      gmtime_r(&t, &tm);
+      *length=strftime(buffer, size, "%Y-%m-%d %H:%M:%S", &tm);
+      *value=buffer;
+      break;
+    case SYNTHETIC_UUID:
+      *length=g_snprintf(buffer, size, "%08x-%04x-%04x-%04x-%012"G_GINT64_MODIFIER"x",
+                         (guint32)(h >> 32), (guint)((h >> 16) & 0xffff), (guint)(0x4000 | (h & 0x0fff)),
+                         (guint)(0x8000 | ((h >> 48) & 0x3fff)), value_hash(id, position + 1024) & 0xffffffffffffULL);
+      *value=buffer;
+      break;
+    case SYNTHETIC_CHAR:
+      *length=column->length;
+      *value=text_pool + h % (SYNTHETIC_POOL_SIZE - column->length);
+      break;
+    case SYNTHETIC_VARCHAR:
+      *length=column->length / 2 + (h >> 32) % (column->length - column->length / 2 + 1);
+      *value=text_pool + h % (SYNTHETIC_POOL_SIZE - column->length);
+      break;
+    case SYNTHETIC_BLOB:
+      *length=column->length / 2 + (h >> 32) % (column->length - column->length / 2 + 1);
+      *value=binary_pool + h % (SYNTHETIC_POOL_SIZE - column->length);
+      break;
+  }
+}
+
+/* Like SHOW CREATE TABLE */
+gchar *synthetic_create_table(struct synthetic_table *table){
+  GString *s=g_string_new("");
+  struct synthetic_column *column=NULL;
+  guint i;
+  g_string_append_printf(s, "CREATE TABLE `%s` (\n", table->name);
+  for (i=0; i<table->columns->len; i++){
+    column=g_ptr_array_index(table->columns, i);
+    g_string_append_printf(s, "  `%s` %s%s,\n", column->name, column->sql_type, i == 0 ? " NOT NULL" : " DEFAULT NULL");
+  }
+  g_string_append(s, "  PRIMARY KEY (`id`)\n) ENGINE=InnoDB DEFAULT CHARSET=utf8mb4 COLLATE=utf8mb4_0900_ai_ci");
+  return g_string_free(s, FALSE);
+}
@@ -0,0 +1,84 @@
+/*
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+        Authors:    David Ducos, Percona (david dot ducos at percona dot com)
+*/
+#ifndef _bench_synthetic_h
+#define _bench_synthetic_h
+#include <glib.h>
+
+/*
+  Synthetic tables shared by mydumper_fake_server and mydumper_dataset.
+
+  Rows are never stored: the value of a column is computed from a hash of the
+  id of the row and the position of the column, strings and blobs are slices
+  of buffers filled at startup with a fixed seed. The same description always
+  produces the same data, whatever the order in which the rows are requested.
+
+  The first column of every table is the primary key `id`, a bigint unsigned
+  that grows key_step by row, or a char(36) UUID computed from the row.
+*/
+
+#define SYNTHETIC_POOL_SIZE 1048576
+
+enum synthetic_kind {
+  SYNTHETIC_KEY,
+  SYNTHETIC_INT,
+  SYNTHETIC_BIGINT,
+  SYNTHETIC_DECIMAL,
+  SYNTHETIC_DATETIME,
+  SYNTHETIC_CHAR,
+  SYNTHETIC_VARCHAR,
+  SYNTHETIC_UUID,
+  SYNTHETIC_BLOB
+};
+
+struct synthetic_column {
+  gchar *name;
+  enum synthetic_kind kind;
+  guint length;
+  gchar *sql_type;
+};
+
+struct synthetic_table {
+  gchar *database;
+  gchar *name;
+  guint64 rows;
+  guint64 key_step;
+  GPtrArray *columns;
+};
+
+extern GPtrArray *synthetic_tables;
+extern GPtrArray *synthetic_databases;
+
+void synthetic_initialize();
+void synthetic_add_table(const gchar *database, const gchar *name, guint64 rows, guint64 key_step, const gchar *key, const gchar *columns);
+void synthetic_load_schema(const gchar *filename);
+void synthetic_scale_schema(const gchar *database, gdouble scale);
+struct synthetic_table *synthetic_find_table(const gchar *database, const gchar *table);
+gboolean synthetic_database_exists(const gchar *database);
+void synthetic_value(struct synthetic_column *column, guint position, guint64 id, gchar *buffer, gsize size, const gchar **value, gsize *length);
+gchar *synthetic_create_table(struct synthetic_table *table);
+guint64 synthetic_total_rows();
+
+static inline
+guint64 synthetic_key_of_row(struct synthetic_table *table, guint64 row){
+  return 1 + row * table->key_step;
+}
+
+static inline
+gboolean synthetic_is_quoted(enum synthetic_kind kind){
+  return kind >= SYNTHETIC_DATETIME;
+}
+#endif
@@ -1100,6 +1100,11 @@ void set_thread_name(const char *format, ...)
   __thread_name= __name_buf;
 }
 
+const char *get_thread_name()
+{
+  return __thread_name;
+}
+
 void trace(const char *format, ...)
 {
   if (!debug)
@@ -1318,3 +1323,81 @@ gboolean m_query(  MYSQL *conn, const gchar *query, void log_fun(const char *, .
   return TRUE;
 }
 
+
+/*
+  LIKE pattern, with | as escape, of a name in the filename encoding of the
+  server, that InnoDB uses for its tablespaces: my-db is my@002ddb. The ASCII
+  characters are encoded here. The code of a non ASCII character depends on
+  the character, so it is matched by a %, and the caller has to check that a
+  single tablespace matches. A doubled identifier_quote_character is one.
+*/
+static
+void append_filename_encoded_pattern(GString *pattern, const gchar *name){
+  const guchar *c;
+  for (c=(const guchar *)name; *c; c++){
+    if (*c == (guchar)identifier_quote_character && *(c+1) == *c)
+      c++;
+    if (g_ascii_isalnum(*c))
+      g_string_append_c(pattern, *c);
+    else if (*c == '_')
+      g_string_append(pattern, "|_");
+    else if (*c < 0x80)
+      g_string_append_printf(pattern, "@%04x", *c);
+    else{
+      while (*(c+1) >= 0x80 && *(c+1) < 0xC0)
+        c++;
+      g_string_append_c(pattern, '%');
+    }
+  }
+}
+
+/* The value of the single row of the query, NULL when there is none or several */
+static
+gchar *get_single_value(MYSQL *conn, const gchar *query, const gchar *name){
+  MYSQL_RES *res=NULL;
+  MYSQL_ROW row;
+  gchar *value=NULL;
+  if (mysql_query(conn, query) || !(res=mysql_store_result(conn))){
+    g_warning("Could not look for the tablespace of %s: %s", name, mysql_error(conn));
+    return NULL;
+  }
+  if (mysql_num_rows(res) > 1)
+    g_warning("There are %llu tablespaces for %s", (unsigned long long)mysql_num_rows(res), name);
+  else if ((row=mysql_fetch_row(res)) && row[0])
+    value=g_strdup(row[0]);
+  mysql_free_result(res);
+  return value;
+}
+
+/*
+  The path of the .ibd file of a table, without the extension, from the
+  InnoDB dictionary, as the directory and file names are filename encoded.
+  FILES has the path of the tablespaces out of the datadir too, and
+  INNODB_TABLESPACES still has the discarded ones, which are in the datadir.
+  NULL when the table has no file per table tablespace.
+*/
+gchar *get_tablespace_path(MYSQL *conn, const gchar *database, const gchar *table, const gchar *datadir){
+  GString *pattern=g_string_new("");
+  gchar *name=g_strdup_printf("%s.%s", database, table);
+  gchar *query=NULL, *file_name=NULL, *path=NULL;
+  append_filename_encoded_pattern(pattern, database);
+  g_string_append_c(pattern, '/');
+  append_filename_encoded_pattern(pattern, table);
+
+  query=g_strdup_printf("SELECT FILE_NAME FROM information_schema.FILES WHERE FILE_TYPE='TABLESPACE' AND TABLESPACE_NAME LIKE '%s' ESCAPE '|'", pattern->str);
+  file_name=get_single_value(conn, query, name);
+  g_free(query);
+  if (file_name == NULL){
+    query=g_strdup_printf("SELECT CONCAT(NAME, '.ibd') FROM information_schema.INNODB_TABLESPACES WHERE NAME LIKE '%s' ESCAPE '|'", pattern->str);
+    file_name=get_single_value(conn, query, name);
+    g_free(query);
+  }
+  if (file_name != NULL && g_str_has_suffix(file_name, ".ibd")){
+    file_name[strlen(file_name) - strlen(".ibd")]='\0';
+    path=g_path_is_absolute(file_name) ? g_strdup(file_name) : g_build_filename(datadir, file_name, NULL);
+  }
+  g_free(file_name);
+  g_free(name);
+  g_string_free(pattern, TRUE);
+  return path;
+}
@@ -168,6 +168,7 @@ char * backtick_protect(char *r);
 char * newline_protect(char *r);
 char * newline_unprotect(char *r);
 void set_thread_name(const char *format, ...);
+const char *get_thread_name();
 extern void trace(const char *format, ...);
 #define message(...) \
   if (debug) \
@@ -200,3 +201,4 @@ void discard_mysql_output(MYSQL *conn);
 gboolean m_query(  MYSQL *conn, const gchar *query, void log_fun(const char *, ...) , const char *fmt, ...);
 gboolean create_dir(gchar *directory);
 gchar *build_tmp_dir_name();
+gchar *get_tablespace_path(MYSQL *conn, const gchar *database, const gchar *table, const gchar *datadir);
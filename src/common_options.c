@@ -22,6 +22,9 @@
 #include "common.h"
 #include "config.h"
 #include "common_options.h"
+#include "trace_file.h"
+#include "metrics.h"
+#include "table_history.h"
 char *db = NULL;
 char *defaults_file = NULL;
 char *defaults_extra_file = NULL;
@@ -81,6 +84,12 @@ GOptionEntry common_entries[] = {
      NULL},
     {"debug", 0, 0, G_OPTION_ARG_NONE, &debug, "Turn on debugging output "
      "(automatically sets verbosity to 3)", NULL},
+    {"trace-file", 0, 0, G_OPTION_ARG_FILENAME, &trace_file,
+     "Writes the begin and end of every job in Chrome trace format, to be opened with Perfetto", NULL},
+    {"bottleneck-report", 0, 0, G_OPTION_ARG_NONE, &bottleneck_report,
+     "Accounts where the time of each thread goes and prints a summary at the end", NULL},
+    {"history-file", 0, 0, G_OPTION_ARG_FILENAME, &history_file,
+     "Loads the statistics of every table from the previous runs to tune this one, and saves the statistics of this run at the end. Use a file per program", NULL},
     {"defaults-file", 0, 0, G_OPTION_ARG_FILENAME, &defaults_file,
      "Use a specific defaults file. Default: /etc/mydumper.cnf", NULL},
     {"defaults-extra-file", 0, 0, G_OPTION_ARG_FILENAME, &defaults_extra_file,
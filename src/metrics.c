@@ -0,0 +1,386 @@
+/*
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+        Authors:    David Ducos, Percona (david dot ducos at percona dot com)
+*/
+#include <mysql.h>
+#include <glib.h>
+#include <gio/gio.h>
+#include <stdarg.h>
+#include <string.h>
+#include "common.h"
+#include "metrics.h"
+
+/*
+  Metrics shared by mydumper and myloader.
+
+  The hot paths only do atomic additions: every thread owns a slot with its
+  counters, the tables own their counters and the histograms have a fixed set
+  of buckets. The slots are registered once per thread, which is the only
+  place that takes a lock. The content is built when it is requested, by the
+  HTTP endpoint or by the PMM thread, so nothing is done while nobody is
+  looking at it. Everything is a counter, the per second values are obtained
+  with rate() on the Prometheus side.
+
+  The threads also account where their time goes: metrics_thread_state()
+  closes the interval of the current state and starts the new one, so the
+  states of a thread always add up to its lifetime. --bottleneck-report
+  prints the share of each state when the process ends.
+*/
+
+gboolean metrics_enabled = FALSE;
+guint metrics_port = 0;
+gchar *metrics_address = NULL;
+gboolean bottleneck_report = FALSE;
+
+struct metrics_thread {
+  gchar *name;
+  struct metrics_counters counters;
+  gsize state_time[THREAD_STATES];
+  // Only used by the owner of the slot
+  enum thread_state state;
+  gint64 state_since;
+};
+
+static const gchar *thread_state_names[THREAD_STATES] = {
+  "other", "server", "serialize", "write", "compress", "read", "queue" };
+
+/* What to look at when a state takes most of the time */
+static const gchar *thread_state_hints[THREAD_STATES] = {
+  "time outside the accounted states",
+  "waiting on the MySQL server: more threads help only if the server is not saturated",
+  "local CPU escaping and building statements: more threads or a faster CPU",
+  "writing to disk: a faster disk or less threads writing at the same time",
+  "waiting on the compressor: use a faster compression method or level",
+  "reading from disk: a faster disk or more read ahead",
+  "idle waiting for jobs: less threads, or smaller chunks to balance the work" };
+
+struct metrics_histogram {
+  const gchar *name;
+  gsize buckets[METRICS_HISTOGRAM_BUCKETS];
+  gsize count;
+  gsize sum;
+};
+
+/* Upper bounds in microseconds, the last bucket is +Inf */
+static const gint64 bucket_bounds[METRICS_HISTOGRAM_BUCKETS - 1] = {
+  1000, 5000, 10000, 50000, 100000, 500000,
+  1000000, 5000000, 10000000, 30000000, 60000000, 300000000 };
+
+static struct metrics_histogram histograms[METRICS_HISTOGRAMS] = {
+  { "chunk_query_seconds", {0}, 0, 0 },
+  { "write_seconds", {0}, 0, 0 },
+  { "compression_wait_seconds", {0}, 0, 0 },
+  { "queue_wait_seconds", {0}, 0, 0 },
+  { "statement_seconds", {0}, 0, 0 } };
+
+static GMutex *threads_mutex = NULL;
+static GPtrArray *threads_metrics = NULL;
+static GPrivate current_thread_metrics = G_PRIVATE_INIT(NULL);
+
+static GSocketListener *metrics_listener = NULL;
+static GCancellable *metrics_cancellable = NULL;
+static GThread *metrics_t = NULL;
+static void (*metrics_fill)(GString *content, gpointer data) = NULL;
+static gpointer metrics_fill_data = NULL;
+
+void initialize_metrics(){
+  if (metrics_enabled)
+    return;
+  threads_mutex=g_mutex_new();
+  threads_metrics=g_ptr_array_new();
+  metrics_enabled=TRUE;
+}
+
+static inline
+void counter_add(gsize *counter, guint64 value){
+  g_atomic_pointer_add(counter, (gssize)value);
+}
+
+static inline
+gsize counter_get(gsize *counter){
+  return (gsize)g_atomic_pointer_get(counter);
+}
+
+void metrics_observe(enum metrics_histogram_type type, gint64 usec){
+  if (!metrics_enabled)
+    return;
+  struct metrics_histogram *h=&histograms[type];
+  guint i=0;
+  if (usec < 0)
+    usec=0;
+  while (i < METRICS_HISTOGRAM_BUCKETS - 1 && usec > bucket_bounds[i])
+    i++;
+  counter_add(&(h->buckets[i]), 1);
+  counter_add(&(h->sum), usec);
+  counter_add(&(h->count), 1);
+}
+
+void metrics_counters_add(struct metrics_counters *counters, guint64 rows, guint64 bytes){
+  if (!metrics_enabled)
+    return;
+  counter_add(&(counters->rows), rows);
+  counter_add(&(counters->bytes), bytes);
+}
+
+void metrics_counters_add_time(struct metrics_counters *counters, gint64 usec){
+  if (!metrics_enabled || usec < 0)
+    return;
+  counter_add(&(counters->usec), usec);
+}
+
+/* Threads with the same name share the slot, as the threads are created again
+   on every snapshot in daemon mode */
+void metrics_register_thread(const char *format, ...){
+  if (!metrics_enabled)
+    return;
+  va_list args;
+  va_start(args, format);
+  gchar *name=g_strdup_vprintf(format, args);
+  va_end(args);
+  struct metrics_thread *mt=NULL;
+  guint i;
+  g_mutex_lock(threads_mutex);
+  for (i=0; i<threads_metrics->len; i++){
+    if (!g_strcmp0(((struct metrics_thread *)g_ptr_array_index(threads_metrics, i))->name, name)){
+      mt=g_ptr_array_index(threads_metrics, i);
+      break;
+    }
+  }
+  if (mt == NULL){
+    mt=g_new0(struct metrics_thread, 1);
+    mt->name=name;
+    g_ptr_array_add(threads_metrics, mt);
+  }else
+    g_free(name);
+  g_mutex_unlock(threads_mutex);
+  mt->state=THREAD_STATE_OTHER;
+  mt->state_since=g_get_monotonic_time();
+  g_private_set(&current_thread_metrics, mt);
+}
+
+/* Returns the previous state, to be restored by the nested states */
+enum thread_state metrics_thread_state(enum thread_state state){
+  if (!metrics_enabled)
+    return THREAD_STATE_OTHER;
+  struct metrics_thread *mt=g_private_get(&current_thread_metrics);
+  if (mt == NULL)
+    return THREAD_STATE_OTHER;
+  gint64 now=g_get_monotonic_time();
+  enum thread_state previous=mt->state;
+  counter_add(&(mt->state_time[previous]), now - mt->state_since);
+  mt->state=state;
+  mt->state_since=now;
+  return previous;
+}
+
+static
+void append_thread_states(GString *line, gsize *state_time){
+  gsize total=0;
+  guint i;
+  for (i=0; i<THREAD_STATES; i++)
+    total+=state_time[i];
+  for (i=0; i<THREAD_STATES; i++)
+    if (state_time[i] > 0)
+      g_string_append_printf(line, " | %s %.1f%%", thread_state_names[i], total ? (gdouble)state_time[i] * 100 / total : 0);
+}
+
+void print_bottleneck_report(){
+  struct metrics_thread *mt=NULL;
+  gsize all_threads[THREAD_STATES]={0};
+  guint i, s, bottleneck=THREAD_STATE_OTHER;
+  gsize total=0;
+  if (!bottleneck_report || !metrics_enabled)
+    return;
+  GString *line=g_string_new("");
+  g_message("Bottleneck report, share of the time of each thread:");
+  g_mutex_lock(threads_mutex);
+  for (i=0; i<threads_metrics->len; i++){
+    mt=g_ptr_array_index(threads_metrics, i);
+    gsize state_time[THREAD_STATES], thread_total=0;
+    for (s=0; s<THREAD_STATES; s++){
+      state_time[s]=counter_get(&(mt->state_time[s]));
+      all_threads[s]+=state_time[s];
+      thread_total+=state_time[s];
+    }
+    g_string_printf(line, "%s: %.1f seconds", mt->name, (gdouble)thread_total / G_USEC_PER_SEC);
+    append_thread_states(line, state_time);
+    g_message("%s", line->str);
+  }
+  g_mutex_unlock(threads_mutex);
+  for (s=0; s<THREAD_STATES; s++){
+    total+=all_threads[s];
+    if (s != THREAD_STATE_OTHER && all_threads[s] > all_threads[bottleneck])
+      bottleneck=s;
+  }
+  g_string_printf(line, "All threads: %.1f seconds", (gdouble)total / G_USEC_PER_SEC);
+  append_thread_states(line, all_threads);
+  g_message("%s", line->str);
+  if (total > 0)
+    g_message("Most of the time is spent %s (%.1f%%): %s", thread_state_names[bottleneck],
+              (gdouble)all_threads[bottleneck] * 100 / total, thread_state_hints[bottleneck]);
+  g_string_free(line, TRUE);
+}
+
+void metrics_thread_add(guint64 rows, guint64 bytes){
+  if (!metrics_enabled)
+    return;
+  struct metrics_thread *mt=g_private_get(&current_thread_metrics);
+  if (mt)
+    metrics_counters_add(&(mt->counters), rows, bytes);
+}
+
+static
+void append_label_value(GString *content, const gchar *value){
+  const gchar *c;
+  for (c=value; *c; c++){
+    if (*c == '\\' || *c == '"')
+      g_string_append_c(content, '\\');
+    if (*c == '\n')
+      g_string_append(content, "\\n");
+    else
+      g_string_append_c(content, *c);
+  }
+}
+
+void append_metrics_histogram(GString *content, const gchar *program, enum metrics_histogram_type type){
+  struct metrics_histogram *h=&histograms[type];
+  gsize cumulative=0;
+  guint i;
+  g_string_append_printf(content, "# TYPE %s_%s histogram\n", program, h->name);
+  for (i=0; i < METRICS_HISTOGRAM_BUCKETS - 1; i++){
+    cumulative+=counter_get(&(h->buckets[i]));
+    g_string_append_printf(content, "%s_%s_bucket{le=\"%g\"} %"G_GSIZE_FORMAT"\n", program, h->name, (gdouble)bucket_bounds[i] / G_USEC_PER_SEC, cumulative);
+  }
+  cumulative+=counter_get(&(h->buckets[i]));
+  g_string_append_printf(content, "%s_%s_bucket{le=\"+Inf\"} %"G_GSIZE_FORMAT"\n", program, h->name, cumulative);
+  g_string_append_printf(content, "%s_%s_sum %.6f\n", program, h->name, (gdouble)counter_get(&(h->sum)) / G_USEC_PER_SEC);
+  g_string_append_printf(content, "%s_%s_count %"G_GSIZE_FORMAT"\n", program, h->name, cumulative);
+}
+
+void append_metrics_threads(GString *content, const gchar *program){
+  struct metrics_thread *mt=NULL;
+  guint i, s;
+  if (!metrics_enabled)
+    return;
+  g_mutex_lock(threads_mutex);
+  for (i=0; i<threads_metrics->len; i++){
+    mt=g_ptr_array_index(threads_metrics, i);
+    g_string_append_printf(content, "%s_thread_rows_total{thread=\"%s\"} %"G_GSIZE_FORMAT"\n", program, mt->name, counter_get(&(mt->counters.rows)));
+    g_string_append_printf(content, "%s_thread_bytes_total{thread=\"%s\"} %"G_GSIZE_FORMAT"\n", program, mt->name, counter_get(&(mt->counters.bytes)));
+    for (s=0; s<THREAD_STATES; s++)
+      g_string_append_printf(content, "%s_thread_state_seconds_total{thread=\"%s\",state=\"%s\"} %.6f\n", program, mt->name, thread_state_names[s], (gdouble)counter_get(&(mt->state_time[s])) / G_USEC_PER_SEC);
+  }
+  g_mutex_unlock(threads_mutex);
+}
+
+void append_metrics_table(GString *content, const gchar *program, const gchar *database, const gchar *table, struct metrics_counters *counters){
+  g_string_append_printf(content, "%s_table_rows_total{database=\"", program);
+  append_label_value(content, database);
+  g_string_append(content, "\",table=\"");
+  append_label_value(content, table);
+  g_string_append_printf(content, "\"} %"G_GSIZE_FORMAT"\n", counter_get(&(counters->rows)));
+  g_string_append_printf(content, "%s_table_bytes_total{database=\"", program);
+  append_label_value(content, database);
+  g_string_append(content, "\",table=\"");
+  append_label_value(content, table);
+  g_string_append_printf(content, "\"} %"G_GSIZE_FORMAT"\n", counter_get(&(counters->bytes)));
+  g_string_append_printf(content, "%s_table_seconds_total{database=\"", program);
+  append_label_value(content, database);
+  g_string_append(content, "\",table=\"");
+  append_label_value(content, table);
+  g_string_append_printf(content, "\"} %.6f\n", (gdouble)counter_get(&(counters->usec)) / G_USEC_PER_SEC);
+}
+
+static
+void serve_metrics_request(GSocketConnection *connection){
+  GInputStream *in=g_io_stream_get_input_stream(G_IO_STREAM(connection));
+  GOutputStream *out=g_io_stream_get_output_stream(G_IO_STREAM(connection));
+  gchar request[1024];
+  // Only the request line matters, the rest of the request is discarded
+  gssize len=g_input_stream_read(in, request, sizeof(request) - 1, metrics_cancellable, NULL);
+  if (len <= 0)
+    return;
+  request[len]='\0';
+  GString *content=g_string_sized_new(4096);
+  const gchar *status="200 OK";
+  if (g_str_has_prefix(request, "GET /metrics") || g_str_has_prefix(request, "GET / "))
+    metrics_fill(content, metrics_fill_data);
+  else{
+    status="404 Not Found";
+    g_string_append(content, "Not Found\n");
+  }
+  GString *response=g_string_sized_new(content->len + 128);
+  g_string_printf(response, "HTTP/1.0 %s\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: %"G_GSIZE_FORMAT"\r\nConnection: close\r\n\r\n", status, content->len);
+  g_string_append_len(response, content->str, content->len);
+  g_output_stream_write_all(out, response->str, response->len, NULL, metrics_cancellable, NULL);
+  g_string_free(response, TRUE);
+  g_string_free(content, TRUE);
+}
+
+static
+void *metrics_server_thread(void *data){
+  (void) data;
+  GSocketConnection *connection=NULL;
+  GError *error=NULL;
+  set_thread_name("MET");
+  trace("Thread metrics_server_thread started");
+  while ((connection=g_socket_listener_accept(metrics_listener, NULL, metrics_cancellable, &error)) != NULL){
+    // A client that does not send its request must not block the endpoint
+    g_socket_set_timeout(g_socket_connection_get_socket(connection), 5);
+    serve_metrics_request(connection);
+    g_io_stream_close(G_IO_STREAM(connection), NULL, NULL);
+    g_object_unref(connection);
+  }
+  if (!g_cancellable_is_cancelled(metrics_cancellable))
+    g_warning("Metrics endpoint stopped: %s", error->message);
+  g_clear_error(&error);
+  trace("Thread metrics_server_thread finished");
+  return NULL;
+}
+
+void start_metrics_server(void (*fill)(GString *content, gpointer data), gpointer data){
+  GError *error=NULL;
+  if (metrics_port == 0)
+    return;
+  if (metrics_address == NULL)
+    metrics_address=g_strdup("127.0.0.1");
+  GInetAddress *inet_address=g_inet_address_new_from_string(metrics_address);
+  if (inet_address == NULL)
+    m_critical("Invalid metrics address: %s", metrics_address);
+  GSocketAddress *socket_address=g_inet_socket_address_new(inet_address, metrics_port);
+  g_object_unref(inet_address);
+  metrics_listener=g_socket_listener_new();
+  if (!g_socket_listener_add_address(metrics_listener, socket_address, G_SOCKET_TYPE_STREAM, G_SOCKET_PROTOCOL_TCP, NULL, NULL, &error))
+    m_critical("Could not listen on %s:%u for metrics: %s", metrics_address, metrics_port, error->message);
+  g_object_unref(socket_address);
+  metrics_fill=fill;
+  metrics_fill_data=data;
+  metrics_cancellable=g_cancellable_new();
+  g_message("Serving metrics on http://%s:%u/metrics", metrics_address, metrics_port);
+  metrics_t=g_thread_new("metrics", (GThreadFunc)metrics_server_thread, NULL);
+}
+
+void stop_metrics_server(){
+  if (metrics_t == NULL)
+    return;
+  g_cancellable_cancel(metrics_cancellable);
+  g_thread_join(metrics_t);
+  metrics_t=NULL;
+  g_socket_listener_close(metrics_listener);
+  g_object_unref(metrics_listener);
+  metrics_listener=NULL;
+  g_object_unref(metrics_cancellable);
+  metrics_cancellable=NULL;
+}
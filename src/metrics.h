@@ -0,0 +1,69 @@
+/*
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+        Authors:    David Ducos, Percona (david dot ducos at percona dot com)
+*/
+#ifndef _src_metrics_h
+#define _src_metrics_h
+#include <glib.h>
+
+#define METRICS_HISTOGRAM_BUCKETS 13
+
+enum metrics_histogram_type {
+  METRICS_CHUNK_QUERY,
+  METRICS_WRITE,
+  METRICS_COMPRESSION_WAIT,
+  METRICS_QUEUE_WAIT,
+  METRICS_STATEMENT,
+  METRICS_HISTOGRAMS
+};
+
+/* Where the time of a thread goes, see metrics_thread_state() */
+enum thread_state {
+  THREAD_STATE_OTHER,
+  THREAD_STATE_SERVER,
+  THREAD_STATE_SERIALIZE,
+  THREAD_STATE_WRITE,
+  THREAD_STATE_COMPRESS,
+  THREAD_STATE_READ,
+  THREAD_STATE_QUEUE,
+  THREAD_STATES
+};
+
+/* Updated with atomic operations, they can be read at any time */
+struct metrics_counters {
+  gsize rows;
+  gsize bytes;
+  gsize usec;
+};
+
+extern gboolean metrics_enabled;
+extern guint metrics_port;
+extern gchar *metrics_address;
+extern gboolean bottleneck_report;
+
+void initialize_metrics();
+void metrics_observe(enum metrics_histogram_type type, gint64 usec);
+void metrics_counters_add(struct metrics_counters *counters, guint64 rows, guint64 bytes);
+void metrics_counters_add_time(struct metrics_counters *counters, gint64 usec);
+void metrics_register_thread(const char *format, ...);
+void metrics_thread_add(guint64 rows, guint64 bytes);
+enum thread_state metrics_thread_state(enum thread_state state);
+void print_bottleneck_report();
+void append_metrics_histogram(GString *content, const gchar *program, enum metrics_histogram_type type);
+void append_metrics_threads(GString *content, const gchar *program);
+void append_metrics_table(GString *content, const gchar *program, const gchar *database, const gchar *table, struct metrics_counters *counters);
+void start_metrics_server(void (*fill)(GString *content, gpointer data), gpointer data);
+void stop_metrics_server();
+#endif
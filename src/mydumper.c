@@ -42,6 +42,11 @@
 #include "mydumper_daemon_thread.h"
 #include "mydumper_global.h"
 #include "mydumper_arguments.h"
+#include "mydumper_common.h"
+#include "trace_file.h"
+#include "table_history.h"
+#include "mydumper_plan.h"
+#include "mydumper_file_handler.h"
 const char DIRECTORY[] = "export";
 
 /* Some earlier versions of MySQL do not yet define MYSQL_TYPE_JSON */
@@ -190,6 +195,8 @@ int main(int argc, char *argv[]) {
     print_bool("skip-ddl-locks",skip_ddl_locks);
     print_string("pmm-path",pmm_path);
     print_string("pmm-resolution",pmm_resolution);
+    print_int("metrics-port",metrics_port);
+    print_string("metrics-address",metrics_address);
     print_int("exec-threads",num_exec_threads);
     print_string("exec",exec_command);
     print_string("exec-per-thread",exec_per_thread);
@@ -215,10 +222,12 @@ int main(int argc, char *argv[]) {
     print_bool("routines",dump_routines);
     print_bool("views-as-tables",views_as_tables);
     print_bool("no-views",no_dump_views);
+    print_string("transportable-tables",transportable_tables_list);
     print_bool("load-data",load_data);
     print_bool("csv",csv);
     print_bool("clickhouse",clickhouse);
     print_bool("include-header",include_header);
+    print_bool("select-into-outfile",select_into_outfile);
     print_string("fields-terminated-by",fields_terminated_by_ld);
     print_string("fields-enclosed-by",fields_enclosed_by_ld);
     print_string("fields-escaped-by",fields_escaped_by);
@@ -253,6 +262,12 @@ int main(int argc, char *argv[]) {
     print_bool("dirty",dirty_dumpdir);
     print_bool("stream",stream);
     print_string("logfile",logfile);
+    print_string("trace-file",trace_file);
+    print_string("history-file",history_file);
+    print_bool("bottleneck-report",bottleneck_report);
+    print_bool("plan",plan);
+    print_bool("null-output",null_output);
+    print_bool("null-output-checksum",null_output_checksum);
     print_string("disk-limits",disk_limits);
     print_int("threads",num_threads);
     print_bool("version",program_version);
@@ -262,7 +277,19 @@ int main(int argc, char *argv[]) {
     print_string("defaults-extra-file",defaults_extra_file);
     exit(EXIT_SUCCESS);
   }
-  
+
+  if (plan){
+    if (daemon_mode || stream)
+      m_critical("--plan is not supported with --daemon or --stream");
+    initialize_plan();
+    // Nothing is kept from the run, the metadata goes to a temporary directory
+    if (output_directory != output_directory_param)
+      g_free(output_directory);
+    output_directory=g_dir_make_tmp("mydumper-plan-XXXXXX", NULL);
+    if (output_directory == NULL)
+      m_critical("Could not create a temporary directory for --plan");
+  }
+
   create_dir(output_directory);
 
   if (disk_limits!=NULL){
@@ -273,6 +300,7 @@ int main(int argc, char *argv[]) {
     use_defer= FALSE;
   }
 
+  initialize_trace_file("mydumper");
   if (daemon_mode) {
     clear_dumpdir= TRUE;
     initialize_daemon_thread();
@@ -281,6 +309,14 @@ int main(int argc, char *argv[]) {
     dump_directory = output_directory;
     start_dump();
   }
+  finish_trace_file();
+  print_bottleneck_report();
+  print_null_output_report();
+  if (plan){
+    print_plan();
+    clear_dump_directory(output_directory);
+    g_rmdir(output_directory);
+  }
 
   if (logoutfile) {
     fclose(logoutfile);
@@ -121,6 +121,10 @@ static GOptionEntry extra_entries[] = {
     {"compact", 0, 0, G_OPTION_ARG_NONE, &compact, "Give less verbose output. Disables header/footer constructs.", NULL},
     {"compress", 'c', G_OPTION_FLAG_OPTIONAL_ARG, G_OPTION_ARG_CALLBACK , &arguments_callback,
      "Compress output files using: /usr/bin/gzip and /usr/bin/zstd. Options: GZIP and ZSTD. Default: GZIP", NULL},
+    {"null-output", 0, 0, G_OPTION_ARG_NONE, &null_output,
+     "Serialize the data but discard it instead of writing the files, and report the MB/s of every table. Measures the extraction throughput without the disk", NULL},
+    {"null-output-checksum", 0, 0, G_OPTION_ARG_NONE, &null_output_checksum,
+     "Checksum the bytes discarded by --null-output", NULL},
     {"use-defer", 0, 0, G_OPTION_ARG_NONE, &use_defer,
      "Use defer integer sharding until all non-integer PK tables processed (saves RSS for huge quantities of tables)", NULL},
     {"check-row-count", 0, 0, G_OPTION_ARG_NONE, &check_row_count,
@@ -178,6 +182,10 @@ static GOptionEntry pmm_entries[] = {
       "which default value will be /usr/local/percona/pmm2/collectors/textfile-collector/high-resolution", NULL },
     { "pmm-resolution", 0, 0, G_OPTION_ARG_STRING, &pmm_resolution,
       "which default will be high", NULL },
+    { "metrics-port", 0, 0, G_OPTION_ARG_INT, &metrics_port,
+      "Serves the metrics in Prometheus format over HTTP on this port. Default: 0 (disabled)", NULL },
+    { "metrics-address", 0, 0, G_OPTION_ARG_STRING, &metrics_address,
+      "Address where the metrics endpoint listens. Default: 127.0.0.1", NULL },
     {NULL, 0, 0, G_OPTION_ARG_NONE, NULL, NULL, NULL}};
 
 
@@ -204,6 +212,8 @@ static GOptionEntry chunks_entries[] = {
      NULL},
     { "split-partitions", 0, 0, G_OPTION_ARG_NONE, &split_partitions,
       "Dump partitions into separate files. This options overrides the --rows option for partitioned tables.", NULL},
+    {"plan", 0, 0, G_OPTION_ARG_NONE, &plan,
+     "Select the chunks of every table and print the chunk plan, the threads schedule and why tables are dumped with a full scan, without dumping data", NULL},
     {NULL, 0, 0, G_OPTION_ARG_NONE, NULL, NULL, NULL}
 };
 
@@ -252,6 +262,8 @@ static GOptionEntry objects_entries[] = {
      NULL},
     {"no-views", 'W', 0, G_OPTION_ARG_NONE, &no_dump_views, "Do not dump VIEWs",
      NULL},
+    {"transportable-tables", 0, 0, G_OPTION_ARG_STRING, &transportable_tables_list,
+     "Comma delimited list of InnoDB tables that are copied with FLUSH TABLES FOR EXPORT instead of being dumped. mydumper and myloader need to run on the database host", NULL},
     {NULL, 0, 0, G_OPTION_ARG_NONE, NULL, NULL, NULL}};
 
 
@@ -262,6 +274,7 @@ static GOptionEntry statement_entries[] = {
       "Automatically enables --load-data and set variables to export in CSV format. This option will be deprecated on future releases use --format", NULL },
     {"format", 0, 0, G_OPTION_ARG_CALLBACK, &arguments_callback, "Set the output format which can be INSERT, LOAD_DATA, CSV or CLICKHOUSE. Default: INSERT", NULL },
     {"include-header", 0, 0, G_OPTION_ARG_NONE, &include_header, "When --load-data or --csv is used, it will include the header with the column name", NULL},
+    {"select-into-outfile", 0, 0, G_OPTION_ARG_NONE, &select_into_outfile, "When --load-data or --csv is used, the server writes the rows with SELECT INTO OUTFILE. mydumper needs to run on the database host and the output directory needs to be in secure_file_priv", NULL},
     {"fields-terminated-by", 0, 0, G_OPTION_ARG_STRING, &fields_terminated_by_ld,"Defines the character that is written between fields", NULL },
     {"fields-enclosed-by", 0, 0, G_OPTION_ARG_STRING, &fields_enclosed_by_ld,"Defines the character to enclose fields. Default: \"", NULL },
     {"fields-escaped-by", 0, 0, G_OPTION_ARG_STRING, &fields_escaped_by,
@@ -40,6 +40,7 @@
 #include "mydumper_integer_chunks.h"
 #include "mydumper_char_chunks.h"
 #include "mydumper_partition_chunks.h"
+#include "mydumper_less_locking.h"
 
 GAsyncQueue *give_me_another_innodb_chunk_step_queue;
 GAsyncQueue *give_me_another_non_innodb_chunk_step_queue;
@@ -117,6 +118,7 @@ struct chunk_step_item * initialize_chunk_step_item (MYSQL *conn, struct db_tabl
 
     if (!minmax){
       g_message("It is NONE with minmax == NULL");
+      dbt->no_chunk_reason= field ? "the MIN/MAX query on the key failed" : "there is no primary key or usable index";
       return new_none_chunk_step();
     }
 
@@ -129,6 +131,7 @@ struct chunk_step_item * initialize_chunk_step_item (MYSQL *conn, struct db_tabl
       if (minmax)
         mysql_free_result(minmax);
       g_message("It is NONE with row == NULL");
+      dbt->no_chunk_reason="the key has no values, the table is empty";
       return new_none_chunk_step();
     }
   /* Support just bigger INTs for now, very dumb, no verify approach */
@@ -203,6 +206,7 @@ struct chunk_step_item * initialize_chunk_step_item (MYSQL *conn, struct db_tabl
 
         }else{
           trace("Integer PK on `%s`.`%s` performing full table scan",dbt->database->name, dbt->table);
+          dbt->no_chunk_reason="the key range is not larger than the minimum rows per chunk";
           return new_none_chunk_step();
         }
         break;
@@ -211,6 +215,7 @@ struct chunk_step_item * initialize_chunk_step_item (MYSQL *conn, struct db_tabl
 
         if (minmax)
           mysql_free_result(minmax);
+        dbt->no_chunk_reason="the key is a string and char chunks are disabled";
         return new_none_chunk_step();
 
         csi=new_char_step_item(conn, TRUE, prefix, dbt->primary_key->data, 0, 0, row, lengths, NULL);
@@ -222,6 +227,7 @@ struct chunk_step_item * initialize_chunk_step_item (MYSQL *conn, struct db_tabl
         if (minmax)
           mysql_free_result(minmax);
         g_message("It is NONE: default");
+        dbt->no_chunk_reason="the key is not an integer";
         return new_none_chunk_step();
         break;
       }
@@ -296,6 +302,7 @@ void set_chunk_strategy_for_dbt(MYSQL *conn, struct db_table *dbt){
   g_message("%s.%s has %s%lu rows", dbt->database->name, dbt->table,
             (check_row_count ? "": "~"), rows);
   dbt->rows_total= rows;
+  dbt->no_chunk_reason=NULL;
   if (rows > (dbt->min_chunk_step_size!=0?dbt->min_chunk_step_size:MIN_CHUNK_STEP_SIZE)){
     GList *partitions=NULL;
     if (split_partitions || dbt->partition_regex){
@@ -313,10 +320,12 @@ void set_chunk_strategy_for_dbt(MYSQL *conn, struct db_table *dbt){
       if (dbt->split_integer_tables) {
         csi = initialize_chunk_step_item(conn, dbt, 0, NULL, rows);
       }else{
+        dbt->no_chunk_reason="splitting is disabled by --rows";
         csi = new_none_chunk_step();
       }
     }
   }else{
+    dbt->no_chunk_reason="the estimated rows are not over the minimum rows per chunk";
     csi = new_none_chunk_step();
   }
 //  dbt->initial_chunk_step=csi;
@@ -399,6 +408,7 @@ gboolean get_next_dbt_and_chunk_step_item(struct db_table **dbt_pointer,struct c
   struct db_table *dbt;
   gboolean are_there_jobs_defining=FALSE;
   struct chunk_step_item *lcs;
+  GList *tables_dumped=NULL;
 //  struct chunk_step_item *(*get_next)(struct db_table *dbt);
   while (iter){
     dbt=iter->data;
@@ -429,6 +439,8 @@ gboolean get_next_dbt_and_chunk_step_item(struct db_table **dbt_pointer,struct c
       if (lcs->chunk_type == NONE){
         *dbt_pointer=iter->data;
         *csi = lcs;
+        dbt->jobs_in_flight++;
+        dbt->all_jobs_enqueued=TRUE;
         dbt_list->list=g_list_remove(dbt_list->list,dbt);
         g_mutex_unlock(dbt->chunks_mutex);
         break;
@@ -444,12 +456,16 @@ gboolean get_next_dbt_and_chunk_step_item(struct db_table **dbt_pointer,struct c
       if (lcs!=NULL){
         *dbt_pointer=iter->data;
         *csi = lcs;
+        dbt->jobs_in_flight++;
         g_mutex_unlock(dbt->chunks_mutex);
         break;
       }else{
         iter=iter->next;
         // Assign iter previous removing dbt from list is important as we might break the list
         dbt_list->list=g_list_remove(dbt_list->list,dbt);
+        dbt->all_jobs_enqueued=TRUE;
+        if (dbt->jobs_in_flight == 0 && dbt->locked_table)
+          tables_dumped=g_list_prepend(tables_dumped, dbt);
         g_mutex_unlock(dbt->chunks_mutex);
         continue;
       }
@@ -461,6 +477,10 @@ next:
     iter=iter->next;
   }
   g_mutex_unlock(dbt_list->mutex);
+  // Tables whose last job finished before they were removed from the list
+  for (iter=tables_dumped; iter != NULL; iter=iter->next)
+    non_innodb_table_dumped(iter->data);
+  g_list_free(tables_dumped);
   return are_there_jobs_defining;
 }
 
@@ -21,6 +21,7 @@
 #include "mydumper_global.h"
 #include "common.h"
 #include "regex.h"
+#include "mydumper_discovery.h"
 
 GHashTable *database_hash = NULL;
 GMutex * database_hash_mutex = NULL;
@@ -35,6 +36,18 @@ void free_database(struct database * d){
     g_mutex_free(d->ad_mutex);
     d->ad_mutex=NULL;
   }
+  if (d->table_discovery){
+    g_hash_table_destroy(d->table_discovery);
+    d->table_discovery=NULL;
+  }
+  if (d->tables_with_triggers){
+    g_hash_table_destroy(d->tables_with_triggers);
+    d->tables_with_triggers=NULL;
+  }
+  if (d->discovery_mutex){
+    g_mutex_free(d->discovery_mutex);
+    d->discovery_mutex=NULL;
+  }
 /*  if (d->name!=NULL){
     g_free(d->name);
     d->name=NULL;
@@ -61,6 +74,9 @@ struct database * new_database(MYSQL *conn, char *database_name, gboolean alread
   d->schema_checksum=NULL;
   d->post_checksum=NULL;
   d->triggers_checksum=NULL;
+  d->table_discovery=NULL;
+  d->tables_with_triggers=NULL;
+  d->discovery_mutex=g_mutex_new();
   d->dump_triggers= !is_regex_being_used() && tables_list == NULL && g_hash_table_size(conf_per_table.all_object_to_export)==0;
   g_hash_table_insert(database_hash, d->name,d);
   return d;
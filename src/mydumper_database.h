@@ -26,6 +26,9 @@ struct database {
   gchar *post_checksum;
   gchar *triggers_checksum;
   gboolean dump_triggers;
+  GHashTable *table_discovery;
+  GHashTable *tables_with_triggers;
+  GMutex *discovery_mutex;
 };
 
 void initialize_database();
@@ -0,0 +1,310 @@
+/*
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+        Authors:    David Ducos, Percona (david dot ducos at percona dot com)
+*/
+#include <mysql.h>
+#include <glib.h>
+#include <string.h>
+#include <stdlib.h>
+#include "common.h"
+#include "common_options.h"
+#include "mydumper_database.h"
+#include "mydumper_global.h"
+#include "mydumper_discovery.h"
+
+/*
+  Table metadata discovery.
+
+  Instead of querying information_schema for every table while the jobs are
+  being created, the columns and indexes of all the tables in a database are
+  loaded with two queries before SHOW TABLE STATUS is processed. new_db_table()
+  takes the entry of the table and it only needs to query the server when
+  there is no entry, which happens when the tables are not discovered by
+  dump_database_thread(), like with --tables-list. Entries of the tables that
+  are not dumped are freed with the database.
+*/
+
+void load_collations(MYSQL *conn){
+  MYSQL_RES *res = NULL;
+  MYSQL_ROW row;
+  if (mysql_query(conn, "SELECT COLLATION_NAME, CHARACTER_SET_NAME FROM INFORMATION_SCHEMA.COLLATIONS")){
+    g_warning("Could not load collations: %s", mysql_error(conn));
+    return;
+  }
+  res = mysql_store_result(conn);
+  if (!res)
+    return;
+  g_mutex_lock(character_set_hash_mutex);
+  while ((row = mysql_fetch_row(res))) {
+    if (row[0] && row[1])
+      g_hash_table_insert(character_set_hash, g_strdup(row[0]), g_strdup(row[1]));
+  }
+  g_mutex_unlock(character_set_hash_mutex);
+  mysql_free_result(res);
+}
+
+static
+struct table_discovery *new_table_discovery(){
+  struct table_discovery *td=g_new0(struct table_discovery, 1);
+  td->columns=g_ptr_array_new_with_free_func(g_free);
+  td->insertable_columns=g_ptr_array_new_with_free_func(g_free);
+  return td;
+}
+
+void free_table_discovery(struct table_discovery *td){
+  if (td->columns)
+    g_ptr_array_free(td->columns, TRUE);
+  g_ptr_array_free(td->insertable_columns, TRUE);
+  g_list_free_full(td->primary_key, g_free);
+  g_list_free_full(td->unique_key, g_free);
+  g_free(td->unique_index);
+  g_free(td->any_index_column);
+  g_free(td);
+}
+
+static
+struct table_discovery *get_or_create_table_discovery(GHashTable *ht, const gchar *table){
+  struct table_discovery *td=g_hash_table_lookup(ht, table);
+  if (td == NULL){
+    td=new_table_discovery();
+    g_hash_table_insert(ht, g_strdup(table), td);
+  }
+  return td;
+}
+
+static
+gboolean extra_contains(const gchar *extra, const gchar *needle){
+  if (extra == NULL)
+    return FALSE;
+  gchar *upper=g_ascii_strup(extra, -1);
+  gboolean r=strstr(upper, needle) != NULL;
+  g_free(upper);
+  return r;
+}
+
+static
+gboolean load_columns(MYSQL *conn, struct database *database, GHashTable *ht){
+  MYSQL_RES *res = NULL;
+  MYSQL_ROW row;
+  struct table_discovery *td=NULL;
+  gchar *query = g_strdup_printf(
+      "SELECT TABLE_NAME, COLUMN_NAME, COLUMN_TYPE, EXTRA FROM information_schema.COLUMNS "
+      "WHERE TABLE_SCHEMA='%s' ORDER BY TABLE_NAME, ORDINAL_POSITION", database->escaped);
+  if (mysql_query(conn, query)){
+    g_warning("Could not load columns of %s: %s", database->name, mysql_error(conn));
+    g_free(query);
+    return FALSE;
+  }
+  g_free(query);
+  res = mysql_store_result(conn);
+  if (!res)
+    return FALSE;
+  while ((row = mysql_fetch_row(res))) {
+    td=get_or_create_table_discovery(ht, row[0]);
+    g_ptr_array_add(td->columns, g_strdup(row[1]));
+    if (row[2] && !g_ascii_strcasecmp(row[2], "json"))
+      td->has_json_fields=TRUE;
+    if (!ignore_generated_fields && extra_contains(row[3], "GENERATED") && !extra_contains(row[3], "DEFAULT_GENERATED"))
+      td->has_generated_fields=TRUE;
+    if (!extra_contains(row[3], "VIRTUAL GENERATED") && !extra_contains(row[3], "STORED GENERATED"))
+      g_ptr_array_add(td->insertable_columns, g_strdup(row[1]));
+  }
+  mysql_free_result(res);
+  return TRUE;
+}
+
+static
+gboolean load_indexes(MYSQL *conn, struct database *database, GHashTable *ht){
+  MYSQL_RES *res = NULL;
+  MYSQL_ROW row;
+  struct table_discovery *td=NULL;
+  guint64 cardinality=0;
+  gchar *query = g_strdup_printf(
+      "SELECT TABLE_NAME, INDEX_NAME, NON_UNIQUE, SEQ_IN_INDEX, COLUMN_NAME, CARDINALITY FROM information_schema.STATISTICS "
+      "WHERE TABLE_SCHEMA='%s' ORDER BY TABLE_NAME, NON_UNIQUE, INDEX_NAME, SEQ_IN_INDEX", database->escaped);
+  if (mysql_query(conn, query)){
+    g_warning("Could not load indexes of %s: %s", database->name, mysql_error(conn));
+    g_free(query);
+    return FALSE;
+  }
+  g_free(query);
+  res = mysql_store_result(conn);
+  if (!res)
+    return FALSE;
+  while ((row = mysql_fetch_row(res))) {
+    td=get_or_create_table_discovery(ht, row[0]);
+    if (!strcmp(row[1], "PRIMARY")){
+      td->primary_key=g_list_append(td->primary_key, g_strdup(row[4]));
+    }else if (!strcmp(row[2], "0")){
+      // STATISTICS has no index position, we only know the columns of the
+      // first unique index in definition order when there is just one
+      if (td->unique_index == NULL || strcmp(td->unique_index, row[1])){
+        g_free(td->unique_index);
+        td->unique_index=g_strdup(row[1]);
+        td->unique_indexes++;
+      }
+      td->unique_key=g_list_append(td->unique_key, g_strdup(row[4]));
+    }
+    if (!strcmp(row[3], "1") && row[5]){
+      cardinality = strtoull(row[5], NULL, 10);
+      if (cardinality > td->any_index_cardinality){
+        g_free(td->any_index_column);
+        td->any_index_column=g_strdup(row[4]);
+        td->any_index_cardinality=cardinality;
+        td->any_index_tie=FALSE;
+      }else if (cardinality > 0 && cardinality == td->any_index_cardinality && strcmp(td->any_index_column, row[4]))
+        td->any_index_tie=TRUE;
+    }
+  }
+  mysql_free_result(res);
+  return TRUE;
+}
+
+/* Used by --less-locking to dump the small non-InnoDB tables first */
+static
+gboolean load_data_lengths(MYSQL *conn, struct database *database, GHashTable *ht){
+  MYSQL_RES *res = NULL;
+  MYSQL_ROW row;
+  struct table_discovery *td=NULL;
+  gchar *query = g_strdup_printf(
+      "SELECT TABLE_NAME, DATA_LENGTH FROM information_schema.TABLES "
+      "WHERE TABLE_SCHEMA='%s' AND ENGINE<>'InnoDB'", database->escaped);
+  if (mysql_query(conn, query)){
+    g_warning("Could not load data length of %s: %s", database->name, mysql_error(conn));
+    g_free(query);
+    return FALSE;
+  }
+  g_free(query);
+  res = mysql_store_result(conn);
+  if (!res)
+    return FALSE;
+  while ((row = mysql_fetch_row(res))) {
+    td=g_hash_table_lookup(ht, row[0]);
+    if (td && row[1])
+      td->data_length=strtoull(row[1], NULL, 10);
+  }
+  mysql_free_result(res);
+  return TRUE;
+}
+
+/* Set of tables with triggers, the keys are protected like dbt->table */
+static
+GHashTable *load_tables_with_triggers(MYSQL *conn, struct database *database){
+  MYSQL_RES *res = NULL;
+  MYSQL_ROW row;
+  GHashTable *trigger_tables=NULL;
+  gchar *query = g_strdup_printf(
+      "SELECT DISTINCT EVENT_OBJECT_TABLE FROM information_schema.TRIGGERS "
+      "WHERE TRIGGER_SCHEMA='%s'", database->escaped);
+  if (mysql_query(conn, query)){
+    g_warning("Could not load triggers of %s: %s", database->name, mysql_error(conn));
+    g_free(query);
+    return NULL;
+  }
+  g_free(query);
+  res = mysql_store_result(conn);
+  if (!res)
+    return NULL;
+  trigger_tables=g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+  while ((row = mysql_fetch_row(res)))
+    g_hash_table_insert(trigger_tables, identifier_quote_character_protect(row[0]), GINT_TO_POINTER(1));
+  mysql_free_result(res);
+  return trigger_tables;
+}
+
+void load_database_discovery(MYSQL *conn, struct database *database){
+  GHashTable *ht=g_hash_table_new_full(g_str_hash, g_str_equal, g_free, (GDestroyNotify) &free_table_discovery);
+  GHashTable *tables_with_triggers=NULL;
+  if (!load_columns(conn, database, ht) || !load_indexes(conn, database, ht)){
+    // new_db_table() will query the server for every table
+    g_hash_table_destroy(ht);
+    return;
+  }
+  if (less_locking)
+    load_data_lengths(conn, database, ht);
+  if (dump_triggers && !database->dump_triggers)
+    tables_with_triggers=load_tables_with_triggers(conn, database);
+  trace("Metadata of %u tables discovered on %s", g_hash_table_size(ht), database->name);
+  g_mutex_lock(database->discovery_mutex);
+  if (database->table_discovery)
+    g_hash_table_destroy(database->table_discovery);
+  database->table_discovery=ht;
+  if (database->tables_with_triggers)
+    g_hash_table_destroy(database->tables_with_triggers);
+  database->tables_with_triggers=tables_with_triggers;
+  g_mutex_unlock(database->discovery_mutex);
+}
+
+gboolean get_table_has_triggers_from_discovery(struct database *database, const gchar *table, gboolean *has_triggers){
+  gboolean found=FALSE;
+  g_mutex_lock(database->discovery_mutex);
+  if (database->tables_with_triggers){
+    *has_triggers=g_hash_table_lookup(database->tables_with_triggers, table) != NULL;
+    found=TRUE;
+  }
+  g_mutex_unlock(database->discovery_mutex);
+  return found;
+}
+
+struct table_discovery *take_table_discovery(struct database *database, const gchar *table){
+  struct table_discovery *td=NULL;
+  gchar *key=NULL;
+  g_mutex_lock(database->discovery_mutex);
+  if (database->table_discovery &&
+      g_hash_table_lookup_extended(database->table_discovery, table, (gpointer *)&key, (gpointer *)&td)){
+    g_hash_table_steal(database->table_discovery, table);
+    g_free(key);
+  }
+  g_mutex_unlock(database->discovery_mutex);
+  return td;
+}
+
+/*
+  Same choice than get_primary_key(), without SHOW INDEX. That choice depends
+  on the order of the indexes in the table definition, which STATISTICS does
+  not give: when it matters, several unique indexes or a tie on the
+  cardinality, it returns FALSE and the caller has to use get_primary_key().
+*/
+gboolean set_primary_key_from_discovery(struct db_table *dbt, struct table_discovery *td, struct configuration *conf){
+  dbt->primary_key=NULL;
+  if (td->primary_key){
+    dbt->primary_key=td->primary_key;
+    td->primary_key=NULL;
+  }else if (td->unique_indexes > 1){
+    return FALSE;
+  }else if (td->unique_key){
+    dbt->primary_key=td->unique_key;
+    td->unique_key=NULL;
+  }else if (conf->use_any_index && td->any_index_column){
+    if (td->any_index_tie)
+      return FALSE;
+    dbt->primary_key=g_list_append(NULL, td->any_index_column);
+    td->any_index_column=NULL;
+  }
+  return TRUE;
+}
+
+GString *get_insertable_fields_from_discovery(struct table_discovery *td){
+  GString *field_list = g_string_new("");
+  guint i;
+  for (i=0; i<td->insertable_columns->len; i++){
+    if (i>0)
+      g_string_append(field_list, ",");
+    char *field_name= identifier_quote_character_protect(g_ptr_array_index(td->insertable_columns, i));
+    g_string_append_printf(field_list, "%s%s%s", identifier_quote_character_str, field_name, identifier_quote_character_str);
+    g_free(field_name);
+  }
+  return field_list;
+}
@@ -0,0 +1,48 @@
+/*
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+        Authors:    David Ducos, Percona (david dot ducos at percona dot com)
+*/
+#ifndef _src_mydumper_discovery_h
+#define _src_mydumper_discovery_h
+#include <mysql.h>
+#include <glib.h>
+
+struct table_discovery {
+  GPtrArray *columns;
+  GPtrArray *insertable_columns;
+  gboolean has_json_fields;
+  gboolean has_generated_fields;
+  GList *primary_key;
+  gchar *unique_index;
+  guint unique_indexes;
+  GList *unique_key;
+  gchar *any_index_column;
+  guint64 any_index_cardinality;
+  gboolean any_index_tie;
+  guint64 data_length;
+};
+
+struct database;
+struct db_table;
+struct configuration;
+
+void load_collations(MYSQL *conn);
+void load_database_discovery(MYSQL *conn, struct database *database);
+gboolean get_table_has_triggers_from_discovery(struct database *database, const gchar *table, gboolean *has_triggers);
+struct table_discovery *take_table_discovery(struct database *database, const gchar *table);
+void free_table_discovery(struct table_discovery *td);
+gboolean set_primary_key_from_discovery(struct db_table *dbt, struct table_discovery *td, struct configuration *conf);
+GString *get_insertable_fields_from_discovery(struct table_discovery *td);
+#endif
@@ -36,6 +36,11 @@
 //#include <sys/wait.h>
 #include "mydumper_start_dump.h"
 #include "mydumper_stream.h"
+#include "trace_file.h"
+#include "mydumper_database.h"
+#include "mydumper_write.h"
+#include "mydumper_file_handler.h"
+#include "tracepoints.h"
 #include <sys/wait.h>
 #include <sys/ioctl.h>
 #include <unistd.h>
@@ -52,15 +57,22 @@ GThread * cft = NULL;
 guint open_pipe=0;
 
 int (*m_close)(guint thread_id, int file, gchar *filename, guint64 size, struct db_table * dbt) = NULL;
+gboolean (*m_write)(int file, float *filesize, GString *data) = &real_write_data;
+gboolean null_output = FALSE;
+gboolean null_output_checksum = FALSE;
 
 // FILE open/close
 
 int m_open_file(char **filename, const char *type ){
   (void) type;
-  return open(*filename, O_CREAT|O_WRONLY|O_TRUNC, 0660 );
+  int fd=open(*filename, O_CREAT|O_WRONLY|O_TRUNC, 0660 );
+  TRACEPOINT2(mydumper, file__open, *filename, fd);
+  return fd;
 }
 
 int m_close_file(guint thread_id, int file, gchar *filename, guint64 size, struct db_table * dbt){
+  trace_event_begin("close", "%s", filename);
+  TRACEPOINT3(mydumper, file__close, filename, file, size);
   int r=close(file);
   if (size > 0){
     if (stream) stream_queue_push(dbt, g_strdup(filename));
@@ -71,9 +83,165 @@ int m_close_file(guint thread_id, int file, gchar *filename, guint64 size, struc
       g_debug("Thread %d: File removed: %s", thread_id, filename);
     }
   }
+  trace_event_end();
   return r;
 }
 
+// NULL open/write/close
+
+/*
+  --null-output keeps the whole fetch and serialize path but the bytes are
+  counted instead of written, so a dump is only limited by the server and
+  by mydumper itself. The files are /dev/null descriptors, the writes are
+  accounted by descriptor and the closes by table, only for the data files,
+  the schema and metadata files only count in the total. With
+  --null-output-checksum the bytes are also hashed with FNV-1a, this reads
+  every byte that was serialized and gives a value to compare between runs.
+*/
+
+struct null_file {
+  gint64 opened_at;
+  guint64 bytes;
+  guint64 checksum;
+  gboolean data;
+};
+
+struct null_table {
+  gint64 first_open;
+  gint64 last_close;
+  gint64 busy;
+  guint64 bytes;
+  guint64 checksum;
+  guint files;
+};
+
+static GMutex *null_mutex=NULL;
+static GHashTable *null_files=NULL;
+static GHashTable *null_tables=NULL;
+static struct null_table null_total;
+
+int m_open_null(char **filename, const char *type){
+  (void) filename;
+  (void) type;
+  int fd=open("/dev/null", O_WRONLY);
+  TRACEPOINT2(mydumper, file__open, *filename, fd);
+  if (fd < 0)
+    return fd;
+  struct null_file *nf=g_new0(struct null_file, 1);
+  nf->opened_at=g_get_monotonic_time();
+  nf->checksum=G_GUINT64_CONSTANT(14695981039346656037);
+  g_mutex_lock(null_mutex);
+  g_hash_table_insert(null_files, GINT_TO_POINTER(fd), nf);
+  g_mutex_unlock(null_mutex);
+  return fd;
+}
+
+/* The chunk files are accounted to their table when they are closed */
+void null_output_data_file(int file){
+  struct null_file *nf=NULL;
+  if (!null_output)
+    return;
+  g_mutex_lock(null_mutex);
+  nf=g_hash_table_lookup(null_files, GINT_TO_POINTER(file));
+  if (nf)
+    nf->data=TRUE;
+  g_mutex_unlock(null_mutex);
+}
+
+gboolean m_write_null(int file, float *filesize, GString *data){
+  g_mutex_lock(null_mutex);
+  struct null_file *nf=g_hash_table_lookup(null_files, GINT_TO_POINTER(file));
+  g_mutex_unlock(null_mutex);
+  if (nf == NULL){
+    g_critical("Couldn't write data to a file: descriptor %d is not open", file);
+    errors++;
+    return FALSE;
+  }
+  if (null_output_checksum){
+    guint64 checksum=nf->checksum;
+    gsize i;
+    for (i=0; i<data->len; i++){
+      checksum^=(guchar)data->str[i];
+      checksum*=G_GUINT64_CONSTANT(1099511628211);
+    }
+    nf->checksum=checksum;
+  }
+  nf->bytes+=data->len;
+  *filesize+=data->len;
+  return TRUE;
+}
+
+static
+void add_null_file(struct null_table *nt, struct null_file *nf, gint64 now){
+  if (nt->files == 0 || nf->opened_at < nt->first_open)
+    nt->first_open=nf->opened_at;
+  if (now > nt->last_close)
+    nt->last_close=now;
+  nt->busy+=now - nf->opened_at;
+  nt->bytes+=nf->bytes;
+  // Files are closed in any order, the sum keeps the checksum independent of it
+  nt->checksum+=nf->checksum;
+  nt->files++;
+}
+
+int m_close_null(guint thread_id, int file, gchar *filename, guint64 size, struct db_table * dbt){
+  (void) thread_id;
+  (void) filename;
+  (void) size;
+  TRACEPOINT3(mydumper, file__close, filename, file, size);
+  gint64 now=g_get_monotonic_time();
+  gchar *key=NULL;
+  struct null_table *nt=NULL;
+  g_mutex_lock(null_mutex);
+  struct null_file *nf=g_hash_table_lookup(null_files, GINT_TO_POINTER(file));
+  if (nf){
+    g_hash_table_remove(null_files, GINT_TO_POINTER(file));
+    add_null_file(&null_total, nf, now);
+    if (dbt && nf->data){
+      key=g_strdup_printf("%s.%s", dbt->database->name, dbt->table);
+      nt=g_hash_table_lookup(null_tables, key);
+      if (nt == NULL){
+        nt=g_new0(struct null_table, 1);
+        g_hash_table_insert(null_tables, key, nt);
+      }else
+        g_free(key);
+      add_null_file(nt, nf, now);
+    }
+    g_free(nf);
+  }
+  g_mutex_unlock(null_mutex);
+  return close(file);
+}
+
+static
+void print_null_table(const gchar *name, struct null_table *nt){
+  gdouble seconds=(gdouble)(nt->last_close - nt->first_open) / G_USEC_PER_SEC;
+  gdouble busy=(gdouble)nt->busy / G_USEC_PER_SEC;
+  GString *line=g_string_new("");
+  g_string_printf(line, "%s: %.1f MB in %u files, %.1f MB/s over %.2f seconds, %.1f MB/s per thread",
+                  name, (gdouble)nt->bytes / 1000000, nt->files,
+                  seconds > 0 ? nt->bytes / seconds / 1000000 : 0, seconds,
+                  busy > 0 ? nt->bytes / busy / 1000000 : 0);
+  if (null_output_checksum)
+    g_string_append_printf(line, ", checksum %016"G_GINT64_MODIFIER"x", nt->checksum);
+  g_message("%s", line->str);
+  g_string_free(line, TRUE);
+}
+
+void print_null_output_report(){
+  GList *keys, *iter;
+  if (!null_output || null_tables == NULL)
+    return;
+  g_message("Null output report, the data was serialized and discarded:");
+  g_mutex_lock(null_mutex);
+  keys=g_list_sort(g_hash_table_get_keys(null_tables), (GCompareFunc)g_strcmp0);
+  for (iter=keys; iter != NULL; iter=iter->next)
+    print_null_table(iter->data, g_hash_table_lookup(null_tables, iter->data));
+  g_list_free(keys);
+  print_null_table("All files", &null_total);
+  g_mutex_unlock(null_mutex);
+}
+
 // 
 
 void close_file_queue_push(struct fifo *f){
@@ -170,6 +338,7 @@ int m_open_pipe(gchar **filename, const char *type){
   g_mutex_lock(fifo_table_mutex);
   g_hash_table_insert(fifo_hash,f->filename,f);
   g_mutex_unlock(fifo_table_mutex);
+  TRACEPOINT2(mydumper, file__open, *filename, f->pipe[1]);
   return f->pipe[1];
 }
 
@@ -181,9 +350,18 @@ int m_close_pipe(guint thread_id, int file, gchar *filename, guint64 size, struc
   struct fifo *f=g_hash_table_lookup(fifo_hash,filename);
   g_mutex_unlock(fifo_table_mutex);
   if (f){
+    TRACEPOINT3(mydumper, file__close, filename, file, size);
     f->size=size;
     f->dbt=dbt;
+    // Waits until the compressor has written all its output
+    gint64 start_time=metrics_enabled?g_get_monotonic_time():0;
+    trace_event_begin("compress", "%s", filename);
+    enum thread_state previous_state=metrics_thread_state(THREAD_STATE_COMPRESS);
     close_file_queue_push(f);
+    metrics_thread_state(previous_state);
+    trace_event_end();
+    if (metrics_enabled)
+      metrics_observe(METRICS_COMPRESSION_WAIT, g_get_monotonic_time() - start_time);
     return 0;
   }else{
     g_warning("pipe %s not closed", filename);
@@ -208,10 +386,12 @@ void final_step_close_file(guint thread_id, gchar *filename, struct fifo *f, flo
 void * close_file_thread(void *data){
   (void)data;
   struct fifo *f=NULL;
+  set_thread_name("CFT");
   for (;;){
     f=g_async_queue_pop(close_file_queue);
     if (f->gpid == -10)
       break;
+    trace_event_begin("close", "%s", f->stdout_filename);
     g_mutex_lock(pipe_creation);
     close(f->pipe[1]);
     close(f->pipe[0]);
@@ -227,12 +407,23 @@ void * close_file_thread(void *data){
     release_pid();
     final_step_close_file(0, f->filename, f, f->size, f->dbt);
     g_atomic_int_dec_and_test(&open_pipe);
+    trace_event_end();
  }
   return NULL;
 }
 
 void initialize_file_handler(gboolean is_pipe){
-  if (is_pipe){
+  m_write = &real_write_data;
+  if (null_output){
+    m_open  = &m_open_null;
+    m_write = &m_write_null;
+    m_close = &m_close_null;
+    if (null_mutex == NULL){
+      null_mutex=g_mutex_new();
+      null_files=g_hash_table_new(g_direct_hash, g_direct_equal);
+      null_tables=g_hash_table_new_full(g_str_hash, g_str_equal, &g_free, &g_free);
+    }
+  }else if (is_pipe){
     m_open  = &m_open_pipe;
     m_close = &m_close_pipe;
   }else{
@@ -23,6 +23,8 @@
 
 void initialize_file_handler(gboolean is_pipe);
 int m_open_pipe(char **filename, const char *type);
+void null_output_data_file(int file);
+void print_null_output_report();
 void release_pid();
 void child_process_ended(int child_pid);
 void wait_close_files();
@@ -6,6 +6,9 @@
 extern gchar *defaults_file;
 extern char *defaults_extra_file;
 extern GHashTable *all_dbts;
+extern GMutex *all_dbts_mutex;
+extern GHashTable *character_set_hash;
+extern GMutex *character_set_hash_mutex;
 extern GOptionEntry common_filter_entries[];
 extern GOptionEntry common_connection_entries[];
 extern GOptionEntry common_entries[];
@@ -24,6 +27,8 @@ extern gchar *fields_terminated_by_ld;
 extern gboolean csv;
 extern gboolean clickhouse;
 extern gboolean include_header;
+extern gboolean select_into_outfile;
+extern gchar *transportable_tables_list;
 extern gboolean replace;
 extern guint chunk_filesize;
 extern gchar *ignore_engines;
@@ -52,6 +57,7 @@ extern gboolean help;
 extern GKeyFile * key_file;
 extern char **tables;
 extern int (*m_open)(char **filename, const char *);
+extern gboolean (*m_write)(int file, float *filesize, GString *data);
 extern char * (*identifier_quote_character_protect)(char *r);
 struct db_table;
 extern int (*m_close)(guint thread_id, int file, gchar *filename, guint64 size, struct db_table * dbt);
@@ -70,6 +76,9 @@ extern gboolean no_delete;
 extern gboolean no_locks;
 extern gboolean no_schemas;
 extern gboolean no_stream;
+extern gboolean null_output;
+extern gboolean null_output_checksum;
+extern gboolean plan;
 extern gboolean routine_checksums;
 extern gboolean schema_checksums;
 extern gboolean shutdown_triggered;
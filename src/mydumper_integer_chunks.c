@@ -604,6 +604,8 @@ if (cs->integer_step.is_unsigned){
           cs->integer_step.step=MAX_CHUNK_STEP_SIZE;        
 //    g_message("Increasing time: %ld | %ld", diff, tj->chunk_step->integer_step.step);
       }
+      // Saved by --history-file as the starting step of the next run
+      tj->dbt->last_chunk_step=cs->integer_step.step;
     }
   }
 
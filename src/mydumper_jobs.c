@@ -38,7 +38,9 @@
 #include "mydumper_write.h"
 #include "mydumper_chunks.h"
 #include "mydumper_global.h"
+#include "mydumper_file_handler.h"
 #include "mydumper_arguments.h"
+#include "mydumper_discovery.h"
 #include <sys/wait.h>
 #include <fcntl.h>
 
@@ -286,14 +288,13 @@ void write_table_definition_into_file(MYSQL *conn, struct db_table *dbt,
   return;
 }
 
-void write_triggers_definition_into_file(MYSQL *conn, MYSQL_RES *result, struct database *database, gchar *message, int outfile) {
+void write_triggers_definition_into_file(MYSQL *conn, MYSQL_RES *result, struct database *database, gchar *message, int outfile, GString *statement) {
   MYSQL_RES *result2 = NULL;
   MYSQL_ROW row2;
   MYSQL_ROW row;
   gchar *query = NULL;
   gchar **splited_st = NULL;
   const char q= identifier_quote_character;
-  GString *statement = g_string_sized_new(statement_size);
   initialize_sql_statement(statement);
 
   if (!write_data(outfile, statement)) {
@@ -312,6 +313,7 @@ void write_triggers_definition_into_file(MYSQL *conn, MYSQL_RES *result, struct
     g_string_set_size(statement, 0);
     query = g_strdup_printf("SHOW CREATE TRIGGER %c%s%c.%c%s%c", q, database->name, q, q, row[0], q);
     mysql_query(conn, query);
+    g_free(query);
     result2 = mysql_store_result(conn);
     row2 = mysql_fetch_row(result2);
     if ( skip_definer && g_str_has_prefix(row2[2],"CREATE")){
@@ -323,6 +325,7 @@ void write_triggers_definition_into_file(MYSQL *conn, MYSQL_RES *result, struct
     g_strfreev(splited_st);
     g_string_append(statement, ";\n");
     restore_charset(statement);
+    mysql_free_result(result2);
     if (!write_data(outfile, statement)) {
       g_critical("Could not write triggers data for %s", message);
       errors++;
@@ -333,7 +336,7 @@ void write_triggers_definition_into_file(MYSQL *conn, MYSQL_RES *result, struct
   return;
 }
 
-void write_triggers_definition_into_file_from_dbt(MYSQL *conn, struct db_table *dbt, char *filename, gboolean checksum_filename) {
+void write_triggers_definition_into_file_from_dbt(MYSQL *conn, struct db_table *dbt, char *filename, gboolean checksum_filename, GString *statement) {
   int outfile;
   char *query = NULL;
   MYSQL_RES *result = NULL;
@@ -366,7 +369,7 @@ void write_triggers_definition_into_file_from_dbt(MYSQL *conn, struct db_table *
   g_free(query);
 
   gchar *message=g_strdup_printf("%s.%s",dbt->database->name, dbt->table);
-  write_triggers_definition_into_file(conn, result, dbt->database, message, outfile);
+  write_triggers_definition_into_file(conn, result, dbt->database, message, outfile, statement);
   g_free(message);
 
   m_close(0, outfile, filename, 1, dbt);
@@ -377,7 +380,7 @@ void write_triggers_definition_into_file_from_dbt(MYSQL *conn, struct db_table *
   return;
 }
 
-void write_triggers_definition_into_file_from_database(MYSQL *conn, struct database *database, char *filename, gboolean checksum_filename) {
+void write_triggers_definition_into_file_from_database(MYSQL *conn, struct database *database, char *filename, gboolean checksum_filename, GString *statement) {
   int outfile;
   char *query = NULL;
   MYSQL_RES *result = NULL;
@@ -408,7 +411,7 @@ void write_triggers_definition_into_file_from_database(MYSQL *conn, struct datab
   }
   g_free(query);
 
-  write_triggers_definition_into_file(conn, result, database, database->name, outfile);
+  write_triggers_definition_into_file(conn, result, database, database->name, outfile, statement);
 
   m_close(0, outfile, filename, 1, NULL);
   if (result)
@@ -418,13 +421,12 @@ void write_triggers_definition_into_file_from_database(MYSQL *conn, struct datab
   return;
 }
 
-void write_view_definition_into_file(MYSQL *conn, struct db_table *dbt, char *filename, char *filename2, gboolean checksum_filename) {
+void write_view_definition_into_file(MYSQL *conn, struct db_table *dbt, char *filename, char *filename2, gboolean checksum_filename, GString *statement) {
   int outfile;
   char *query = NULL;
   MYSQL_RES *result = NULL;
   MYSQL_ROW row;
   const char q= identifier_quote_character;
-  GString *statement = g_string_sized_new(statement_size);
   initialize_sql_statement(statement);
 
   if (mysql_select_db(conn, dbt->database->name)) {
@@ -452,27 +454,39 @@ void write_view_definition_into_file(MYSQL *conn, struct db_table *dbt, char *fi
 
   // we create tables as workaround
   // for view dependencies
-  query = g_strdup_printf("SHOW FIELDS FROM %c%s%c.%c%s%c", q, dbt->database->name, q, q, dbt->table, q);
-  if (mysql_query(conn, query) || !(result = mysql_use_result(conn))) {
-    if (success_on_1146 && mysql_errno(conn) == 1146) {
-      g_warning("Error dumping schemas (%s.%s): %s", dbt->database->name, dbt->table,
-                mysql_error(conn));
-    } else {
-      g_critical("Error dumping schemas (%s.%s): %s", dbt->database->name, dbt->table,
-                 mysql_error(conn));
-      errors++;
-    }
-    g_free(query);
-    return;
-  }
-  g_free(query);
   g_string_set_size(statement, 0);
   g_string_append_printf(statement, "CREATE TABLE IF NOT EXISTS %c%s%c(\n", q, dbt->table, q);
-  row = mysql_fetch_row(result);
-  g_string_append_printf(statement, "%c%s%c int", q, row[0], q);
-  while ((row = mysql_fetch_row(result))) {
-    g_string_append(statement, ",\n");
+  if (dbt->view_columns != NULL && dbt->view_columns->len > 0){
+    // Already loaded by load_database_discovery()
+    guint i;
+    for (i=0; i<dbt->view_columns->len; i++){
+      if (i > 0)
+        g_string_append(statement, ",\n");
+      g_string_append_printf(statement, "%c%s%c int", q, (gchar *)g_ptr_array_index(dbt->view_columns, i), q);
+    }
+  }else{
+    query = g_strdup_printf("SHOW FIELDS FROM %c%s%c.%c%s%c", q, dbt->database->name, q, q, dbt->table, q);
+    if (mysql_query(conn, query) || !(result = mysql_use_result(conn))) {
+      if (success_on_1146 && mysql_errno(conn) == 1146) {
+        g_warning("Error dumping schemas (%s.%s): %s", dbt->database->name, dbt->table,
+                  mysql_error(conn));
+      } else {
+        g_critical("Error dumping schemas (%s.%s): %s", dbt->database->name, dbt->table,
+                   mysql_error(conn));
+        errors++;
+      }
+      g_free(query);
+      return;
+    }
+    g_free(query);
+    row = mysql_fetch_row(result);
     g_string_append_printf(statement, "%c%s%c int", q, row[0], q);
+    while ((row = mysql_fetch_row(result))) {
+      g_string_append(statement, ",\n");
+      g_string_append_printf(statement, "%c%s%c int", q, row[0], q);
+    }
+    mysql_free_result(result);
+    result = NULL;
   }
   g_string_append(statement, "\n) ENGINE=MEMORY");
   if (get_product() == SERVER_TYPE_PERCONA || get_product() == SERVER_TYPE_MYSQL)
@@ -481,9 +495,6 @@ void write_view_definition_into_file(MYSQL *conn, struct db_table *dbt, char *fi
 //    g_string_append(statement," ENCRYPTED=NO");
   g_string_append(statement,";\n");
 
-  if (result)
-    mysql_free_result(result);
-
   if (!write_data(outfile, statement)) {
     g_critical("Could not write view schema for %s.%s", dbt->database->name, dbt->table);
     errors++;
@@ -544,7 +555,6 @@ void write_view_definition_into_file(MYSQL *conn, struct db_table *dbt, char *fi
   g_free(query);
 
   m_close(0, outfile2, filename2, 1, dbt);
-  g_string_free(statement, TRUE);
   if (result)
     mysql_free_result(result);
 
@@ -653,7 +663,7 @@ void write_sequence_definition_into_file(MYSQL *conn, struct db_table *dbt, char
 
 // Routines, Functions and Events
 // TODO: We need to split it in 3 functions 
-void write_routines_definition_into_file(MYSQL *conn, struct database *database, char *filename, gboolean checksum_filename) {
+void write_routines_definition_into_file(MYSQL *conn, struct database *database, char *filename, gboolean checksum_filename, GString *statement) {
   int outfile;
   char *query = NULL;
   MYSQL_RES *result = NULL;
@@ -672,7 +682,6 @@ void write_routines_definition_into_file(MYSQL *conn, struct database *database,
   }
 
   const char q= identifier_quote_character;
-  GString *statement = g_string_sized_new(statement_size);
   initialize_sql_statement(statement);
 
 
@@ -880,7 +889,8 @@ void do_JOB_SCHEMA_POST(struct thread_data *td, struct job *job){
   struct database_job * sp = (struct database_job *)job->job_data;
   g_message("Thread %d: dumping SP and VIEWs for `%s`", td->thread_id,
             sp->database->name);
-  write_routines_definition_into_file(td->thrconn, sp->database, sp->filename, sp->checksum_filename);
+  write_routines_definition_into_file(td->thrconn, sp->database, sp->filename, sp->checksum_filename, td->thread_data_buffers.statement);
+  g_string_set_size(td->thread_data_buffers.statement, 0);
   free_database_job(sp);
   g_free(job);
 }
@@ -890,7 +900,8 @@ void do_JOB_SCHEMA_TRIGGERS(struct thread_data *td, struct job *job){
   struct database_job * sj = (struct database_job *)job->job_data;
   g_message("Thread %d: dumping triggers for `%s`", td->thread_id,
             sj->database->name);
-  write_triggers_definition_into_file_from_database(td->thrconn, sj->database, sj->filename, sj->checksum_filename);
+  write_triggers_definition_into_file_from_database(td->thrconn, sj->database, sj->filename, sj->checksum_filename, td->thread_data_buffers.statement);
+  g_string_set_size(td->thread_data_buffers.statement, 0);
   free_database_job(sj);
   g_free(job);
 }
@@ -900,7 +911,8 @@ void do_JOB_VIEW(struct thread_data *td, struct job *job){
   g_message("Thread %d: dumping view for `%s`.`%s`", td->thread_id,
             vj->dbt->database->name, vj->dbt->table);
   write_view_definition_into_file(td->thrconn, vj->dbt, vj->tmp_table_filename,
-                 vj->view_filename, vj->checksum_filename);
+                 vj->view_filename, vj->checksum_filename, td->thread_data_buffers.statement);
+  g_string_set_size(td->thread_data_buffers.statement, 0);
 //  free_view_job(vj);
   g_free(job);
 }
@@ -932,7 +944,8 @@ void do_JOB_TRIGGERS(struct thread_data *td, struct job *job){
   struct schema_job * sj = (struct schema_job *)job->job_data;
   g_message("Thread %d: dumping triggers for `%s`.`%s`", td->thread_id,
             sj->dbt->database->name, sj->dbt->table);
-  write_triggers_definition_into_file_from_dbt(td->thrconn, sj->dbt, sj->filename, sj->checksum_filename);
+  write_triggers_definition_into_file_from_dbt(td->thrconn, sj->dbt, sj->filename, sj->checksum_filename, td->thread_data_buffers.statement);
+  g_string_set_size(td->thread_data_buffers.statement, 0);
   free_schema_job(sj);
   g_free(job);
 }
@@ -1004,9 +1017,28 @@ void create_job_to_dump_post(struct database *database, struct configuration *co
   create_database_related_job(database, conf, JOB_SCHEMA_POST, "schema-post");
 }
 
+static
+void push_job_to_dump_triggers(struct db_table *dbt, struct configuration *conf) {
+  struct job *t = g_new0(struct job, 1);
+  struct schema_job *st = g_new0(struct schema_job, 1);
+  t->job_data = (void *)st;
+  t->type = JOB_TRIGGERS;
+  st->dbt = dbt;
+  st->filename = build_schema_table_filename(dbt->database->filename, dbt->table_filename, "schema-triggers");
+  st->checksum_filename=routine_checksums;
+  g_async_queue_push(conf->post_data_queue, t);
+}
+
 void create_job_to_dump_triggers(MYSQL *conn, struct db_table *dbt, struct configuration *conf) {
   char *query = NULL;
   MYSQL_RES *result = NULL;
+  gboolean has_triggers = FALSE;
+
+  if (get_table_has_triggers_from_discovery(dbt->database, dbt->table, &has_triggers)){
+    if (has_triggers)
+      push_job_to_dump_triggers(dbt, conf);
+    return;
+  }
 
   const char q= identifier_quote_character;
   query =
@@ -1017,14 +1049,7 @@ void create_job_to_dump_triggers(MYSQL *conn, struct db_table *dbt, struct confi
     errors++;
   } else {
     if (mysql_num_rows(result)) {
-      struct job *t = g_new0(struct job, 1);
-      struct schema_job *st = g_new0(struct schema_job, 1);
-      t->job_data = (void *)st;
-      t->type = JOB_TRIGGERS;
-      st->dbt = dbt;
-      st->filename = build_schema_table_filename(dbt->database->filename, dbt->table_filename, "schema-triggers");
-      st->checksum_filename=routine_checksums;
-      g_async_queue_push(conf->post_data_queue, t);
+      push_job_to_dump_triggers(dbt, conf);
     }
   }
   g_free(query);
@@ -1107,10 +1132,12 @@ gboolean update_files_on_table_job(struct table_job *tj)
 
     tj->rows->filename = build_rows_filename(tj->dbt->database->filename, tj->dbt->table_filename, tj->nchunk, tj->sub_part);
     tj->rows->file = m_open(&(tj->rows->filename),"w");
+    null_output_data_file(tj->rows->file);
 
     if (tj->sql){
       tj->sql->filename =build_sql_filename(tj->dbt->database->filename, tj->dbt->table_filename, tj->nchunk, tj->sub_part);
       tj->sql->file = m_open(&(tj->sql->filename),"w");
+      null_output_data_file(tj->sql->file);
       return TRUE;
     }
   }
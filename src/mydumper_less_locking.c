@@ -0,0 +1,172 @@
+/*
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+        Authors:    David Ducos, Percona (david dot ducos at percona dot com)
+*/
+#include <mysql.h>
+#include <glib.h>
+#include "common.h"
+#include "connection.h"
+#include "logging.h"
+#include "mydumper_start_dump.h"
+#include "mydumper_database.h"
+#include "mydumper_global.h"
+#include "mydumper_working_thread.h"
+#include "mydumper_less_locking.h"
+
+/*
+  Non-InnoDB table locks for --less-locking.
+
+  A session under LOCK TABLES is only able to read the tables that it locked,
+  so the worker threads are not able to release the tables one by one while
+  they are dumping from all of them. Instead, the tables are split in groups
+  and every group is locked by its own connection while the global lock is
+  still held. Workers read the tables without locking them and, when all the
+  jobs of the tables of a group finished, the group connection sends UNLOCK
+  TABLES. The tables are sorted by size, small tables share a group and they
+  are dumped first, big tables get their own group.
+
+  The locks are READ and not READ LOCAL, as the concurrent inserts that
+  READ LOCAL allows would be visible to the worker connections.
+*/
+
+static GMutex *lock_groups_mutex = NULL;
+static GList *lock_groups = NULL;
+static guint threads_dumping_non_innodb = 0;
+
+static
+gint compare_data_length(gconstpointer a, gconstpointer b){
+  const struct db_table *dbt_a=a, *dbt_b=b;
+  return dbt_a->data_length < dbt_b->data_length ? -1 : dbt_a->data_length > dbt_b->data_length;
+}
+
+static
+void lock_group(struct table_lock_group *group){
+  GString *statement=g_string_sized_new(30);
+  GList *iter;
+  struct locked_table *lt;
+  for (iter=group->tables; iter != NULL; iter=iter->next){
+    lt=iter->data;
+    g_string_append_printf(statement, "%s%s%s%s.%s%s%s READ",
+                           iter == group->tables ? "LOCK TABLES " : ", ",
+                           identifier_quote_character_str, lt->dbt->database->name, identifier_quote_character_str,
+                           identifier_quote_character_str, lt->dbt->table, identifier_quote_character_str);
+  }
+  group->conn=mysql_init(NULL);
+  m_connect(group->conn);
+  if (mysql_query(group->conn, statement->str))
+    m_error("Error locking non-innodb tables %s", mysql_error(group->conn));
+  group->locked_at=g_get_monotonic_time();
+  g_string_free(statement, TRUE);
+}
+
+static
+void unlock_group(struct table_lock_group *group){
+  GList *iter;
+  struct locked_table *lt;
+  gint64 now;
+  if (mysql_query(group->conn, UNLOCK_TABLES))
+    m_error("Error unlocking non-innodb tables %s", mysql_error(group->conn));
+  now=g_get_monotonic_time();
+  for (iter=group->tables; iter != NULL; iter=iter->next){
+    lt=iter->data;
+    g_message("Non-InnoDB table %s.%s locked for %.3f seconds, data written after %.3f seconds",
+              lt->dbt->database->name, lt->dbt->table,
+              (gdouble)(now - group->locked_at) / G_USEC_PER_SEC,
+              (gdouble)((lt->dumped_at ? lt->dumped_at : now) - group->locked_at) / G_USEC_PER_SEC);
+    lt->dbt->locked_table=NULL;
+    g_free(lt);
+  }
+  g_list_free(group->tables);
+  group->tables=NULL;
+  mysql_close(group->conn);
+  group->conn=NULL;
+}
+
+/* Called by the main thread while the global lock is held */
+void lock_non_innodb_tables(){
+  GList *iter;
+  struct db_table *dbt;
+  struct table_lock_group *group=NULL;
+  struct locked_table *lt;
+  guint64 total=0, accumulated=0, target=0;
+  guint groups=0;
+
+  lock_groups_mutex=g_mutex_new();
+  threads_dumping_non_innodb=num_threads;
+
+  g_mutex_lock(non_innodb_table->mutex);
+  non_innodb_table->list=g_list_sort(non_innodb_table->list, &compare_data_length);
+  for (iter=non_innodb_table->list; iter != NULL; iter=iter->next)
+    total+=((struct db_table *)iter->data)->data_length + 1;
+  target=total / num_threads;
+  for (iter=non_innodb_table->list; iter != NULL; iter=iter->next){
+    dbt=iter->data;
+    if (group == NULL){
+      group=g_new0(struct table_lock_group, 1);
+      lock_groups=g_list_append(lock_groups, group);
+      groups++;
+    }
+    lt=g_new0(struct locked_table, 1);
+    lt->dbt=dbt;
+    lt->group=group;
+    dbt->locked_table=lt;
+    group->tables=g_list_append(group->tables, lt);
+    group->pending++;
+    // Without data length every table counts as 1 byte
+    accumulated+=dbt->data_length + 1;
+    // The last group takes the remaining tables
+    if (groups < num_threads && accumulated >= target * groups)
+      group=NULL;
+  }
+  g_mutex_unlock(non_innodb_table->mutex);
+
+  for (iter=lock_groups; iter != NULL; iter=iter->next)
+    lock_group(iter->data);
+  g_message("Non-InnoDB tables locked in %u groups", groups);
+}
+
+/* Called when the last job of the table finished */
+void non_innodb_table_dumped(struct db_table *dbt){
+  struct locked_table *lt;
+  g_mutex_lock(lock_groups_mutex);
+  lt=dbt->locked_table;
+  if (lt != NULL && lt->dumped_at == 0){
+    lt->dumped_at=g_get_monotonic_time();
+    lt->group->pending--;
+    if (lt->group->pending == 0)
+      unlock_group(lt->group);
+  }
+  g_mutex_unlock(lock_groups_mutex);
+}
+
+/* Called by every worker thread when the non-InnoDB queues are empty, the
+   last one releases the groups of the tables that were not dumped */
+void release_non_innodb_table_locks(){
+  GList *iter;
+  struct table_lock_group *group;
+  g_mutex_lock(lock_groups_mutex);
+  threads_dumping_non_innodb--;
+  if (threads_dumping_non_innodb == 0){
+    for (iter=lock_groups; iter != NULL; iter=iter->next){
+      group=iter->data;
+      if (group->conn != NULL)
+        unlock_group(group);
+      g_free(group);
+    }
+    g_list_free(lock_groups);
+    lock_groups=NULL;
+  }
+  g_mutex_unlock(lock_groups_mutex);
+}
@@ -0,0 +1,40 @@
+/*
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+        Authors:    David Ducos, Percona (david dot ducos at percona dot com)
+*/
+#ifndef _src_mydumper_less_locking_h
+#define _src_mydumper_less_locking_h
+#include <mysql.h>
+#include <glib.h>
+
+struct db_table;
+
+struct table_lock_group {
+  MYSQL *conn;
+  GList *tables;
+  guint pending;
+  gint64 locked_at;
+};
+
+struct locked_table {
+  struct db_table *dbt;
+  struct table_lock_group *group;
+  gint64 dumped_at;
+};
+
+void lock_non_innodb_tables();
+void non_innodb_table_dumped(struct db_table *dbt);
+void release_non_innodb_table_locks();
+#endif
@@ -0,0 +1,217 @@
+/*
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+        Authors:    David Ducos, Percona (david dot ducos at percona dot com)
+*/
+#include <mysql.h>
+#include <glib.h>
+#include <stdlib.h>
+#include "common.h"
+#include "mydumper_start_dump.h"
+#include "mydumper_database.h"
+#include "mydumper_global.h"
+#include "mydumper_chunks.h"
+#include "mydumper_integer_chunks.h"
+#include "mydumper_plan.h"
+
+/*
+  Chunk plan for --plan.
+
+  The tables are discovered and their chunk strategy is selected as in a
+  regular dump, with the same row estimates and MIN/MAX probes, but no data
+  is read. Every chunk of a table is expected to have the same size, and the
+  chunks of all the tables are given to the least loaded thread, the biggest
+  ones first. The load of the busiest thread is the predicted makespan: when
+  it is far from an even split, a single chunk, usually a table dumped with a
+  full scan, is bigger than the share of a thread.
+*/
+
+gboolean plan = FALSE;
+static GMutex *plan_mutex = NULL;
+static GList *plan_items = NULL;
+
+static const gchar *chunk_type_names[] = {"NONE", "INTEGER", "CHAR", "PARTITION", "MULTICOLUMN"};
+
+void initialize_plan(){
+  plan_mutex=g_mutex_new();
+  // Discovery only, nothing is locked and no file is written but the metadata
+  no_data=TRUE;
+  no_schemas=TRUE;
+  no_locks=TRUE;
+  dump_triggers=FALSE;
+  dump_routines=FALSE;
+  dump_events=FALSE;
+}
+
+static
+guint64 get_data_length(MYSQL *conn, struct db_table *dbt){
+  MYSQL_RES *res = NULL;
+  MYSQL_ROW row;
+  guint64 data_length=0;
+  gchar *query = g_strdup_printf(
+      "SELECT DATA_LENGTH, AVG_ROW_LENGTH FROM information_schema.TABLES "
+      "WHERE TABLE_SCHEMA='%s' AND TABLE_NAME='%s'", dbt->database->escaped, dbt->escaped_table);
+  if (mysql_query(conn, query)){
+    g_warning("Could not get the data length of %s.%s: %s", dbt->database->name, dbt->table, mysql_error(conn));
+    g_free(query);
+    return dbt->data_length;
+  }
+  g_free(query);
+  res = mysql_store_result(conn);
+  if (!res)
+    return dbt->data_length;
+  if ((row = mysql_fetch_row(res))) {
+    if (row[0])
+      data_length=strtoull(row[0], NULL, 10);
+    // Engines without DATA_LENGTH still report the length of the rows
+    if (data_length == 0 && row[1])
+      data_length=strtoull(row[1], NULL, 10) * dbt->rows_total;
+  }
+  mysql_free_result(res);
+  return data_length;
+}
+
+void plan_table(MYSQL *conn, struct db_table *dbt){
+  struct plan_item *pi=g_new0(struct plan_item, 1);
+  struct chunk_step_item *csi;
+  struct integer_step *ics;
+  guint64 range;
+
+  set_chunk_strategy_for_dbt(conn, dbt);
+  csi=dbt->chunks->data;
+  pi->database=g_strdup(dbt->database->name);
+  pi->table=g_strdup(dbt->table);
+  pi->key=dbt->primary_key ? g_strdup(dbt->primary_key->data) : NULL;
+  pi->chunk_type=csi->chunk_type;
+  pi->rows=dbt->rows_total;
+  pi->bytes=get_data_length(conn, dbt);
+  pi->chunks=1;
+  switch (csi->chunk_type){
+    case INTEGER:
+      ics=&(csi->chunk_step->integer_step);
+      range=ics->is_unsigned ? ics->type.unsign.max - ics->type.unsign.min : gint64_abs(ics->type.sign.max - ics->type.sign.min);
+      pi->chunks=ics->step > 0 ? range / ics->step + 1 : 1;
+      // A sparse key has less chunks with rows than steps in its range, only those are dumped
+      if (ics->step > 0 && pi->chunks > dbt->rows_total / ics->step + 1)
+        pi->chunks=dbt->rows_total / ics->step + 1;
+      // The step of the chunks grows or shrinks with the time they take
+      pi->dynamic=!ics->is_step_fixed_length;
+      break;
+    case PARTITION:
+      pi->chunks=g_list_length(csi->chunk_step->partition_step.list);
+      break;
+    case NONE:
+      pi->reason=dbt->no_chunk_reason;
+      break;
+    default:
+      break;
+  }
+  if (pi->chunks == 0)
+    pi->chunks=1;
+
+  g_mutex_lock(plan_mutex);
+  plan_items=g_list_prepend(plan_items, pi);
+  g_mutex_unlock(plan_mutex);
+}
+
+static
+gint compare_plan_item(gconstpointer a, gconstpointer b){
+  const struct plan_item *pi_a=a, *pi_b=b;
+  gint r=g_strcmp0(pi_a->database, pi_b->database);
+  return r ? r : g_strcmp0(pi_a->table, pi_b->table);
+}
+
+static
+gint compare_chunk_bytes(gconstpointer a, gconstpointer b){
+  const struct plan_item *pi_a=a, *pi_b=b;
+  guint64 chunk_a=pi_a->bytes / pi_a->chunks, chunk_b=pi_b->bytes / pi_b->chunks;
+  return chunk_a > chunk_b ? -1 : chunk_a < chunk_b;
+}
+
+static
+void free_plan_item(struct plan_item *pi){
+  g_free(pi->database);
+  g_free(pi->table);
+  g_free(pi->key);
+  g_free(pi);
+}
+
+void print_plan(){
+  GList *iter;
+  struct plan_item *pi, *biggest=NULL;
+  guint64 *thread_bytes, *thread_chunks;
+  guint64 total_bytes=0, total_rows=0, total_chunks=0, chunk_bytes, per_thread, c;
+  guint t, least_loaded, busiest=0;
+
+  if (!plan)
+    return;
+  plan_items=g_list_sort(plan_items, compare_plan_item);
+  g_message("Plan with %u threads, %u tables:", num_threads, g_list_length(plan_items));
+  for (iter=plan_items; iter != NULL; iter=iter->next){
+    pi=iter->data;
+    g_message("`%s`.`%s`: %s%s on %s, %"G_GUINT64_FORMAT" chunks, ~%"G_GUINT64_FORMAT" rows, %.1f MB%s%s",
+              pi->database, pi->table, chunk_type_names[pi->chunk_type], pi->dynamic ? " (dynamic step)" : "",
+              pi->key ? pi->key : "no key", pi->chunks, pi->rows, (gdouble)pi->bytes / 1000000,
+              pi->chunk_type == NONE ? ", full scan: " : "",
+              pi->chunk_type == NONE ? (pi->reason ? pi->reason : "unknown") : "");
+    total_bytes+=pi->bytes;
+    total_rows+=pi->rows;
+    total_chunks+=pi->chunks;
+  }
+  g_message("Total: %"G_GUINT64_FORMAT" chunks, ~%"G_GUINT64_FORMAT" rows, %.1f MB",
+            total_chunks, total_rows, (gdouble)total_bytes / 1000000);
+
+  // Longest processing time first: every thread gets the same share of the
+  // chunks of a table, and the remainder goes to the least loaded threads
+  thread_bytes=g_new0(guint64, num_threads);
+  thread_chunks=g_new0(guint64, num_threads);
+  plan_items=g_list_sort(plan_items, compare_chunk_bytes);
+  for (iter=plan_items; iter != NULL; iter=iter->next){
+    pi=iter->data;
+    chunk_bytes=pi->bytes / pi->chunks;
+    if (biggest == NULL)
+      biggest=pi;
+    per_thread=pi->chunks / num_threads;
+    for (t=0; t<num_threads; t++){
+      thread_bytes[t]+=per_thread * chunk_bytes;
+      thread_chunks[t]+=per_thread;
+    }
+    for (c=0; c<pi->chunks % num_threads; c++){
+      least_loaded=0;
+      for (t=1; t<num_threads; t++)
+        if (thread_bytes[t] < thread_bytes[least_loaded])
+          least_loaded=t;
+      thread_bytes[least_loaded]+=chunk_bytes;
+      thread_chunks[least_loaded]++;
+    }
+  }
+  for (t=0; t<num_threads; t++){
+    g_message("Thread %u: %"G_GUINT64_FORMAT" chunks, %.1f MB", t + 1, thread_chunks[t], (gdouble)thread_bytes[t] / 1000000);
+    if (thread_bytes[t] > thread_bytes[busiest])
+      busiest=t;
+  }
+  if (total_bytes > 0){
+    g_message("Predicted makespan: %.1f MB on thread %u, %.1f%% over an even split of %.1f MB per thread",
+              (gdouble)thread_bytes[busiest] / 1000000, busiest + 1,
+              ((gdouble)thread_bytes[busiest] * num_threads / total_bytes - 1) * 100,
+              (gdouble)total_bytes / num_threads / 1000000);
+    if (biggest && biggest->bytes / biggest->chunks > total_bytes / num_threads)
+      g_message("The makespan is bounded by a chunk of %.1f MB of `%s`.`%s`",
+                (gdouble)biggest->bytes / biggest->chunks / 1000000, biggest->database, biggest->table);
+  }
+  g_free(thread_bytes);
+  g_free(thread_chunks);
+  g_list_free_full(plan_items, (GDestroyNotify)free_plan_item);
+  plan_items=NULL;
+}
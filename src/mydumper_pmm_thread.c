@@ -25,7 +25,10 @@
 #include <mysql.h>
 #include "mydumper_start_dump.h"
 #include "mydumper_global.h"
+#include "mydumper_database.h"
 #include "mydumper_stream.h"
+#include "mydumper_pmm_thread.h"
+#include "metrics.h"
 gint kill_pmm = 0;
 GMutex *pmm_mutex=NULL;
 const gchar* filename=NULL;
@@ -49,15 +52,22 @@ void append_pmm_entry_queue(GString *content, const gchar *key, GAsyncQueue * qu
 void append_pmm_entry_all_tables(GString *content){
   struct db_table *dbt=NULL;
   GHashTableIter iter;
-  g_hash_table_iter_init ( &iter, all_dbts );
   gchar *lkey;
+  // new_db_table() inserts into all_dbts while the dump is running
+  g_mutex_lock(all_dbts_mutex);
+  append_pmm_entry(content,"object", "all_tables",        g_hash_table_size(all_dbts));
+  g_hash_table_iter_init ( &iter, all_dbts );
   while ( g_hash_table_iter_next ( &iter, (gpointer *) &lkey, (gpointer *) &dbt ) ) {
     append_pmm_entry(content,"table",dbt->table, dbt->estimated_remaining_steps);
+    if (metrics_enabled)
+      append_metrics_table(content, "mydumper", dbt->database->name, dbt->table, &(dbt->metrics));
   }
+  g_mutex_unlock(all_dbts_mutex);
 }
 
-void write_pmm_entries(GString *content, struct configuration* conf){
-  g_string_set_size(content,0);
+/* Used by the PMM thread and by the metrics endpoint */
+void fill_pmm_entries(GString *content, gpointer data){
+  struct configuration* conf=data;
   append_pmm_entry_queue(content,"schema_queue",      conf->schema_queue);
   append_pmm_entry_queue(content,"non_innodb_queue",  conf->non_innodb.queue);
   append_pmm_entry_queue(content,"non_innodb_defer_queue", conf->non_innodb.defer);
@@ -68,10 +78,21 @@ void write_pmm_entries(GString *content, struct configuration* conf){
   append_pmm_entry_queue(content,"unlock_tables",     conf->unlock_tables);
   append_pmm_entry_queue(content,"pause_resume",      conf->pause_resume);
   append_pmm_entry(content,"queueu", "stream",            get_stream_queue_length());
-  append_pmm_entry(content,"object", "all_tables",        g_hash_table_size(all_dbts));
   append_pmm_entry(content,"object", "innodb_tables",     g_list_length(innodb_table->list));
   append_pmm_entry(content,"object", "non_innodb_tables", g_list_length(non_innodb_table->list));
   append_pmm_entry_all_tables(content);
+  if (metrics_enabled){
+    append_metrics_threads(content, "mydumper");
+    append_metrics_histogram(content, "mydumper", METRICS_CHUNK_QUERY);
+    append_metrics_histogram(content, "mydumper", METRICS_WRITE);
+    append_metrics_histogram(content, "mydumper", METRICS_COMPRESSION_WAIT);
+    append_metrics_histogram(content, "mydumper", METRICS_QUEUE_WAIT);
+  }
+}
+
+void write_pmm_entries(GString *content, struct configuration* conf){
+  g_string_set_size(content,0);
+  fill_pmm_entries(content, conf);
   g_file_set_contents( filename , content->str, content->len, NULL);
 }
 
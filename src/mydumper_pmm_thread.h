@@ -17,3 +17,4 @@
 
 void *pmm_thread(void *data);
 void kill_pmm_thread();
+void fill_pmm_entries(GString *content, gpointer data);
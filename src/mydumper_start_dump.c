@@ -58,6 +58,9 @@
 #include "common.h"
 #include "common_options.h"
 #include "mydumper_global.h"
+#include "mydumper_discovery.h"
+#include "mydumper_less_locking.h"
+#include "mydumper_transportable.h"
 #include "mydumper_start_dump.h"
 #include "mydumper_jobs.h"
 #include "mydumper_common.h"
@@ -69,6 +72,7 @@
 #include "mydumper_masquerade.h"
 #include "mydumper_chunks.h"
 #include "mydumper_write.h"
+#include "table_history.h"
 /* Some earlier versions of MySQL do not yet define MYSQL_TYPE_JSON */
 #ifndef MYSQL_TYPE_JSON
 #define MYSQL_TYPE_JSON 245
@@ -123,6 +127,7 @@ void initialize_start_dump(){
   all_dbts=g_hash_table_new(g_str_hash, g_str_equal);
   initialize_set_names();
   initialize_working_thread();
+  initialize_transportable();
 	initialize_conf_per_table(&conf_per_table);
 
   // until we have an unique option on lock types we need to ensure this
@@ -1034,6 +1039,7 @@ void start_dump() {
 //  detect_server_version(conn);
   MYSQL *conn = create_main_connection();
   main_connection = conn;
+  load_collations(conn);
   MYSQL *second_conn = conn;
   struct configuration conf;
   memset(&conf, 0, sizeof(conf));
@@ -1067,6 +1073,10 @@ void start_dump() {
   }
 
 
+  // The history is made of the table counters
+  load_history("mydumper");
+  if (pmm || metrics_port || bottleneck_report || history_file)
+    initialize_metrics();
   GThread *pmmthread = NULL;
   if (pmm){
 
@@ -1079,6 +1089,7 @@ void start_dump() {
       g_error_free(serror);
     }
   }
+  start_metrics_server(&fill_pmm_entries, &conf);
 
   if (stream)
     metadata_partial_filename= g_strdup_printf("%s/metadata.header", dump_directory);
@@ -1399,9 +1410,11 @@ void start_dump() {
     g_async_queue_push(conf.schema_queue, j);
   }
 
+  sort_tables_by_history();
   if (less_locking){
-    build_lock_tables_statement(&conf);
+    lock_non_innodb_tables();
   }
+  lock_transportable_tables();
 
   for (n = 0; n < num_threads; n++) {
     g_async_queue_push(conf.ready_non_innodb_queue, GINT_TO_POINTER(1));
@@ -1422,6 +1435,7 @@ void start_dump() {
       release_binlog_function(second_conn);
     }
   }
+  start_transportable_export();
   if (replica_stopped){
     g_message("Starting replica");
     if (mysql_query(conn, start_replica_sql_thread)){
@@ -1449,6 +1463,7 @@ void start_dump() {
   for (n = 0; n < num_threads; n++) {
     g_thread_join(threads[n]);
   }
+  wait_transportable_export();
   finalize_working_thread();
   finalize_write();
   if (release_ddl_lock_function != NULL) {
@@ -1476,13 +1491,18 @@ void start_dump() {
     dbt= (struct db_table *) g_hash_table_lookup(all_dbts, it->data);
     g_assert(dbt);
     print_dbt_on_metadata(mdfile, dbt);
+    if (dbt->metrics.usec > 0)
+      update_table_history(dbt->database->name, dbt->table, dbt->rows, dbt->metrics.bytes,
+                           (gdouble)dbt->metrics.usec / G_USEC_PER_SEC, dbt->last_chunk_step);
   }
+  save_history();
   write_database_on_disk(mdfile);
   g_list_free(table_schemas);
   table_schemas=NULL;
   if (pmm){
     kill_pmm_thread();
   }
+  stop_metrics_server();
   g_async_queue_unref(conf.innodb.defer);
   conf.innodb.defer= NULL;
   g_async_queue_unref(conf.innodb.queue);
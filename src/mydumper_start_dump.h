@@ -24,6 +24,7 @@ struct MList;
 #define MYDUMPER "mydumper"
 
 #include "common.h"
+#include "metrics.h"
 
 enum job_type {
   JOB_SHUTDOWN,
@@ -49,6 +50,57 @@ enum job_type {
   JOB_WRITE_MASTER_STATUS
 };
 
+static inline
+const char *jtype2str(enum job_type jtype)
+{
+  switch (jtype) {
+  case JOB_SHUTDOWN:
+    return "JOB_SHUTDOWN";
+  case JOB_RESTORE:
+    return "JOB_RESTORE";
+  case JOB_DUMP:
+    return "JOB_DUMP";
+  case JOB_DUMP_NON_INNODB:
+    return "JOB_DUMP_NON_INNODB";
+  case JOB_DEFER:
+    return "JOB_DEFER";
+  case JOB_DETERMINE_CHUNK_TYPE:
+    return "JOB_DETERMINE_CHUNK_TYPE";
+  case JOB_TABLE:
+    return "JOB_TABLE";
+  case JOB_CHECKSUM:
+    return "JOB_CHECKSUM";
+  case JOB_SCHEMA:
+    return "JOB_SCHEMA";
+  case JOB_VIEW:
+    return "JOB_VIEW";
+  case JOB_SEQUENCE:
+    return "JOB_SEQUENCE";
+  case JOB_TRIGGERS:
+    return "JOB_TRIGGERS";
+  case JOB_SCHEMA_TRIGGERS:
+    return "JOB_SCHEMA_TRIGGERS";
+  case JOB_SCHEMA_POST:
+    return "JOB_SCHEMA_POST";
+  case JOB_BINLOG:
+    return "JOB_BINLOG";
+  case JOB_CREATE_DATABASE:
+    return "JOB_CREATE_DATABASE";
+  case JOB_CREATE_TABLESPACE:
+    return "JOB_CREATE_TABLESPACE";
+  case JOB_DUMP_DATABASE:
+    return "JOB_DUMP_DATABASE";
+  case JOB_DUMP_ALL_DATABASES:
+    return "JOB_DUMP_ALL_DATABASES";
+  case JOB_DUMP_TABLE_LIST:
+    return "JOB_DUMP_TABLE_LIST";
+  case JOB_WRITE_MASTER_STATUS:
+    return "JOB_WRITE_MASTER_STATUS";
+  }
+  g_assert(0);
+  return 0;
+}
+
 struct MList{
   GList *list;
   GMutex *mutex;
@@ -101,7 +153,6 @@ struct configuration {
   GAsyncQueue *gtid_pos_checked;
   GAsyncQueue *are_all_threads_in_same_pos;
   GMainLoop * loop;
-  GString *lock_tables_statement;
   GMutex *mutex;
   int done;
 };
@@ -344,6 +395,10 @@ struct db_table {
   gchar *triggers_checksum;
   guint chunk_filesize;
   gboolean split_integer_tables;
+  const gchar *no_chunk_reason;
+  guint64 last_chunk_step;
+  // Seconds of the data jobs of the table in the last run, from --history-file
+  gdouble history_seconds;
   guint64 min_chunk_step_size;
   guint64 starting_chunk_step_size;
   guint64 max_chunk_step_size;
@@ -351,6 +406,12 @@ struct db_table {
   enum db_table_states status;
   guint max_threads_per_table;
   guint current_threads_running;
+  GPtrArray *view_columns;
+  guint64 data_length;
+  guint jobs_in_flight;
+  gboolean all_jobs_enqueued;
+  struct locked_table *locked_table;
+  struct metrics_counters metrics;
 };
 
 
@@ -0,0 +1,311 @@
+/*
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+        Authors:    David Ducos, Percona (david dot ducos at percona dot com)
+*/
+#include <mysql.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "common.h"
+#include "connection.h"
+#include "logging.h"
+#include "mydumper_start_dump.h"
+#include "mydumper_database.h"
+#include "mydumper_common.h"
+#include "mydumper_global.h"
+#include "mydumper_file_handler.h"
+#include "mydumper_working_thread.h"
+#include "mydumper_write.h"
+#include "mydumper_transportable.h"
+
+/*
+  Physical copy of InnoDB tables with transportable tablespaces.
+
+  The data of the tables in --transportable-tables is not dumped with SELECT.
+  While the global lock is held, a connection locks them with LOCK TABLES
+  READ, as FLUSH TABLES FOR EXPORT is not able to get its locks until the
+  global lock is released. Once it is released, another connection sends
+  FLUSH TABLES ... FOR EXPORT, the first connection unlocks the tables and
+  the .ibd and .cfg files are copied from the datadir, through the same
+  compression than the rest of the files, by --threads copy threads. The
+  tables are blocked for writes until the copy finishes.
+
+  The data file of every table has the DISCARD and IMPORT TABLESPACE
+  statements that myloader executes after copying the files into its
+  datadir, so both tools need to run on the database host.
+*/
+
+gchar *transportable_tables_list = NULL;
+static gchar **transportable_tables = NULL;
+static GList *transportable_dbts = NULL;
+static GMutex *transportable_dbts_mutex = NULL;
+static MYSQL *lock_conn = NULL;
+static GThread *export_thread = NULL;
+
+struct tablespace_copy {
+  struct db_table *dbt;
+  gchar *source;
+  gchar *destination;
+};
+
+void initialize_transportable(){
+  if (transportable_tables_list == NULL)
+    return;
+  transportable_tables=get_table_list(transportable_tables_list);
+  transportable_dbts_mutex=g_mutex_new();
+}
+
+gboolean is_transportable_table(struct db_table *dbt, gchar *ecol){
+  return transportable_tables != NULL &&
+         ecol != NULL && !g_ascii_strcasecmp("InnoDB", ecol) &&
+         is_table_in_list(dbt->database->name, dbt->table, transportable_tables);
+}
+
+void add_transportable_table(struct db_table *dbt){
+  g_mutex_lock(transportable_dbts_mutex);
+  transportable_dbts=g_list_prepend(transportable_dbts, dbt);
+  g_mutex_unlock(transportable_dbts_mutex);
+}
+
+static
+GString *build_table_list(const gchar *prefix, const gchar *suffix){
+  GString *statement=g_string_new(prefix);
+  GList *iter;
+  struct db_table *dbt;
+  for (iter=transportable_dbts; iter != NULL; iter=iter->next){
+    dbt=iter->data;
+    g_string_append_printf(statement, "%s%s%s%s.%s%s%s%s", iter == transportable_dbts ? "" : ", ",
+                           identifier_quote_character_str, dbt->database->name, identifier_quote_character_str,
+                           identifier_quote_character_str, dbt->table, identifier_quote_character_str, suffix);
+  }
+  return statement;
+}
+
+/* Called by the main thread while the global lock is held */
+void lock_transportable_tables(){
+  GString *statement=NULL;
+  if (transportable_dbts == NULL)
+    return;
+  if (no_locks || trx_consistency_only){
+    g_warning("Tablespaces of --transportable-tables are not going to be consistent with the rest of the backup without the global lock");
+    return;
+  }
+  statement=build_table_list("LOCK TABLES ", " READ");
+  lock_conn=mysql_init(NULL);
+  m_connect(lock_conn);
+  if (mysql_query(lock_conn, statement->str))
+    m_critical("Error locking transportable tables: %s", mysql_error(lock_conn));
+  g_string_free(statement, TRUE);
+}
+
+static
+gchar *get_datadir(MYSQL *conn){
+  MYSQL_RES *res=NULL;
+  MYSQL_ROW row;
+  gchar *datadir=NULL;
+  if (mysql_query(conn, "SELECT @@datadir") || !(res=mysql_store_result(conn)))
+    m_critical("Could not get the datadir: %s", mysql_error(conn));
+  row=mysql_fetch_row(res);
+  datadir=g_strdup(row && row[0] ? row[0] : "");
+  mysql_free_result(res);
+  return datadir;
+}
+
+/* The path of the .ibd file, without extension */
+static
+gchar *get_transportable_table_path(MYSQL *conn, struct db_table *dbt, gchar *datadir){
+  gchar *path=get_tablespace_path(conn, dbt->database->name, dbt->table, datadir);
+  if (path == NULL)
+    m_critical("Could not find the tablespace of %s.%s, only InnoDB tables with file per table tablespaces are transportable", dbt->database->name, dbt->table);
+  return path;
+}
+
+static
+gboolean copy_tablespace_file(guint thread_id, struct tablespace_copy *tc){
+  GString *buffer=g_string_sized_new(TRANSPORTABLE_COPY_BUFFER_SIZE);
+  gssize bytes=0;
+  guint64 size=0;
+  int outfile=0;
+  int infile=open(tc->source, O_RDONLY);
+  if (infile < 0){
+    g_critical("Thread %d: Could not open %s: %s", thread_id, tc->source, g_strerror(errno));
+    g_string_free(buffer, TRUE);
+    return FALSE;
+  }
+  outfile=m_open(&(tc->destination), "w");
+  null_output_data_file(outfile);
+  for (;;){
+    g_string_set_size(buffer, TRANSPORTABLE_COPY_BUFFER_SIZE);
+    bytes=read(infile, buffer->str, TRANSPORTABLE_COPY_BUFFER_SIZE);
+    if (bytes <= 0)
+      break;
+    g_string_set_size(buffer, bytes);
+    if (!write_data(outfile, buffer)){
+      bytes=-1;
+      break;
+    }
+    size+=bytes;
+  }
+  close(infile);
+  m_close(thread_id, outfile, tc->destination, size, tc->dbt);
+  g_string_free(buffer, TRUE);
+  if (bytes < 0){
+    g_critical("Thread %d: Could not copy %s", thread_id, tc->source);
+    return FALSE;
+  }
+  trace("Thread %d: %s copied, %"G_GUINT64_FORMAT" bytes", thread_id, tc->source, size);
+  return TRUE;
+}
+
+struct copy_thread_data {
+  guint thread_id;
+  GAsyncQueue *queue;
+};
+
+static
+void *copy_thread(struct copy_thread_data *ctd){
+  struct tablespace_copy *tc;
+  for (;;){
+    tc=g_async_queue_pop(ctd->queue);
+    if (tc->dbt == NULL){
+      g_free(tc);
+      break;
+    }
+    if (!copy_tablespace_file(ctd->thread_id, tc))
+      errors++;
+    g_free(tc->source);
+    g_free(tc->destination);
+    g_free(tc);
+  }
+  return NULL;
+}
+
+static
+void push_tablespace_copy(GAsyncQueue *queue, struct db_table *dbt, gchar *path, const gchar *extension){
+  struct tablespace_copy *tc=g_new0(struct tablespace_copy, 1);
+  tc->dbt=dbt;
+  tc->source=g_strdup_printf("%s.%s", path, extension);
+  tc->destination=build_filename(dbt->database->filename, dbt->table_filename, 0, 0, extension, NULL);
+  g_async_queue_push(queue, tc);
+}
+
+static
+void write_import_statements(struct db_table *dbt){
+  gchar *filename=build_sql_filename(dbt->database->filename, dbt->table_filename, 0, 0);
+  gchar *ibd=build_filename(dbt->database->filename, dbt->table_filename, 0, 0, "ibd", NULL);
+  gchar *cfg=build_filename(dbt->database->filename, dbt->table_filename, 0, 0, "cfg", NULL);
+  gchar *ibd_basename=g_path_get_basename(ibd);
+  gchar *cfg_basename=g_path_get_basename(cfg);
+  GString *statement=g_string_sized_new(statement_size);
+  int file=m_open(&filename, "w");
+  initialize_sql_statement(statement);
+  g_string_append_printf(statement, "ALTER TABLE %s%s%s DISCARD TABLESPACE;\n", identifier_quote_character_str, dbt->table, identifier_quote_character_str);
+  g_string_append_printf(statement, "ALTER TABLE %s%s%s IMPORT TABLESPACE /* FILES '%s%s' '%s%s' */;\n",
+                         identifier_quote_character_str, dbt->table, identifier_quote_character_str,
+                         ibd_basename, exec_per_thread_extension, cfg_basename, exec_per_thread_extension);
+  if (!write_data(file, statement)){
+    g_critical("Could not write out data for %s.%s", dbt->database->name, dbt->table);
+    errors++;
+  }
+  m_close(0, file, filename, statement->len, dbt);
+  g_string_free(statement, TRUE);
+  g_free(ibd_basename);
+  g_free(cfg_basename);
+  g_free(ibd);
+  g_free(cfg);
+  g_free(filename);
+}
+
+static
+void *transportable_export(void *data){
+  (void) data;
+  MYSQL *conn=mysql_init(NULL);
+  GAsyncQueue *queue=g_async_queue_new();
+  struct copy_thread_data *ctd=g_new(struct copy_thread_data, num_threads);
+  GThread **copy_threads=g_new(GThread *, num_threads);
+  GList *iter, *paths=NULL, *p;
+  GString *statement=NULL;
+  gchar *datadir=NULL;
+  gint64 locked_at;
+  guint n;
+
+  set_thread_name("TTS");
+  m_connect(conn);
+  datadir=get_datadir(conn);
+  // information_schema is queried before the session is in locked tables mode
+  for (iter=transportable_dbts; iter != NULL; iter=iter->next)
+    paths=g_list_append(paths, get_transportable_table_path(conn, iter->data, datadir));
+
+  statement=build_table_list("FLUSH TABLES ", "");
+  g_string_append(statement, " FOR EXPORT");
+  if (mysql_query(conn, statement->str))
+    m_critical("Error exporting transportable tables: %s", mysql_error(conn));
+  locked_at=g_get_monotonic_time();
+  g_string_free(statement, TRUE);
+  if (lock_conn != NULL){
+    mysql_query(lock_conn, UNLOCK_TABLES);
+    mysql_close(lock_conn);
+    lock_conn=NULL;
+  }
+  g_message("Copying tablespaces of %u tables", g_list_length(transportable_dbts));
+
+  for (n=0; n < num_threads; n++){
+    ctd[n].thread_id=n + 1;
+    ctd[n].queue=queue;
+    copy_threads[n]=g_thread_new("mydumper_copy", (GThreadFunc)copy_thread, &ctd[n]);
+  }
+  for (iter=transportable_dbts, p=paths; iter != NULL; iter=iter->next, p=p->next){
+    push_tablespace_copy(queue, iter->data, p->data, "ibd");
+    push_tablespace_copy(queue, iter->data, p->data, "cfg");
+  }
+  for (n=0; n < num_threads; n++)
+    g_async_queue_push(queue, g_new0(struct tablespace_copy, 1));
+  for (n=0; n < num_threads; n++)
+    g_thread_join(copy_threads[n]);
+
+  if (mysql_query(conn, UNLOCK_TABLES))
+    g_critical("Error unlocking transportable tables: %s", mysql_error(conn));
+  g_message("Tablespaces copied, transportable tables were locked for %.3f seconds",
+            (gdouble)(g_get_monotonic_time() - locked_at) / G_USEC_PER_SEC);
+  mysql_close(conn);
+
+  // The data files need to be the last ones for myloader in stream mode
+  for (iter=transportable_dbts; iter != NULL; iter=iter->next)
+    write_import_statements(iter->data);
+
+  g_list_free_full(paths, g_free);
+  g_free(datadir);
+  g_free(copy_threads);
+  g_free(ctd);
+  g_async_queue_unref(queue);
+  return NULL;
+}
+
+/* Called by the main thread after the global lock is released */
+void start_transportable_export(){
+  if (transportable_dbts == NULL)
+    return;
+  export_thread=g_thread_new("mydumper_tts", (GThreadFunc)transportable_export, NULL);
+}
+
+void wait_transportable_export(){
+  if (export_thread == NULL)
+    return;
+  g_thread_join(export_thread);
+  export_thread=NULL;
+}
@@ -0,0 +1,31 @@
+/*
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+        Authors:    David Ducos, Percona (david dot ducos at percona dot com)
+*/
+#ifndef _src_mydumper_transportable_h
+#define _src_mydumper_transportable_h
+#include <glib.h>
+
+#define TRANSPORTABLE_COPY_BUFFER_SIZE 4194304
+
+struct db_table;
+
+void initialize_transportable();
+gboolean is_transportable_table(struct db_table *dbt, gchar *ecol);
+void add_transportable_table(struct db_table *dbt);
+void lock_transportable_tables();
+void start_transportable_export();
+void wait_transportable_export();
+#endif
@@ -44,6 +44,7 @@
 #include "config.h"
 #include "server_detect.h"
 #include "connection.h"
+#include "trace_file.h"
 //#include "common_options.h"
 #include "common.h"
 #include <glib-unix.h>
@@ -69,6 +70,12 @@
 #include "mydumper_global.h"
 #include "mydumper_arguments.h"
 #include "mydumper_file_handler.h"
+#include "mydumper_discovery.h"
+#include "mydumper_less_locking.h"
+#include "mydumper_transportable.h"
+#include "mydumper_plan.h"
+#include "table_history.h"
+#include "tracepoints.h"
 
 /* Some earlier versions of MySQL do not yet define MYSQL_TYPE_JSON */
 #ifndef MYSQL_TYPE_JSON
@@ -120,6 +127,8 @@ int build_empty_files = 0;
 gchar *where_option=NULL;
 
 void dump_database_thread(MYSQL *, struct configuration*, struct database *);
+static gboolean is_job_queue_full(GAsyncQueue *queue);
+gboolean process_job(struct thread_data *td, struct job *job);
 
 guint64 min_chunk_step_size = 0;
 guint64 starting_chunk_step_size = 0;
@@ -171,6 +180,8 @@ void initialize_working_thread(){
 
 // TODO: We need to cleanup this
 
+  if (null_output && (compress_method!=NULL || exec_per_thread!=NULL || exec_command!=NULL || stream))
+    m_critical("--null-output is not compatible with --compress, --exec-per-thread, --exec or --stream");
   if (compress_method==NULL && exec_per_thread==NULL && exec_per_thread_extension == NULL) {
     exec_per_thread_extension=EMPTY_STRING;
     initialize_file_handler(FALSE);
@@ -351,7 +362,11 @@ void get_table_info_to_process_from_list(MYSQL *conn, struct configuration *conf
       if (!eval_regex(database->name, row[0]))
         continue;
 
-      create_job_to_dump_table(conf, is_view, is_sequence, database, g_strdup(row[tablecol]), g_strdup(row[collcol]), g_strdup(row[ecol]));
+      // The other threads are behind, we process the table instead of enqueuing it
+      if (is_job_queue_full(conf->initial_queue))
+        new_table_to_dump(conn, conf, is_view, is_sequence, database, row[tablecol], row[collcol], row[ecol]);
+      else
+        create_job_to_dump_table(conf, is_view, is_sequence, database, g_strdup(row[tablecol]), g_strdup(row[collcol]), g_strdup(row[ecol]));
     }
     mysql_free_result(result);
     g_strfreev(dt);
@@ -381,20 +396,33 @@ union chunk_step *new_partition_step(gchar *partition){
   return cs;
 }
 
-void m_async_queue_push_conservative(GAsyncQueue *queue, struct job *element){
-  // Each job weights 500 bytes aprox.
-  // if we reach to 200k of jobs, which is 100MB of RAM, we are going to wait 5 seconds
-  // which is not too much considering that it will impossible to proccess 200k of jobs
-  // in 5 seconds.
-  // I don't think that we need to this values as parameters, unless that a user needs to
-  // set hundreds of threads
-  while (g_async_queue_length(queue)>200000){
-    g_warning("Too many jobs in the queue. We are pausing the jobs creation for 5 seconds.");
-    sleep(5);
-  }
-  g_async_queue_push(queue, element);
+/*
+  Backpressure on the job creation. Instead of sleeping when the queues are
+  too big, the threads that create the jobs do the work themselves: a database
+  job processes the tables inline when initial_queue is full and the threads
+  creating jobs dump the schemas when schema_queue is full. Each job weights
+  500 bytes aprox, so the memory used by the queues stays bounded and the
+  schema files are written while the catalog is still being discovered.
+*/
+static
+gboolean is_job_queue_full(GAsyncQueue *queue){
+  return g_async_queue_length(queue) > (gint)(num_threads * MAX_QUEUED_JOBS_PER_THREAD);
 }
 
+static
+void drain_schema_queue(struct thread_data *td){
+  struct job *job = NULL;
+  while (g_async_queue_length(td->conf->schema_queue) > (gint)(num_threads * MAX_QUEUED_JOBS_PER_THREAD / 2)){
+    job = (struct job *)g_async_queue_try_pop(td->conf->schema_queue);
+    if (job == NULL)
+      break;
+    if (job->type == JOB_SHUTDOWN){
+      g_async_queue_push(td->conf->schema_queue, job);
+      break;
+    }
+    process_job(td, job);
+  }
+}
 
 void thd_JOB_DUMP(struct thread_data *td, struct job *job){
   struct table_job *tj = (struct table_job *)job->job_data;
@@ -423,7 +451,11 @@ void thd_JOB_DUMP(struct thread_data *td, struct job *job){
   tj->chunk_step_item->chunk_functions.process(tj, tj->chunk_step_item);
   g_mutex_lock(tj->dbt->chunks_mutex);
   tj->dbt->current_threads_running--;
+  tj->dbt->jobs_in_flight--;
+  gboolean table_dumped= tj->dbt->all_jobs_enqueued && tj->dbt->jobs_in_flight == 0;
   g_mutex_unlock(tj->dbt->chunks_mutex);
+  if (table_dumped && tj->dbt->locked_table)
+    non_innodb_table_dumped(tj->dbt);
 
 /*  if (use_savepoints &&
       mysql_query(td->thrconn, "ROLLBACK TO SAVEPOINT mydumper")) {
@@ -622,6 +654,9 @@ gboolean process_job_builder_job(struct thread_data *td, struct job *job){
 }
 
 gboolean process_job(struct thread_data *td, struct job *job){
+    // The job is freed by its handler
+    enum job_type job_type=job->type;
+    TRACEPOINT2(mydumper, job__start, td->thread_id, job_type);
     switch (job->type) {
     case JOB_DETERMINE_CHUNK_TYPE:
       set_chunk_strategy_for_dbt(td->thrconn, (struct db_table *)(job->job_data));
@@ -669,11 +704,13 @@ gboolean process_job(struct thread_data *td, struct job *job){
       break;
     case JOB_SHUTDOWN:
       g_free(job);
+      TRACEPOINT2(mydumper, job__end, td->thread_id, job_type);
       return FALSE;
       break;
     default:
       m_error("Something very bad happened!");
     }
+  TRACEPOINT2(mydumper, job__end, td->thread_id, job_type);
   return TRUE;
 }
 
@@ -691,12 +728,21 @@ void check_pause_resume( struct thread_data *td ){
 
 void process_queue(GAsyncQueue * queue, struct thread_data *td, gboolean do_builder, GAsyncQueue *chunk_step_queue){
   struct job *job = NULL;
+  gint64 start_time=0;
+  gboolean cont=TRUE;
   for (;;) {
     check_pause_resume(td);
     if (chunk_step_queue) {
       g_async_queue_push(chunk_step_queue, GINT_TO_POINTER(1));
     }
+    if (do_builder && is_job_queue_full(td->conf->schema_queue))
+      drain_schema_queue(td);
+    start_time=metrics_enabled?g_get_monotonic_time():0;
+    metrics_thread_state(THREAD_STATE_QUEUE);
     job = (struct job *)g_async_queue_pop(queue);
+    metrics_thread_state(THREAD_STATE_OTHER);
+    if (metrics_enabled)
+      metrics_observe(METRICS_QUEUE_WAIT, g_get_monotonic_time() - start_time);
     if (shutdown_triggered && (job->type != JOB_SHUTDOWN)) {
       g_message("Thread %d: Process has been cacelled",td->thread_id);
       return;
@@ -706,32 +752,16 @@ void process_queue(GAsyncQueue * queue, struct thread_data *td, gboolean do_buil
         break;
       }
     } else {
-      if (!process_job(td, job)) {
+      trace_event_begin("job", "%s", jtype2str(job->type));
+      cont=process_job(td, job);
+      trace_event_end();
+      if (!cont) {
         break;
       }
     }
   }
 }
 
-void build_lock_tables_statement(struct configuration *conf){
-  g_mutex_lock(non_innodb_table->mutex);
-  GList *iter = non_innodb_table->list;
-  struct db_table *dbt;
-  if ( iter != NULL){
-    dbt = (struct db_table *)iter->data;
-    conf->lock_tables_statement = g_string_sized_new(30);
-    g_string_printf(conf->lock_tables_statement, "LOCK TABLES %s%s%s.%s%s%s READ LOCAL",
-                    identifier_quote_character_str, dbt->database->name, identifier_quote_character_str, identifier_quote_character_str, dbt->table, identifier_quote_character_str);
-    iter = iter->next;
-    for (; iter != NULL; iter = iter->next) {
-      dbt = (struct db_table *)iter->data;
-      g_string_append_printf(conf->lock_tables_statement, ", %s%s%s.%s%s%s READ LOCAL",
-                             identifier_quote_character_str, dbt->database->name, identifier_quote_character_str, identifier_quote_character_str, dbt->table, identifier_quote_character_str);
-    }
-  }
-  g_mutex_unlock(non_innodb_table->mutex);
-}
-
 void update_estimated_remaining_chunks_on_dbt(struct db_table *dbt){
   GList *l=dbt->chunks;
   guint64 total=0;
@@ -760,6 +790,8 @@ void *working_thread(struct thread_data *td) {
 
   initialize_thread(td);
   execute_gstring(td->thrconn, set_session);
+  set_thread_name("T%02u", td->thread_id);
+  metrics_register_thread("T%02u", td->thread_id);
 
   // Initialize connection 
   if (!skip_tz && mysql_query(td->thrconn, "/*!40103 SET TIME_ZONE='+00:00' */")) {
@@ -795,17 +827,12 @@ void *working_thread(struct thread_data *td) {
     g_async_queue_push(td->conf->ready, GINT_TO_POINTER(1)); 
     g_async_queue_pop(td->conf->ready_non_innodb_queue);
     if (less_locking){
-      // Sending LOCK TABLE over all non-innodb tables
-      if (td->conf->lock_tables_statement!=NULL && mysql_query(td->thrconn, td->conf->lock_tables_statement->str)) {
-        m_error("Error locking non-innodb tables %s", mysql_error(td->thrconn));
-      }
-      // This push will unlock the FTWRL on the Main Connection
+      // Non-innodb tables were locked by lock_non_innodb_tables(), this push
+      // will unlock the FTWRL on the Main Connection
       g_async_queue_push(td->conf->unlock_tables, GINT_TO_POINTER(1));
       process_queue(td->conf->non_innodb.queue, td, FALSE, td->conf->non_innodb.request_chunk);
       process_queue(td->conf->non_innodb.defer, td, FALSE, NULL);
-      if (mysql_query(td->thrconn, UNLOCK_TABLES)) {
-        m_error("Error locking non-innodb tables %s", mysql_error(td->thrconn));
-      }
+      release_non_innodb_table_locks();
     }else{
       process_queue(td->conf->non_innodb.queue, td, FALSE, td->conf->non_innodb.request_chunk);
       process_queue(td->conf->non_innodb.defer, td, FALSE, NULL);
@@ -902,7 +929,7 @@ gboolean has_json_fields(MYSQL *conn, char *database, char *table) {
 }
 
 
-struct function_pointer ** get_anonymized_function_for(MYSQL *conn, gchar *database, gchar *table){
+struct function_pointer ** get_anonymized_function_for(MYSQL *conn, gchar *database, gchar *table, GPtrArray *columns){
   // TODO #364: this is the place where we need to link the column between file loaded and dbt.
   // Currently, we are using identity_function, which return the same data.
   // Key: `database`.`table`.`column`
@@ -913,30 +940,38 @@ struct function_pointer ** get_anonymized_function_for(MYSQL *conn, gchar *datab
 
     MYSQL_RES *res = NULL;
     MYSQL_ROW row;
+    gboolean own_columns = columns == NULL;
+
+    if (own_columns){
+      gchar *query =
+        g_strdup_printf("select COLUMN_NAME from information_schema.COLUMNS "
+                        "where TABLE_SCHEMA='%s' and TABLE_NAME='%s' ORDER BY ORDINAL_POSITION;",
+                        database, table);
+      mysql_query(conn, query);
+      g_free(query);
 
-    gchar *query =
-      g_strdup_printf("select COLUMN_NAME from information_schema.COLUMNS "
-                      "where TABLE_SCHEMA='%s' and TABLE_NAME='%s' ORDER BY ORDINAL_POSITION;",
-                      database, table);
-    mysql_query(conn, query);
-    g_free(query);
+      res = mysql_store_result(conn);
+      columns = g_ptr_array_new_with_free_func(g_free);
+      while ((row = mysql_fetch_row(res)))
+        g_ptr_array_add(columns, g_strdup(row[0]));
+      mysql_free_result(res);
+    }
 
     struct function_pointer *fp;
-    res = mysql_store_result(conn);
     guint i=0;
-    anonymized_function_list = g_new0(struct function_pointer *, mysql_num_rows(res));
+    anonymized_function_list = g_new0(struct function_pointer *, columns->len);
     g_message("Using masquerade function on `%s`.`%s`", database, table);
-    while ((row = mysql_fetch_row(res))) {
-      fp=(struct function_pointer*)g_hash_table_lookup(ht,row[0]);
+    for (i=0; i<columns->len; i++){
+      fp=(struct function_pointer*)g_hash_table_lookup(ht,g_ptr_array_index(columns, i));
       if (fp != NULL){
-        g_message("Masquerade function found on `%s`.`%s`.`%s`", database, table, row[0]);
+        g_message("Masquerade function found on `%s`.`%s`.`%s`", database, table, (gchar *)g_ptr_array_index(columns, i));
         anonymized_function_list[i]=fp;
       }else{
         anonymized_function_list[i]=&identity_function_pointer;
       }
-      i++;
     }
-    mysql_free_result(res);
+    if (own_columns)
+      g_ptr_array_free(columns, TRUE);
   }
   g_free(k);
   return anonymized_function_list;
@@ -1012,9 +1047,52 @@ void get_primary_key_separated_by_comma(struct db_table * dbt) {
     dbt->primary_key_separated_by_comma = g_string_free(field_list, FALSE); 
 }
 
+/*
+  With --history-file, a table that was split by integer starts with the step
+  that it reached at the end of the last run, unless the step is fixed, and a
+  table gets a share of the threads as big as its share of the time of the
+  last run. The tables that took longer are enqueued first, see
+  sort_tables_by_history().
+*/
+static
+void apply_table_history(struct db_table *dbt, gboolean rows_per_table){
+  struct table_history *th=get_table_history(dbt->database->name, dbt->table);
+  guint threads;
+  if (th == NULL)
+    return;
+  dbt->history_seconds=th->seconds;
+  if (th->step > 0 && !rows_per_table && dbt->split_integer_tables &&
+      !(dbt->min_chunk_step_size != 0 && dbt->min_chunk_step_size == dbt->max_chunk_step_size)){
+    dbt->starting_chunk_step_size=th->step < dbt->min_chunk_step_size ? dbt->min_chunk_step_size : th->step;
+    if (dbt->max_chunk_step_size != 0 && dbt->starting_chunk_step_size > dbt->max_chunk_step_size)
+      dbt->starting_chunk_step_size=dbt->max_chunk_step_size;
+  }
+  threads=(guint)(get_history_share(th) * num_threads) + 1;
+  if (threads < dbt->max_threads_per_table)
+    dbt->max_threads_per_table=threads;
+}
+
+static
+gint compare_history_seconds(gconstpointer a, gconstpointer b){
+  gdouble seconds_a=((struct db_table *)a)->history_seconds, seconds_b=((struct db_table *)b)->history_seconds;
+  return seconds_a < seconds_b ? 1 : seconds_a > seconds_b ? -1 : 0;
+}
+
+/* Called by the main thread once the tables are discovered, before the data jobs start */
+void sort_tables_by_history(){
+  if (!history_file)
+    return;
+  g_mutex_lock(innodb_table->mutex);
+  innodb_table->list=g_list_sort(innodb_table->list, &compare_history_seconds);
+  g_mutex_unlock(innodb_table->mutex);
+  g_mutex_lock(non_innodb_table->mutex);
+  non_innodb_table->list=g_list_sort(non_innodb_table->list, &compare_history_seconds);
+  g_mutex_unlock(non_innodb_table->mutex);
+}
+
 gboolean new_db_table(struct db_table **d, MYSQL *conn, struct configuration *conf,
                       struct database *database, char *table, char *table_collation,
-                      gboolean is_sequence)
+                      gboolean is_view, gboolean is_sequence)
 {
   gchar * lkey = build_dbt_key(database->name,table);
 	g_mutex_lock(all_dbts_mutex);
@@ -1034,11 +1112,16 @@ gboolean new_db_table(struct db_table **d, MYSQL *conn, struct configuration *co
     dbt->table = identifier_quote_character_protect(table);
     dbt->table_filename = get_ref_table(dbt->table);
     dbt->is_sequence= is_sequence;
+    // Loaded by dump_database_thread(), when NULL we need to query the server
+    struct table_discovery *td = take_table_discovery(database, table);
     dbt->character_set = table_collation==NULL? NULL:get_character_set_from_collation(conn, table_collation);
-    dbt->has_json_fields = has_json_fields(conn, dbt->database->name, dbt->table);
+    dbt->has_json_fields = td ? td->has_json_fields : has_json_fields(conn, dbt->database->name, dbt->table);
     dbt->rows_lock= g_mutex_new();
+    dbt->metrics.rows=0;
+    dbt->metrics.bytes=0;
+    dbt->metrics.usec=0;
     dbt->escaped_table = escape_string(conn,dbt->table);
-    dbt->anonymized_function=get_anonymized_function_for(conn, dbt->database->name, dbt->table);
+    dbt->anonymized_function=get_anonymized_function_for(conn, dbt->database->name, dbt->table, td ? td->columns : NULL);
     dbt->where=g_hash_table_lookup(conf_per_table.all_where_per_table, lkey);
     dbt->limit=g_hash_table_lookup(conf_per_table.all_limit_per_table, lkey);
     dbt->columns_on_select=g_hash_table_lookup(conf_per_table.all_columns_on_select_per_table, lkey);
@@ -1069,6 +1152,10 @@ gboolean new_db_table(struct db_table **d, MYSQL *conn, struct configuration *co
 //  dbt->chunk_type_item.chunk_type = UNDEFINED;
 //  dbt->chunk_type_item.chunk_step = NULL;
     dbt->chunks=NULL;
+    dbt->no_chunk_reason=NULL;
+    dbt->last_chunk_step=0;
+    dbt->history_seconds=0;
+    apply_table_history(dbt, rows_p_chunk != NULL);
 //  dbt->initial_chunk_step=NULL;
     dbt->load_data_header=NULL;
     dbt->load_data_suffix=NULL;
@@ -1078,7 +1165,8 @@ gboolean new_db_table(struct db_table **d, MYSQL *conn, struct configuration *co
     dbt->chunks_queue=g_async_queue_new();
     dbt->chunks_completed=g_new(int,1);
     *(dbt->chunks_completed)=0;
-    get_primary_key(conn,dbt,conf);
+    if (!td || !set_primary_key_from_discovery(dbt, td, conf))
+      get_primary_key(conn,dbt,conf);
     dbt->primary_key_separated_by_comma = NULL;
     if (order_by_primary_key)
       get_primary_key_separated_by_comma(dbt);
@@ -1088,9 +1176,9 @@ gboolean new_db_table(struct db_table **d, MYSQL *conn, struct configuration *co
     dbt->chunk_filesize=chunk_filesize;
 //  create_job_to_determine_chunk_type(dbt, g_async_queue_push, );
 
-    dbt->complete_insert = complete_insert || detect_generated_fields(conn, dbt->database->escaped, dbt->escaped_table);
+    dbt->complete_insert = complete_insert || (td ? td->has_generated_fields : detect_generated_fields(conn, dbt->database->escaped, dbt->escaped_table));
     if (dbt->complete_insert) {
-      dbt->select_fields = get_insertable_fields(conn, dbt->database->escaped, dbt->escaped_table);
+      dbt->select_fields = td ? get_insertable_fields_from_discovery(td) : get_insertable_fields(conn, dbt->database->escaped, dbt->escaped_table);
     } else {
       dbt->select_fields = g_string_new("*");
     }
@@ -1100,6 +1188,19 @@ gboolean new_db_table(struct db_table **d, MYSQL *conn, struct configuration *co
     dbt->triggers_checksum=NULL;
     dbt->rows=0;
  // dbt->chunk_functions.process=NULL;
+    dbt->view_columns=NULL;
+    dbt->data_length=td ? td->data_length : 0;
+    dbt->jobs_in_flight=0;
+    dbt->all_jobs_enqueued=FALSE;
+    dbt->locked_table=NULL;
+    if (td){
+      // Used to build the placeholder table of the view
+      if (is_view){
+        dbt->view_columns=td->columns;
+        td->columns=NULL;
+      }
+      free_table_discovery(td);
+    }
     b=TRUE;
   }
   *d=dbt;
@@ -1118,6 +1219,8 @@ void free_db_table(struct db_table * dbt){
   g_free(dbt->data_checksum);
   dbt->data_checksum=NULL;
   g_free(dbt->chunks_completed);
+  if (dbt->view_columns)
+    g_ptr_array_free(dbt->view_columns, TRUE);
 
   g_free(dbt->table);
   g_mutex_unlock(dbt->chunks_mutex);
@@ -1138,7 +1241,7 @@ void new_table_to_dump(MYSQL *conn, struct configuration *conf, gboolean is_view
   g_mutex_unlock(database->ad_mutex);
 
   struct db_table *dbt=NULL;
-  gboolean b= new_db_table(&dbt, conn, conf, database, table, collation, is_sequence);
+  gboolean b= new_db_table(&dbt, conn, conf, database, table, collation, is_view, is_sequence);
   if (b){
   // if a view or sequence we care only about schema
   if ((!is_view || views_as_tables ) && !is_sequence) {
@@ -1153,12 +1256,18 @@ void new_table_to_dump(MYSQL *conn, struct configuration *conf, gboolean is_view
     if (dump_triggers && !database->dump_triggers && !dbt->object_to_export.no_trigger) {
       create_job_to_dump_triggers(conn, dbt, conf);
     }
+    if (plan && !dbt->object_to_export.no_data && ecol != NULL && g_ascii_strcasecmp("MRG_MYISAM",ecol)) {
+      plan_table(conn, dbt);
+    }
     if (!no_data && !dbt->object_to_export.no_data) {
       if (ecol != NULL && g_ascii_strcasecmp("MRG_MYISAM",ecol)) {
         if (data_checksums && !( get_major() == 5 && get_secondary() == 7 && dbt->has_json_fields ) ){
           create_job_to_dump_checksum(dbt, conf);
         }
-        if (trx_consistency_only ||
+        if (is_transportable_table(dbt, ecol)) {
+          dbt->is_innodb=TRUE;
+          add_transportable_table(dbt);
+        } else if (trx_consistency_only ||
           (ecol != NULL && (!g_ascii_strcasecmp("InnoDB", ecol) || !g_ascii_strcasecmp("TokuDB", ecol)))) {
           dbt->is_innodb=TRUE;
           g_mutex_lock(innodb_table->mutex);
@@ -1270,6 +1379,8 @@ void dump_database_thread(MYSQL *conn, struct configuration *conf, struct databa
     return;
   }
 
+  load_database_discovery(conn, database);
+
   if (mysql_query(conn, (query))) {
     g_critical("Error showing tables on: %s - Could not execute query: %s", database->name,
                mysql_error(conn));
@@ -1372,7 +1483,11 @@ void dump_database_thread(MYSQL *conn, struct configuration *conf, struct databa
 
     if (!dump)
       continue;
-    create_job_to_dump_table(conf, is_view, is_sequence, database, g_strdup(row[tablecol]), g_strdup(row[collcol]), g_strdup(row[ecol]));
+    // The other threads are behind, we process the table instead of enqueuing it
+    if (is_job_queue_full(conf->initial_queue))
+      new_table_to_dump(conn, conf, is_view, is_sequence, database, row[tablecol], row[collcol], row[ecol]);
+    else
+      create_job_to_dump_table(conf, is_view, is_sequence, database, g_strdup(row[tablecol]), g_strdup(row[collcol]), g_strdup(row[ecol]));
   }
 
   mysql_free_result(result);
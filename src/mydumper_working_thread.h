@@ -24,6 +24,7 @@
 #define REPLACE "REPLACE"
 #define UNLOCK_TABLES "UNLOCK TABLES"
 #define EMPTY_STRING ""
+#define MAX_QUEUED_JOBS_PER_THREAD 1000
 typedef gchar * (*fun_ptr2)(gchar **);
 
 void load_working_thread_entries(GOptionContext *context, GOptionGroup *extra_group, GOptionGroup * filter_group);
@@ -35,6 +36,6 @@ void new_table_to_dump(MYSQL *conn, struct configuration *conf, gboolean is_view
 void initialize_working_thread();
 void finalize_working_thread();
 void free_db_table(struct db_table * dbt);
-void build_lock_tables_statement(struct configuration *conf);
 void check_pause_resume( struct thread_data *td );
 void update_estimated_remaining_chunks_on_dbt(struct db_table *dbt);
+void sort_tables_by_history();
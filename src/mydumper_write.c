@@ -31,6 +31,8 @@
 #include <glib/gstdio.h>
 #include <gio/gio.h>
 #include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
 #include "mydumper_start_dump.h"
 #include "server_detect.h"
 #include "regex.h"
@@ -39,9 +41,11 @@
 #include "mydumper_database.h"
 #include "mydumper_working_thread.h"
 #include "mydumper_write.h"
+#include "tracepoints.h"
 #include "mydumper_masquerade.h"
 #include "mydumper_global.h"
 #include "connection.h"
+#include "trace_file.h"
 #include "mydumper_arguments.h"
 
 const gchar *insert_statement=INSERT;
@@ -52,6 +56,7 @@ gboolean load_data = FALSE;
 gboolean csv = FALSE;
 gboolean clickhouse = FALSE;
 gboolean include_header = FALSE;
+gboolean select_into_outfile = FALSE;
 const gchar *fields_enclosed_by=NULL;
 gchar *fields_escaped_by=NULL;
 gchar *fields_terminated_by=NULL;
@@ -236,6 +241,9 @@ void initialize_write(){
 	}
 
 
+  if (select_into_outfile && output_format != LOAD_DATA && output_format != CSV)
+    m_critical("--select-into-outfile needs --format LOAD_DATA or CSV");
+
   if ( insert_ignore && replace ){
     m_error("You can't use --insert-ignore and --replace at the same time");
   }
@@ -365,7 +373,7 @@ gboolean real_write_data(int file, float *filesize, GString *data) {
 
 gboolean write_data(int file, GString *data) {
   float f=0;
-  return real_write_data(file, &f, data);
+  return m_write(file, &f, data);
 }
 
 void initialize_load_data_statement_suffix(struct db_table *dbt, MYSQL_FIELD * fields, guint num_fields){
@@ -451,10 +459,21 @@ void initialize_load_data_header(struct db_table *dbt, MYSQL_FIELD *fields, guin
 }
 
 gboolean write_statement(int load_data_file, float *filessize, GString *statement, struct db_table * dbt){
-  if (!real_write_data(load_data_file, filessize, statement)) {
+  gint64 start_time=metrics_enabled?g_get_monotonic_time():0;
+  // With --exec-per-thread the file is the pipe of the compressor
+  enum thread_state previous_state=metrics_thread_state(exec_per_thread ? THREAD_STATE_COMPRESS : THREAD_STATE_WRITE);
+  gboolean written=m_write(load_data_file, filessize, statement);
+  metrics_thread_state(previous_state);
+  if (!written) {
     g_critical("Could not write out data for %s.%s", dbt->database->name, dbt->table);
     return FALSE;
   }
+  TRACEPOINT3(mydumper, statement__flush, load_data_file, dbt->table, statement->len);
+  if (metrics_enabled){
+    metrics_observe(METRICS_WRITE, g_get_monotonic_time() - start_time);
+    metrics_counters_add(&(dbt->metrics), 0, statement->len);
+    metrics_thread_add(0, statement->len);
+  }
   g_string_set_size(statement, 0);
   return TRUE;
 }
@@ -607,6 +626,8 @@ void update_dbt_rows(struct db_table * dbt, guint64 num_rows){
   g_mutex_lock(dbt->rows_lock);
   dbt->rows+=num_rows;
   g_mutex_unlock(dbt->rows_lock);
+  metrics_counters_add(&(dbt->metrics), num_rows, 0);
+  metrics_thread_add(num_rows, 0);
 }
 
 
@@ -721,7 +742,14 @@ void write_result_into_file(MYSQL *conn, MYSQL_RES *result, struct table_job * t
   message_dumping_data(tj);
 
   GDateTime *from = g_date_time_new_now_local();
+  gboolean first_row=TRUE;
+  metrics_thread_state(THREAD_STATE_SERVER);
 	while ((row = mysql_fetch_row(result))) {
+    metrics_thread_state(THREAD_STATE_SERIALIZE);
+    if (first_row){
+      TRACEPOINT3(mydumper, chunk__first__row, tj->td->thread_id, dbt->database->name, dbt->table);
+      first_row=FALSE;
+    }
     lengths = mysql_fetch_lengths(result);
     num_rows++;
     // prepare row into statement_row
@@ -791,7 +819,9 @@ void write_result_into_file(MYSQL *conn, MYSQL_RES *result, struct table_job * t
 		if (tj->td->thread_data_buffers.row->len>0)
       num_rows_st++;
     g_string_set_size(tj->td->thread_data_buffers.row, 0);
+    metrics_thread_state(THREAD_STATE_SERVER);
   }
+  metrics_thread_state(THREAD_STATE_SERIALIZE);
   update_dbt_rows(dbt, num_rows);
   if (num_rows_st > 0 && tj->td->thread_data_buffers.statement->len > 0){
     if (output_format == SQL_INSERT || output_format == CLICKHOUSE)
@@ -807,16 +837,12 @@ void write_result_into_file(MYSQL *conn, MYSQL_RES *result, struct table_job * t
   return;
 }
 
-/* Do actual data chunk reading/writing magic */
-void write_table_job_into_file(struct table_job * tj){
-  MYSQL *conn = tj->td->thrconn;
-  MYSQL_RES *result = NULL;
-  char *query = NULL;
-
+static
+gchar *build_table_job_query(struct table_job * tj){
   /* Ghm, not sure if this should be statement_size - but default isn't too big
    * for now */
   /* Poor man's database code */
-  query = g_strdup_printf(
+  return g_strdup_printf(
       "SELECT %s %s FROM %s%s%s.%s%s%s %s %s %s %s %s %s %s %s %s %s %s",
       is_mysql_like() ? "/*!40001 SQL_NO_CACHE */" : "",
       tj->dbt->columns_on_select?tj->dbt->columns_on_select:tj->dbt->select_fields->str,
@@ -827,6 +853,179 @@ void write_table_job_into_file(struct table_job * tj){
       order_by_primary_key && tj->dbt->primary_key_separated_by_comma ? " ORDER BY " : "", order_by_primary_key && tj->dbt->primary_key_separated_by_comma ? tj->dbt->primary_key_separated_by_comma : "",
       tj->dbt->limit ?  "LIMIT" : "", tj->dbt->limit ? tj->dbt->limit : ""
   );
+}
+
+/*
+  --select-into-outfile: the server writes every chunk with SELECT ... INTO
+  OUTFILE, using the same terminators that the LOAD DATA statement of the
+  table declares, into a temporary file next to the data file. The temporary
+  file is appended to the data file of the job, so the compression, rotation
+  and streaming are the same than when the rows are sent to the client.
+*/
+static
+gboolean initialize_load_data_from_empty_result(MYSQL *conn, struct db_table *dbt){
+  MYSQL_RES *result = NULL;
+  gchar *query = g_strdup_printf("SELECT %s FROM %s%s%s.%s%s%s LIMIT 0",
+      dbt->columns_on_select?dbt->columns_on_select:dbt->select_fields->str,
+      identifier_quote_character_str, dbt->database->name, identifier_quote_character_str, identifier_quote_character_str, dbt->table, identifier_quote_character_str);
+  if (mysql_query(conn, query) || !(result = mysql_store_result(conn))) {
+    g_critical("Error getting the columns of %s.%s: %s", dbt->database->name, dbt->table, mysql_error(conn));
+    g_free(query);
+    return FALSE;
+  }
+  g_free(query);
+  g_mutex_lock(dbt->chunks_mutex);
+  if (dbt->load_data_suffix==NULL){
+    initialize_load_data_statement_suffix(dbt, mysql_fetch_fields(result), mysql_num_fields(result));
+    if (include_header)
+      initialize_load_data_header(dbt, mysql_fetch_fields(result), mysql_num_fields(result));
+  }
+  g_mutex_unlock(dbt->chunks_mutex);
+  mysql_free_result(result);
+  return TRUE;
+}
+
+static
+void append_into_outfile_clause(MYSQL *conn, GString *query, struct db_table *dbt, gchar *outfile){
+  gchar *character_set=set_names_str != NULL ? set_names_str : dbt->character_set;
+  gchar *escaped_outfile=escape_string(conn, outfile);
+  g_string_append_printf(query, " INTO OUTFILE '%s' ", escaped_outfile);
+  g_free(escaped_outfile);
+  if (character_set && strlen(character_set)!=0)
+    g_string_append_printf(query, "CHARACTER SET %s ",character_set);
+  g_string_append_printf(query, "FIELDS TERMINATED BY '%s' ",fields_terminated_by_ld);
+  if (fields_enclosed_by_ld && strlen(fields_enclosed_by_ld)!=0)
+    g_string_append_printf(query, "ENCLOSED BY '%s' ",fields_enclosed_by_ld);
+  g_string_append_printf(query, "ESCAPED BY '%s' ",fields_escaped_by);
+  g_string_append(query, "LINES ");
+  if (lines_starting_by_ld)
+    g_string_append_printf(query, "STARTING BY '%s' ",lines_starting_by_ld);
+  g_string_append_printf(query, "TERMINATED BY '%s'", lines_terminated_by_ld);
+}
+
+static
+gboolean append_outfile_into_data_file(struct table_job * tj, gchar *outfile){
+  GString *buffer=tj->td->thread_data_buffers.statement;
+  gssize bytes;
+  int fd=open(outfile, O_RDONLY);
+  if (fd < 0){
+    g_critical("Thread %d: Could not open %s written by the server: %s", tj->td->thread_id, outfile, g_strerror(errno));
+    return FALSE;
+  }
+  for (;;){
+    g_string_set_size(buffer, statement_size);
+    bytes=read(fd, buffer->str, statement_size);
+    if (bytes <= 0)
+      break;
+    g_string_set_size(buffer, bytes);
+    if (!write_statement(tj->rows->file, &(tj->filesize), buffer, tj->dbt)){
+      bytes=-1;
+      break;
+    }
+  }
+  g_string_set_size(buffer, 0);
+  close(fd);
+  if (bytes < 0){
+    g_critical("Thread %d: Could not copy %s into %s", tj->td->thread_id, outfile, tj->rows->filename);
+    return FALSE;
+  }
+  return TRUE;
+}
+
+static
+void write_table_job_into_outfile(struct table_job * tj){
+  MYSQL *conn = tj->td->thrconn;
+  struct db_table *dbt = tj->dbt;
+  gchar *base_query = NULL;
+  GString *query = NULL;
+  gchar *outfile = NULL;
+
+  if (dbt->load_data_suffix==NULL && !initialize_load_data_from_empty_result(conn, dbt)){
+    errors++;
+    return;
+  }
+  if (update_files_on_table_job(tj)){
+    write_load_data_statement(tj);
+    write_header(tj);
+  }
+
+  // The server needs an absolute path and it is not able to overwrite a file
+  if (g_path_is_absolute(tj->rows->filename)){
+    outfile=g_strdup_printf("%s.outfile", tj->rows->filename);
+  }else{
+    gchar *current_dir=g_get_current_dir();
+    outfile=g_strdup_printf("%s/%s.outfile", current_dir, tj->rows->filename);
+    g_free(current_dir);
+  }
+  remove(outfile);
+
+  base_query=build_table_job_query(tj);
+  query=g_string_new(base_query);
+  g_free(base_query);
+  append_into_outfile_clause(conn, query, dbt, outfile);
+
+  message_dumping_data(tj);
+  if (mysql_query(conn, query->str)) {
+    if (success_on_1146 && mysql_errno(conn) == 1146) {
+      g_warning("Thread %d: Error dumping table (%s.%s) data: %s\nQuery: %s", tj->td->thread_id, dbt->database->name, dbt->table,
+                mysql_error(conn), query->str);
+    } else {
+      g_critical("Thread %d: Error dumping table (%s.%s) data into outfile, the output directory needs to be in secure_file_priv and writable by the server: %s\nQuery: %s", tj->td->thread_id, dbt->database->name, dbt->table,
+                 mysql_error(conn), query->str);
+      errors++;
+    }
+    goto cleanup;
+  }
+  update_dbt_rows(dbt, mysql_affected_rows(conn));
+
+  if (!append_outfile_into_data_file(tj, outfile)){
+    errors++;
+    goto cleanup;
+  }
+  tj->st_in_file++;
+
+  // if file size exceeded limit, we need to rotate
+  if (dbt->chunk_filesize && (guint)ceil((float)tj->filesize / 1024 / 1024) > dbt->chunk_filesize){
+    tj->sub_part++;
+    initiliaze_load_data_files(tj, dbt);
+    tj->st_in_file = 0;
+    tj->filesize = 0;
+  }
+
+cleanup:
+  if (remove(outfile) && errno != ENOENT)
+    g_warning("Thread %d: Failed to remove %s: %s", tj->td->thread_id, outfile, g_strerror(errno));
+  g_free(outfile);
+  g_string_free(query, TRUE);
+}
+
+/* Do actual data chunk reading/writing magic */
+void write_table_job_into_file(struct table_job * tj){
+  MYSQL *conn = tj->td->thrconn;
+  MYSQL_RES *result = NULL;
+  char *query = NULL;
+  gint64 start_time=metrics_enabled?g_get_monotonic_time():0;
+  trace_event_begin("chunk", "%s.%s", tj->dbt->database->name, tj->dbt->table);
+
+  // Tables with masquerade functions need the rows on the client
+  if (select_into_outfile && tj->dbt->anonymized_function == NULL){
+    metrics_thread_state(THREAD_STATE_SERVER);
+    // The query is built by write_table_job_into_outfile()
+    TRACEPOINT4(mydumper, chunk__query__start, tj->td->thread_id, tj->dbt->database->name, tj->dbt->table, NULL);
+    write_table_job_into_outfile(tj);
+    metrics_thread_state(THREAD_STATE_OTHER);
+    if (metrics_enabled){
+      metrics_observe(METRICS_CHUNK_QUERY, g_get_monotonic_time() - start_time);
+      metrics_counters_add_time(&(tj->dbt->metrics), g_get_monotonic_time() - start_time);
+    }
+    TRACEPOINT4(mydumper, chunk__query__end, tj->td->thread_id, tj->dbt->database->name, tj->dbt->table, (guint64)tj->filesize);
+    trace_event_end();
+    return;
+  }
+
+  query = build_table_job_query(tj);
+  TRACEPOINT4(mydumper, chunk__query__start, tj->td->thread_id, tj->dbt->database->name, tj->dbt->table, query);
+  metrics_thread_state(THREAD_STATE_SERVER);
   if (mysql_query(conn, query) || !(result = mysql_use_result(conn))) {
     if (!it_is_a_consistent_backup){
       g_warning("Thread %d: Error dumping table (%s.%s) data: %s\nQuery: %s", tj->td->thread_id, tj->dbt->database->name, tj->dbt->table,
@@ -885,5 +1084,12 @@ cleanup:
   if (result) {
     mysql_free_result(result);
   }
+  metrics_thread_state(THREAD_STATE_OTHER);
+  if (metrics_enabled){
+    metrics_observe(METRICS_CHUNK_QUERY, g_get_monotonic_time() - start_time);
+    metrics_counters_add_time(&(tj->dbt->metrics), g_get_monotonic_time() - start_time);
+  }
+  TRACEPOINT4(mydumper, chunk__query__end, tj->td->thread_id, tj->dbt->database->name, tj->dbt->table, (guint64)tj->filesize);
+  trace_event_end();
 }
 
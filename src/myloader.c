@@ -57,11 +57,17 @@
 #include "myloader_intermediate_queue.h"
 #include "myloader_arguments.h"
 #include "myloader_global.h"
+#include "trace_file.h"
 #include "myloader_worker_index.h"
 #include "myloader_worker_schema.h"
 #include "myloader_worker_loader.h"
 #include "myloader_worker_post.h"
 #include "myloader_control_job.h"
+#include "myloader_concurrency.h"
+#include "myloader_read_ahead.h"
+#include "myloader_sorted_ingest.h"
+#include "myloader_memory.h"
+#include "table_history.h"
 
 guint commit_count = 1000;
 gchar *input_directory = NULL;
@@ -162,7 +168,7 @@ void create_database(struct thread_data *td, gchar *database) {
                                             directory, database, exec_per_thread_extension);
 
   if (g_file_test(filepath, G_FILE_TEST_EXISTS)) {
-    g_atomic_int_add(&(detailed_errors.schema_errors), restore_data_from_file(td, filename, TRUE, NULL));
+    g_atomic_int_add(&(detailed_errors.schema_errors), restore_data_from_file(td, filename, TRUE, NULL, NULL));
   } else {
     GString *data = g_string_new("CREATE DATABASE IF NOT EXISTS ");
     g_string_append_printf(data,"`%s`", database);
@@ -277,6 +283,14 @@ int main(int argc, char *argv[]) {
     pmm_path=g_strdup_printf("/usr/local/percona/pmm2/collectors/textfile-collector/%s-resolution",pmm_resolution);
   }
 
+  initialize_trace_file("myloader");
+  // Nothing is loaded with --null-target, there is nothing to checksum
+  if (null_target)
+    checksum_mode=CHECKSUM_SKIP;
+  load_history("myloader");
+  // The report of --null-target and the history come from the table counters
+  if (pmm || metrics_port || bottleneck_report || null_target || history_file)
+    initialize_metrics();
   GThread *pmmthread = NULL;
   if (pmm){
 
@@ -287,6 +301,7 @@ int main(int argc, char *argv[]) {
       m_critical("Could not create pmm thread");
     }
   }
+  start_metrics_server(&fill_pmm_entries, &conf);
 //  initialize_job(purge_mode_str);
   initialize_restore_job(purge_mode_str);
   char *current_dir=g_get_current_dir();
@@ -367,6 +382,8 @@ int main(int argc, char *argv[]) {
     print_string("tables-list",tables_list);
     print_string("pmm-path",pmm_path);
     print_string("pmm-resolution",pmm_resolution);
+    print_int("metrics-port",metrics_port);
+    print_string("metrics-address",metrics_address);
 
     print_bool("enable-binlog",enable_binlog);
     if (!innodb_optimize_keys){
@@ -390,9 +407,25 @@ int main(int argc, char *argv[]) {
     print_bool("stream",stream);
 
     print_int("max-threads-per-table",max_threads_per_table);
+    print_bool("balance-threads-per-table",balance_threads_per_table);
     print_int("max-threads-for-index-creation",max_threads_for_index_creation);
+    print_int("index-build-budget",index_build_budget);
     print_int("max-threads-for-post-actions",max_threads_for_post_creation);
     print_int("max-threads-for-schema-creation",max_threads_for_schema_creation);
+    print_int("schema-batch-size",schema_batch_size);
+    print_int("split-large-files",split_large_files);
+    print_int("read-ahead-threads",read_ahead_threads);
+    print_int("read-ahead-files",read_ahead_files);
+    print_int("read-ahead-buffer",read_ahead_buffer);
+    print_int("memory-budget",memory_budget);
+    print_bool("adaptive-connections",adaptive_connections);
+    print_int("adaptive-connections-interval",adaptive_connections_interval);
+    print_int("adaptive-connections-min",adaptive_connections_min);
+    print_int("adaptive-connections-max-threads-running",adaptive_connections_max_threads_running);
+    print_int("adaptive-connections-max-history-length",adaptive_connections_max_history_length);
+    print_string("sorted-ingest",sorted_ingest_str);
+    print_bool("ingest-report",ingest_report);
+    print_bool("null-target",null_target);
     print_string("exec-per-thread",exec_per_thread);
     print_string("exec-per-thread-extension",exec_per_thread_extension);
 
@@ -406,6 +439,9 @@ int main(int argc, char *argv[]) {
 
     print_string("directory",input_directory);
     print_string("logfile",logfile);
+    print_string("trace-file",trace_file);
+    print_string("history-file",history_file);
+    print_bool("bottleneck-report",bottleneck_report);
 
     print_string("database",db);
     print_string("quote-character",identifier_quote_character_str);
@@ -495,6 +531,9 @@ int main(int argc, char *argv[]) {
   }
 
   initialize_connection_pool(conn);
+  initialize_memory_budget();
+  initialize_concurrency_control();
+  initialize_sorted_ingest();
   struct thread_data *t=g_new(struct thread_data,1);
   initialize_thread_data(t, &conf, WAITING, 0, NULL);
 //  t.connection_data.thrconn = conn;
@@ -523,6 +562,7 @@ int main(int argc, char *argv[]) {
     initialize_stream(&conf);
   }
 
+  initialize_read_ahead();
   initialize_loader_threads(&conf);
 
   if (stream){
@@ -540,12 +580,14 @@ int main(int argc, char *argv[]) {
 
   wait_schema_worker_to_finish();
   wait_loader_threads_to_finish();
+  wait_read_ahead_to_finish();
   wait_control_job();
   create_index_shutdown_job(&conf);
   wait_index_worker_to_finish();
   initialize_post_loding_threads(&conf);
   create_post_shutdown_job(&conf);
   wait_post_worker_to_finish();
+  stop_concurrency_control();
 //  wait_control_job();
   g_async_queue_unref(conf.ready);
   conf.ready=NULL;
@@ -565,6 +607,19 @@ int main(int argc, char *argv[]) {
     tl=tl->next;
   }
 
+  report_ingest(conf.table_list, cd->thrconn);
+  report_null_target(conf.table_list);
+
+  if (history_file && !null_target){
+    struct db_table *dbt;
+    for (tl=conf.table_list; tl != NULL; tl=tl->next){
+      dbt=tl->data;
+      if (dbt->metrics.usec > 0)
+        update_table_history(dbt->database->name, dbt->table, dbt->metrics.rows, dbt->metrics.bytes, (gdouble)dbt->metrics.usec / G_USEC_PER_SEC, 0);
+    }
+    save_history();
+  }
+
   if (checksum_mode != CHECKSUM_SKIP) {
     GHashTableIter iter;
     gchar *lkey;
@@ -634,6 +689,7 @@ int main(int argc, char *argv[]) {
     kill_pmm_thread();
 //    g_thread_join(pmmthread);
   }
+  stop_metrics_server();
 
 //  g_hash_table_foreach(conf.table_hash,&show_dbt, NULL);
   free_table_hash(conf.table_hash);
@@ -645,6 +701,8 @@ int main(int argc, char *argv[]) {
   print_errors();
 
   stop_signal_thread();
+  finish_trace_file();
+  print_bottleneck_report();
 
   if (logoutfile) {
     fclose(logoutfile);
@@ -21,6 +21,7 @@
 #define _src_myloader_h
 #include <mysql.h>
 #include "common.h"
+#include "metrics.h"
 #define MYLOADER "myloader"
 
 struct restore_errors {
@@ -139,6 +140,18 @@ struct db_table {
 	guint64 rows;
 //  GAsyncQueue * queue;
   GList * restore_job_list;
+  guint restore_job_count;
+  guint64 remaining_bytes;
+  guint64 data_bytes;
+  guint64 ready_key;
+  guint64 accounted_cost;
+  // Seconds per byte of the table in the last run, relative to the other tables
+  gdouble cost_factor;
+  gboolean accounted_with_jobs;
+  GSequenceIter *ready_iter;
+  guint key_ranges;
+  GList **key_range_next;
+  gboolean *key_range_busy;
   guint current_threads;
   guint max_threads;
   guint max_connections_per_job;
@@ -161,6 +174,7 @@ struct db_table {
   gchar *triggers_checksum;
   gboolean is_view;
   gboolean is_sequence;
+  struct metrics_counters metrics;
 };
 
 enum file_type { 
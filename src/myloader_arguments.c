@@ -27,6 +27,7 @@
 #include "logging.h"
 #include "connection.h"
 #include "regex.h"
+#include "metrics.h"
 #include <strings.h>
 
 extern gboolean enable_binlog;
@@ -90,6 +91,17 @@ gboolean arguments_callback(const gchar *option_name,const gchar *value, gpointe
       return TRUE;
     }
     g_critical("--checksum accepts: fail (default), warn, skip");
+  } else if (!strcmp(option_name, "--sorted-ingest")) {
+    sorted_ingest_str=g_strdup(value);
+    if (value == NULL || !strcasecmp(value, "RANGES")) {
+      sorted_ingest= SORTED_INGEST_RANGES;
+      return TRUE;
+    }
+    if (!strcasecmp(value, "SERIAL")) {
+      sorted_ingest= SORTED_INGEST_SERIAL;
+      return TRUE;
+    }
+    g_critical("--sorted-ingest accepts: ranges (default), serial");
   } 
   
   return common_arguments_callback(option_name, value, data, error);
@@ -119,16 +131,50 @@ static GOptionEntry entries[] = {
 static GOptionEntry threads_entries[] = {
     {"max-threads-per-table", 0, 0, G_OPTION_ARG_INT, &max_threads_per_table,
      "Maximum number of threads per table to use, defaults to --threads", NULL},
+    {"balance-threads-per-table", 0, 0, G_OPTION_ARG_NONE, &balance_threads_per_table,
+     "Allows tables to use more than --max-threads-per-table threads: the largest tables get a share of the threads proportional to their remaining size and, at the end of the restore, the idle threads are given to the tables that still have data", NULL},
     {"max-threads-for-index-creation", 0, 0, G_OPTION_ARG_INT, &max_threads_for_index_creation,
      "Maximum number of threads for index creation, default 4", NULL},
+    {"index-build-budget", 0, 0, G_OPTION_ARG_INT, &index_build_budget,
+     "Maximum estimated cost, in MB of table data times the amount of indexes, of the index builds running at the same time while data is still being loaded. Default 0, no limit", NULL},
     {"max-threads-for-post-actions", 0, 0, G_OPTION_ARG_INT,&max_threads_for_post_creation,
      "Maximum number of threads for post action like: constraints, procedure, views and triggers, default 1", NULL},
     {"max-threads-for-schema-creation", 0, 0, G_OPTION_ARG_INT, &max_threads_for_schema_creation,
      "Maximum number of threads for schema creation. When this is set to 1, is the same than --serialized-table-creation, default 4", NULL},
+    {"schema-batch-size", 0, 0, G_OPTION_ARG_INT, &schema_batch_size,
+     "Amount of CREATE TABLE of the same database that a schema thread sends in one multi statement round trip. Default 0, one table per round trip", NULL},
+    {"split-large-files", 0, 0, G_OPTION_ARG_INT, &split_large_files,
+     "Uncompressed data files bigger than this amount of MB are split in pieces of this size that are loaded by different threads. Not available with --stream. Default 0, disabled", NULL},
+    {"read-ahead-threads", 0, 0, G_OPTION_ARG_INT, &read_ahead_threads,
+     "Number of threads that open and split into statements the next data files of the tables being loaded, so the restore connections don't wait on decompression. Default 0, disabled", NULL},
+    {"read-ahead-files", 0, 0, G_OPTION_ARG_INT, &read_ahead_files,
+     "Amount of data files per table to read ahead when --read-ahead-threads is used, default 2", NULL},
+    {"read-ahead-buffer", 0, 0, G_OPTION_ARG_INT, &read_ahead_buffer,
+     "Maximum amount of memory in MB used to keep statements read ahead, default 256", NULL},
+    {"memory-budget", 0, 0, G_OPTION_ARG_INT, &memory_budget,
+     "Maximum amount of memory in MB used by the statements waiting to be executed, the statements read ahead and, with --stream, the data files received and not restored yet. "
+     "When it is reached, the stream, the read-ahead threads and the loader threads wait. Default 0, no limit", NULL},
     {"exec-per-thread",0, 0, G_OPTION_ARG_STRING, &exec_per_thread,
      "Set the command that will receive by STDIN from the input file and write in the STDOUT", NULL},
     {"exec-per-thread-extension",0, 0, G_OPTION_ARG_STRING, &exec_per_thread_extension,
      "Set the input file extension when --exec-per-thread is used. Otherwise it will be ignored", NULL},
+    {"adaptive-connections", 0, 0, G_OPTION_ARG_NONE, &adaptive_connections,
+     "Adjusts the amount of active connections between --adaptive-connections-min and --threads, reducing them when the server shows congestion", NULL},
+    {"adaptive-connections-interval", 0, 0, G_OPTION_ARG_INT, &adaptive_connections_interval,
+     "Seconds between each evaluation of --adaptive-connections, default 5", NULL},
+    {"adaptive-connections-min", 0, 0, G_OPTION_ARG_INT, &adaptive_connections_min,
+     "Minimum amount of active connections when --adaptive-connections is used, default 2", NULL},
+    {"adaptive-connections-max-threads-running", 0, 0, G_OPTION_ARG_INT, &adaptive_connections_max_threads_running,
+     "Reduces the active connections when Threads_running is over this value. Default 0, disabled", NULL},
+    {"adaptive-connections-max-history-length", 0, 0, G_OPTION_ARG_INT, &adaptive_connections_max_history_length,
+     "Reduces the active connections when the InnoDB history list length is over this value. Default 0, disabled", NULL},
+    {"sorted-ingest", 0, G_OPTION_FLAG_OPTIONAL_ARG, G_OPTION_ARG_CALLBACK, &arguments_callback,
+     "Loads the files of each table in primary key order. RANGES splits the table in one key range per thread, and each connection appends at the end of its range. "
+     "SERIAL loads the whole table in order with one connection. Not available with --stream. Default: RANGES", NULL},
+    {"ingest-report", 0, 0, G_OPTION_ARG_NONE, &ingest_report,
+     "At the end of the restore, prints the data load time and the data and index size of every table. Enabled by --sorted-ingest", NULL},
+    {"null-target", 0, 0, G_OPTION_ARG_NONE, &null_target,
+     "Read, parse and split the data statements but do not send them, the schemas are still created. Reports the MB/s of every table, the ceiling of myloader itself", NULL},
     {NULL, 0, 0, G_OPTION_ARG_NONE, NULL, NULL, NULL}};
 
 static GOptionEntry execution_entries[] = {
@@ -175,6 +221,10 @@ static GOptionEntry pmm_entries[] = {
       "which default value will be /usr/local/percona/pmm2/collectors/textfile-collector/high-resolution", NULL },
     { "pmm-resolution", 0, 0, G_OPTION_ARG_STRING, &pmm_resolution,
       "which default will be high", NULL },
+    { "metrics-port", 0, 0, G_OPTION_ARG_INT, &metrics_port,
+      "Serves the metrics in Prometheus format over HTTP on this port. Default: 0 (disabled)", NULL },
+    { "metrics-address", 0, 0, G_OPTION_ARG_STRING, &metrics_address,
+      "Address where the metrics endpoint listens. Default: 127.0.0.1", NULL },
     {NULL, 0, 0, G_OPTION_ARG_NONE, NULL, NULL, NULL}};
 
 
@@ -392,6 +392,10 @@ enum file_type get_file_type (const char * filename){
   if (m_filename_has_suffix(filename, ".dat"))
     return LOAD_DATA;
 
+  // Tablespaces of mydumper --transportable-tables, they are used like .dat files
+  if (m_filename_has_suffix(filename, ".ibd") || m_filename_has_suffix(filename, ".cfg"))
+    return LOAD_DATA;
+
   return IGNORED;
 }
 
@@ -0,0 +1,269 @@
+/*
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+        Authors:    David Ducos, Percona (david dot ducos at percona dot com)
+*/
+#include <mysql.h>
+#include <glib.h>
+#include <stdlib.h>
+#include <string.h>
+#include "common.h"
+#include "connection.h"
+#include "myloader.h"
+#include "myloader_global.h"
+#include "myloader_concurrency.h"
+
+/*
+  AIMD controller for the amount of active restore connections.
+
+  All the restore connections are created at startup and they live in
+  connection_pool while they are idle. The controller reduces the amount of
+  active connections by taking idle connections from connection_pool and
+  keeping them in parked_connections, where wait_for_available_restore_thread()
+  and request_another_connection() are not able to get them. Increasing the
+  amount of active connections is just pushing them back to connection_pool.
+*/
+
+extern GAsyncQueue *connection_pool;
+
+gboolean adaptive_connections = FALSE;
+guint adaptive_connections_interval = 5;
+guint adaptive_connections_min = 2;
+guint adaptive_connections_max_threads_running = 0;
+guint adaptive_connections_max_history_length = 0;
+
+static GThread *concurrency_t = NULL;
+static GAsyncQueue *concurrency_stop = NULL;
+static GAsyncQueue *parked_connections = NULL;
+static guint parked = 0;
+static GMutex *stats_mutex = NULL;
+
+/* accumulated by the restore threads between samples */
+static guint64 sample_rows = 0;
+static guint64 sample_queries = 0;
+static gint64 sample_query_time = 0;
+
+/* last decision, used by the PMM thread */
+static guint connection_limit = 0;
+static gdouble last_rows_per_second = 0;
+static gint64 last_query_latency = 0;
+static guint64 last_threads_running = 0;
+static guint64 last_history_length = 0;
+
+void concurrency_account_query(gint64 query_time){
+  if (!adaptive_connections)
+    return;
+  g_mutex_lock(stats_mutex);
+  sample_queries++;
+  sample_query_time+=query_time;
+  g_mutex_unlock(stats_mutex);
+}
+
+void concurrency_account_rows(guint n){
+  if (!adaptive_connections)
+    return;
+  g_mutex_lock(stats_mutex);
+  sample_rows+=n;
+  g_mutex_unlock(stats_mutex);
+}
+
+static
+void get_server_status(MYSQL *conn, guint64 *threads_running, guint64 *history_length){
+  MYSQL_RES *res=NULL;
+  MYSQL_ROW row;
+  gboolean history_length_found=FALSE;
+  if (mysql_query(conn, "SHOW GLOBAL STATUS WHERE Variable_name IN ('Threads_running','Innodb_history_list_length')")){
+    g_warning("Adaptive connections: SHOW GLOBAL STATUS failed: %s", mysql_error(conn));
+    return;
+  }
+  res=mysql_store_result(conn);
+  if (!res)
+    return;
+  while ((row=mysql_fetch_row(res))){
+    if (!g_ascii_strcasecmp(row[0], "Threads_running")){
+      *threads_running=g_ascii_strtoull(row[1], NULL, 10);
+    }else if (!g_ascii_strcasecmp(row[0], "Innodb_history_list_length")){
+      *history_length=g_ascii_strtoull(row[1], NULL, 10);
+      history_length_found=TRUE;
+    }
+  }
+  mysql_free_result(res);
+
+  // Innodb_history_list_length is only available on MariaDB and Percona Server
+  if (!history_length_found && adaptive_connections_max_history_length){
+    if (mysql_query(conn, "SELECT count FROM information_schema.INNODB_METRICS WHERE name='trx_rseg_history_len'"))
+      return;
+    res=mysql_store_result(conn);
+    if (!res)
+      return;
+    row=mysql_fetch_row(res);
+    if (row && row[0])
+      *history_length=g_ascii_strtoull(row[0], NULL, 10);
+    mysql_free_result(res);
+  }
+}
+
+/*
+  Parks or releases connections until the active connections match the limit.
+  Only the controller writes connection_limit and parked, it does it under
+  stats_mutex so the PMM thread reads them consistently.
+*/
+static
+void apply_connection_limit(guint limit){
+  struct connection_data *cd=NULL;
+  guint target=num_threads - limit;
+  g_mutex_lock(stats_mutex);
+  connection_limit=limit;
+  g_mutex_unlock(stats_mutex);
+  while (parked > target){
+    cd=g_async_queue_pop(parked_connections);
+    g_async_queue_push(connection_pool, cd);
+    g_mutex_lock(stats_mutex);
+    parked--;
+    g_mutex_unlock(stats_mutex);
+  }
+  while (parked < target){
+    cd=g_async_queue_try_pop(connection_pool);
+    if (cd == NULL)
+      // all the remaining connections are busy, we will park them in the next round
+      break;
+    g_async_queue_push(parked_connections, cd);
+    g_mutex_lock(stats_mutex);
+    parked++;
+    g_mutex_unlock(stats_mutex);
+  }
+}
+
+void *concurrency_thread(void *data){
+  (void) data;
+  MYSQL *conn=NULL;
+  guint64 restored_rows=0, queries=0;
+  gint64 query_time=0, query_latency=0, min_query_latency=0;
+  guint64 threads_running=0, history_length=0;
+  gdouble rows_per_second=0, previous_rows_per_second=0;
+  gint64 now, last_sample=g_get_monotonic_time();
+  guint previous_limit=0, limit=connection_limit;
+  const gchar *reason=NULL;
+
+  set_thread_name("ACC");
+  if (adaptive_connections_max_threads_running || adaptive_connections_max_history_length){
+    conn=mysql_init(NULL);
+    m_connect(conn);
+  }
+  trace("Thread concurrency_thread started");
+  while (g_async_queue_timeout_pop(concurrency_stop, (guint64)adaptive_connections_interval * G_USEC_PER_SEC) == NULL){
+    g_mutex_lock(stats_mutex);
+    restored_rows=sample_rows;
+    queries=sample_queries;
+    query_time=sample_query_time;
+    sample_rows=0;
+    sample_queries=0;
+    sample_query_time=0;
+    g_mutex_unlock(stats_mutex);
+
+    now=g_get_monotonic_time();
+    rows_per_second=now > last_sample ? (gdouble)restored_rows * G_USEC_PER_SEC / (now - last_sample) : 0;
+    last_sample=now;
+    query_latency=queries > 0 ? query_time / queries : 0;
+    if (conn)
+      get_server_status(conn, &threads_running, &history_length);
+
+    previous_limit=limit;
+    reason=NULL;
+    if (queries == 0){
+      // Nothing has been sent to the server, there is nothing to evaluate
+    }else if (adaptive_connections_max_threads_running && threads_running > adaptive_connections_max_threads_running){
+      reason="Threads_running over the threshold";
+    }else if (adaptive_connections_max_history_length && history_length > adaptive_connections_max_history_length){
+      reason="history list length over the threshold";
+    }else if (min_query_latency > 0 && query_latency > ADAPTIVE_CONNECTIONS_LATENCY_FACTOR * min_query_latency && rows_per_second < previous_rows_per_second){
+      reason="statement latency increased without throughput gain";
+    }
+
+    if (reason != NULL){
+      limit=(guint)(limit * ADAPTIVE_CONNECTIONS_DECREASE_FACTOR);
+      if (limit < adaptive_connections_min)
+        limit=adaptive_connections_min;
+    }else if (queries > 0 && limit < num_threads){
+      limit++;
+      reason="additive increase";
+    }
+
+    if (queries > 0){
+      // The baseline slowly drifts up to follow the natural changes of the workload
+      min_query_latency+=min_query_latency/16;
+      if (min_query_latency == 0 || query_latency < min_query_latency)
+        min_query_latency=query_latency;
+      previous_rows_per_second=rows_per_second;
+    }
+
+    g_mutex_lock(stats_mutex);
+    last_rows_per_second=rows_per_second;
+    last_query_latency=query_latency;
+    last_threads_running=threads_running;
+    last_history_length=history_length;
+    g_mutex_unlock(stats_mutex);
+
+    if (previous_limit != limit)
+      g_message("Adaptive connections: %u -> %u active connections (%s). Rows/s: %.0f | Avg statement: %.3f ms | Threads_running: %"G_GUINT64_FORMAT" | History list length: %"G_GUINT64_FORMAT,
+                previous_limit, limit, reason, rows_per_second, (gdouble)query_latency / 1000, threads_running, history_length);
+    else
+      trace("Adaptive connections: %u active connections, %u parked. Rows/s: %.0f | Avg statement: %"G_GINT64_FORMAT" us", limit, parked, rows_per_second, query_latency);
+    apply_connection_limit(limit);
+  }
+
+  // Every connection needs to be back in connection_pool before closing them
+  apply_connection_limit(num_threads);
+  if (conn)
+    mysql_close(conn);
+  trace("Thread concurrency_thread finished");
+  return NULL;
+}
+
+void initialize_concurrency_control(){
+  if (!adaptive_connections)
+    return;
+  if (adaptive_connections_interval == 0)
+    adaptive_connections_interval=1;
+  if (adaptive_connections_min == 0)
+    adaptive_connections_min=1;
+  if (adaptive_connections_min > num_threads)
+    adaptive_connections_min=num_threads;
+  connection_limit=num_threads;
+  stats_mutex=g_mutex_new();
+  concurrency_stop=g_async_queue_new();
+  parked_connections=g_async_queue_new();
+  g_message("Using adaptive connections between %u and %u, evaluated every %u seconds", adaptive_connections_min, num_threads, adaptive_connections_interval);
+  concurrency_t=g_thread_new("myloader_aimd", (GThreadFunc)concurrency_thread, NULL);
+}
+
+void stop_concurrency_control(){
+  if (!adaptive_connections)
+    return;
+  g_async_queue_push(concurrency_stop, GINT_TO_POINTER(1));
+  g_thread_join(concurrency_t);
+}
+
+void append_concurrency_pmm_entries(GString *content){
+  if (!adaptive_connections || stats_mutex == NULL)
+    return;
+  g_mutex_lock(stats_mutex);
+  g_string_append_printf(content,"myloader_adaptive_connections{name=\"limit\"} %u\n", connection_limit);
+  g_string_append_printf(content,"myloader_adaptive_connections{name=\"parked\"} %u\n", parked);
+  g_string_append_printf(content,"myloader_adaptive_connections{name=\"rows_per_second\"} %.0f\n", last_rows_per_second);
+  g_string_append_printf(content,"myloader_adaptive_connections{name=\"statement_latency_us\"} %"G_GINT64_FORMAT"\n", last_query_latency);
+  g_string_append_printf(content,"myloader_adaptive_connections{name=\"threads_running\"} %"G_GUINT64_FORMAT"\n", last_threads_running);
+  g_string_append_printf(content,"myloader_adaptive_connections{name=\"history_list_length\"} %"G_GUINT64_FORMAT"\n", last_history_length);
+  g_mutex_unlock(stats_mutex);
+}
@@ -0,0 +1,29 @@
+/*
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+        Authors:    David Ducos, Percona (david dot ducos at percona dot com)
+*/
+#ifndef _src_myloader_concurrency_h
+#define _src_myloader_concurrency_h
+#include <glib.h>
+
+#define ADAPTIVE_CONNECTIONS_LATENCY_FACTOR 2
+#define ADAPTIVE_CONNECTIONS_DECREASE_FACTOR 0.5
+
+void initialize_concurrency_control();
+void stop_concurrency_control();
+void concurrency_account_query(gint64 query_time);
+void concurrency_account_rows(guint n);
+void append_concurrency_pmm_entries(GString *content);
+#endif
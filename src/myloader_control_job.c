@@ -24,9 +24,12 @@
 #include "myloader_restore.h"
 //#include "myloader_jobs_manager.h"
 #include "myloader_global.h"
+#include "trace_file.h"
 #include "myloader_worker_loader.h"
 #include "myloader_worker_index.h"
 #include "myloader_worker_schema.h"
+#include "myloader_read_ahead.h"
+#include "myloader_sorted_ingest.h"
 
 gboolean control_job_ended=FALSE;
 gboolean all_jobs_are_enqueued=FALSE;
@@ -35,6 +38,13 @@ gboolean dont_wait_for_schema_create=FALSE;
 GAsyncQueue *refresh_db_queue = NULL, *here_is_your_job=NULL, *data_queue=NULL;
 //GAsyncQueue *give_me_another_job_queue = NULL;
 static GThread *control_job_t = NULL;
+static GSequence *ready_table_queue = NULL;
+static GMutex *ready_table_queue_mutex = NULL;
+static guint64 total_remaining_cost = 0;
+static guint tables_with_jobs = 0;
+/* Loaders parked by the control job thread, published for update_table_in_ready_queue() */
+static gint loaders_waiting = 0;
+gboolean balance_threads_per_table = FALSE;
 
 gint last_wait=0;
 //guint index_threads_counter = 0;
@@ -60,6 +70,8 @@ void initialize_control_job (struct configuration *conf){
   data_queue = g_async_queue_new();
   cjt_mutex= g_mutex_new();
   cjt_cond= g_cond_new();
+  ready_table_queue_mutex= g_mutex_new();
+  ready_table_queue= g_sequence_new(NULL);
 //  give_me_another_job_queue = g_async_queue_new();
   control_job_t = g_thread_new("myloader_ctr",(GThreadFunc)control_job_thread, conf);
 
@@ -93,7 +105,9 @@ gboolean process_job(struct thread_data *td, struct control_job *job, gboolean *
   switch (job->type) {
     case JOB_RESTORE: {
 //      g_message("Restore Job");
+      trace_event_begin("job", "%s %s", rjtype2str(job->data.restore_job->type), job->data.restore_job->filename);
       gboolean res= process_restore_job(td, job->data.restore_job);
+      trace_event_end();
       if (retry)
         *retry= res;
       return TRUE;
@@ -125,7 +139,8 @@ void schema_file_missed_lets_continue(struct thread_data * td){
     struct db_table * dbt = iter->data;
     g_mutex_lock(dbt->mutex);
     dbt->schema_state=CREATED;
-    for(i=0; i<g_list_length(dbt->restore_job_list); i++){
+    update_table_in_ready_queue(dbt);
+    for(i=0; i<dbt->restore_job_count; i++){
       g_async_queue_push(td->conf->stream_queue, GINT_TO_POINTER(DATA));
     }
     g_mutex_unlock(dbt->mutex);
@@ -185,7 +200,7 @@ gboolean are_available_jobs(struct thread_data * td){
   while (iter != NULL){
     struct db_table * dbt = iter->data;
     g_mutex_lock(dbt->mutex);
-    if (dbt->schema_state!=CREATED || g_list_length(dbt->restore_job_list) > 0){
+    if (dbt->schema_state!=CREATED || dbt->restore_job_list != NULL){
       g_mutex_unlock(dbt->mutex);
       g_mutex_unlock(td->conf->table_list_mutex);
       return TRUE;
@@ -197,12 +212,190 @@ gboolean are_available_jobs(struct thread_data * td){
   return FALSE;
 }
 
-gboolean give_me_next_data_job_conf(struct configuration *conf, struct restore_job ** rj){
+/*
+  ready_table_queue contains the tables that have data jobs that can be sent
+  right now, ordered by their remaining cost, so the largest tables are loaded
+  first (LPT). Tables are (re)inserted every time that something that changes
+  that condition happens, so the control job thread doesn't need to scan
+  table_list to find the next job.
+*/
+static gint cmp_ready_table(gconstpointer a, gconstpointer b, gpointer user_data){
+  (void) user_data;
+  const struct db_table *dbt_a=a, *dbt_b=b;
+  if (dbt_a->ready_key != dbt_b->ready_key)
+    return dbt_a->ready_key < dbt_b->ready_key ? 1 : -1;
+  if (dbt_a->rows != dbt_b->rows)
+    return dbt_a->rows < dbt_b->rows ? 1 : -1;
+  return 0;
+}
+
+/*
+  Remaining cost of the table, in bytes: the size of the pending files or, if
+  the size is unknown, the rows in metadata of the pending files converted
+  with DATA_COST_BYTES_PER_ROW, so both tables can be compared. With
+  --history-file, it is weighted by how slow the bytes of the table were in
+  the last run.
+*/
+static guint64 table_cost(struct db_table *dbt){
+  if (dbt->remaining_bytes > 0)
+    return dbt->remaining_bytes * dbt->cost_factor;
+  if (dbt->count > 0)
+    return dbt->rows * dbt->restore_job_count / dbt->count * DATA_COST_BYTES_PER_ROW * dbt->cost_factor;
+  return 0;
+}
+
+/*
+  With --balance-threads-per-table, max_threads is the minimum amount of
+  threads of the table. Tables with a big share of the remaining cost get
+  the same share of the threads, and when there are not enough tables with
+  jobs to keep all the threads busy, the threads are split between them.
+*/
+static guint table_max_threads(struct db_table *dbt){
+  guint max=dbt->max_threads;
+  if (!balance_threads_per_table || max >= num_threads)
+    return max;
+  if (total_remaining_cost > 0){
+    guint share=(guint)((num_threads * table_cost(dbt) + total_remaining_cost - 1) / total_remaining_cost);
+    if (share > max)
+      max=share;
+  }
+  if (tables_with_jobs > 0 && tables_with_jobs * dbt->max_threads < num_threads){
+    guint share=(num_threads + tables_with_jobs - 1) / tables_with_jobs;
+    if (share > max)
+      max=share;
+  }
+  return max > num_threads ? num_threads : max;
+}
+
+static gboolean is_table_ready(struct db_table *dbt){
+  return dbt->restore_job_list != NULL &&
+         dbt->schema_state == CREATED &&
+         !dbt->is_view && !dbt->is_sequence &&
+         dbt->current_threads < table_max_threads(dbt) &&
+         (sorted_ingest == SORTED_INGEST_NONE || has_idle_key_range(dbt)) &&
+         dbt->database->schema_state != NOT_FOUND;
+}
+
+/*
+  It must be called with dbt->mutex locked.
+  When a table becomes ready, or a table runs out of jobs and the caps of the
+  others grow, the parked loaders are woken up, as no other token might come
+  at the end of the load.
+*/
+void update_table_in_ready_queue(struct db_table *dbt){
+  if (ready_table_queue == NULL)
+    return;
+  guint64 cost=table_cost(dbt);
+  gboolean wake_loaders=FALSE;
+  g_mutex_lock(ready_table_queue_mutex);
+  // With --sorted-ingest, the key ranges are known when there are no more files to enqueue
+  if (sorted_ingest != SORTED_INGEST_NONE && dbt->key_ranges == 0 && all_jobs_are_enqueued &&
+      dbt->schema_state == CREATED && dbt->restore_job_list != NULL)
+    split_table_into_key_ranges(dbt, sorted_ingest == SORTED_INGEST_SERIAL ? 1 : table_max_threads(dbt));
+  total_remaining_cost=total_remaining_cost - dbt->accounted_cost + cost;
+  dbt->accounted_cost=cost;
+  if (dbt->accounted_with_jobs != (dbt->restore_job_list != NULL)){
+    dbt->accounted_with_jobs=dbt->restore_job_list != NULL;
+    if (dbt->accounted_with_jobs)
+      tables_with_jobs++;
+    else{
+      tables_with_jobs--;
+      wake_loaders=balance_threads_per_table;
+    }
+  }
+  if (dbt->ready_iter != NULL){
+    if (dbt->ready_key == cost && is_table_ready(dbt)){
+      g_mutex_unlock(ready_table_queue_mutex);
+      return;
+    }
+    g_sequence_remove(dbt->ready_iter);
+    dbt->ready_iter=NULL;
+  }
+  if (is_table_ready(dbt)){
+    dbt->ready_key=cost;
+    dbt->ready_iter=g_sequence_insert_sorted(ready_table_queue, dbt, &cmp_ready_table, NULL);
+    wake_loaders=TRUE;
+  }
+  g_mutex_unlock(ready_table_queue_mutex);
+  if (wake_loaders && g_atomic_int_get(&loaders_waiting) > 0){
+    trace("refresh_db_queue <- %s", ft2str(DATA));
+    g_async_queue_push(refresh_db_queue, GINT_TO_POINTER(DATA));
+  }
+}
+
+static struct restore_job *give_me_next_ready_data_job(){
+  struct restore_job *job = NULL;
+  struct db_table * dbt;
+  GSequenceIter *first;
+  while (job == NULL){
+    g_mutex_lock(ready_table_queue_mutex);
+    first=g_sequence_get_begin_iter(ready_table_queue);
+    if (g_sequence_iter_is_end(first)){
+      g_mutex_unlock(ready_table_queue_mutex);
+      return NULL;
+    }
+    dbt=g_sequence_get(first);
+    g_sequence_remove(first);
+    dbt->ready_iter=NULL;
+    g_mutex_unlock(ready_table_queue_mutex);
+
+    g_mutex_lock(dbt->mutex);
+    // The table might have changed since it was queued
+    if (is_table_ready(dbt)){
+      if (sorted_ingest != SORTED_INGEST_NONE){
+        job = take_next_job_in_key_order(dbt);
+      }else{
+        job = dbt->restore_job_list->data;
+        GList * current = dbt->restore_job_list;
+        dbt->restore_job_list = dbt->restore_job_list->next;
+        g_list_free_1(current);
+      }
+      if (dbt->start_data_time == NULL)
+        dbt->start_data_time=g_date_time_new_now_local();
+      dbt->restore_job_count--;
+      dbt->remaining_bytes-=job->data.drj->size;
+      dbt->current_threads++;
+      trace("%s.%s sending %s: %s, threads: %u, prohibiting finish", dbt->database->real_database, dbt->real_table,
+            rjtype2str(job->type), job->filename, dbt->current_threads);
+      schedule_read_ahead(dbt);
+    }
+    update_table_in_ready_queue(dbt);
+    g_mutex_unlock(dbt->mutex);
+  }
+  return job;
+}
+
+/* Called by the loader threads when a data job of the table has been completed */
+void data_job_finished(struct configuration *conf, struct db_table *dbt, guint range){
+  g_mutex_lock(dbt->mutex);
+  dbt->current_threads--;
+  key_range_job_finished(dbt, range);
+  trace("%s.%s: done job, threads %u", dbt->database->real_database, dbt->real_table, dbt->current_threads);
+  if (all_jobs_are_enqueued && dbt->schema_state == CREATED && dbt->restore_job_list == NULL && dbt->current_threads == 0 && g_atomic_int_get(&(dbt->remaining_jobs))==0){
+    dbt->schema_state = DATA_DONE;
+    dbt->finish_data_time=g_date_time_new_now_local();
+    if (enqueue_index_for_dbt_if_possible(conf,dbt))
+      trace("%s.%s queuing indexes", dbt->database->real_database, dbt->real_table);
+  }else
+    update_table_in_ready_queue(dbt);
+  g_mutex_unlock(dbt->mutex);
+}
+
+/*
+  Tables with jobs are taken from ready_table_queue. table_list is only scanned
+  when there is no job ready and we need to know if the tables are done, which
+  can only happen after all the jobs were enqueued, or when force_scan is used
+  to rebuild ready_table_queue.
+*/
+gboolean give_me_next_data_job_conf(struct configuration *conf, gboolean force_scan, struct restore_job ** rj){
   gboolean giveup = TRUE;
+  struct restore_job *job = give_me_next_ready_data_job();
+  if (job != NULL || (!all_jobs_are_enqueued && !force_scan)){
+    *rj = job;
+    return FALSE;
+  }
   g_mutex_lock(conf->table_list_mutex);
   GList * iter=conf->table_list;
-  struct restore_job *job = NULL;
-//  g_debug("Elements in table_list: %d",g_list_length(conf->table_list));
 //  We are going to check every table and see if there is any missing job
   struct db_table * dbt;
   while (iter != NULL){
@@ -220,7 +413,6 @@ gboolean give_me_next_data_job_conf(struct configuration *conf, struct restore_j
       trace("%s.%s: %s, voting for finish", dbt->database->real_database, dbt->real_table, status2str(dbt->schema_state));
       continue;
     }
-//    g_message("DB: %s Table: %s Schema State: %d remaining_jobs: %d", dbt->database->real_database,dbt->real_table, dbt->schema_state, dbt->remaining_jobs);
     if (dbt->schema_state >= DATA_DONE ||
         (dbt->schema_state == CREATED && (dbt->is_view || dbt->is_sequence))){
       trace("%s.%s done: %s, voting for finish", dbt->database->real_database, dbt->real_table, status2str(dbt->schema_state));
@@ -228,7 +420,6 @@ gboolean give_me_next_data_job_conf(struct configuration *conf, struct restore_j
       continue;
     }
     g_mutex_lock(dbt->mutex);
-    // I could do some job in here, do we have some for me?
     if (!resume && dbt->schema_state<CREATED ){
       giveup=FALSE;
       trace("%s.%s not yet created: %s, waiting", dbt->database->real_database, dbt->real_table, status2str(dbt->schema_state));
@@ -246,29 +437,16 @@ gboolean give_me_next_data_job_conf(struct configuration *conf, struct restore_j
       continue;
     }
 
-    if (dbt->schema_state == CREATED && g_list_length(dbt->restore_job_list) > 0){
-      if (dbt->current_threads >= dbt->max_threads ){
-        giveup=FALSE;
-        iter=iter->next;
-        g_mutex_unlock(dbt->mutex);
-        continue;
-      }
-      // We found a job that we can process!
-      job = dbt->restore_job_list->data;
-      GList * current = dbt->restore_job_list;
-      dbt->restore_job_list = dbt->restore_job_list->next;
-      g_list_free_1(current);
-      dbt->current_threads++;
-      g_mutex_unlock(dbt->mutex);
+    if (dbt->schema_state == CREATED && dbt->restore_job_list != NULL){
+      // Jobs are sent from ready_table_queue, we just make sure that the table is there
       giveup=FALSE;
-      trace("%s.%s sending %s: %s, threads: %u, prohibiting finish", dbt->database->real_database, dbt->real_table,
-            rjtype2str(job->type), job->filename, dbt->current_threads);
-      break;
+      update_table_in_ready_queue(dbt);
     }else{
 // AND CURRENT THREADS IS 0... if not we are seting DATA_DONE to unfinished tables
       trace("No remaining jobs on %s.%s", dbt->database->real_database, dbt->real_table); 
       if (all_jobs_are_enqueued && dbt->current_threads == 0 && (g_atomic_int_get(&(dbt->remaining_jobs))==0 )){
         dbt->schema_state = DATA_DONE;
+        dbt->finish_data_time=g_date_time_new_now_local();
         gboolean res= enqueue_index_for_dbt_if_possible(conf,dbt);
 //          create_index_job(conf, dbt, -1);
         if (res) {
@@ -284,7 +462,7 @@ gboolean give_me_next_data_job_conf(struct configuration *conf, struct restore_j
     iter=iter->next;
   }
   g_mutex_unlock(conf->table_list_mutex);
-  *rj = job;
+  *rj = give_me_next_ready_data_job();
   return giveup;
 }
 
@@ -362,7 +540,7 @@ void *control_job_thread(struct configuration *conf){
   guint threads_waiting = 0; //num_threads;
 //  GHashTableIter iter;
 //  gchar * lkey=NULL;
-  gboolean giveup;
+  gboolean giveup, force_scan;
 //  struct database * real_db_name = NULL;
 //  struct control_job *job = NULL;
   gboolean cont=TRUE;
@@ -377,8 +555,14 @@ void *control_job_thread(struct configuration *conf){
   trace("Thread control_job_thread started");
   while(cont){
     ft=(enum file_type)GPOINTER_TO_INT(g_async_queue_timeout_pop(refresh_db_queue,10000000));
-    if (ft==GPOINTER_TO_INT(NULL))
+    // On timeout, table_list is scanned for a parked loader in case that a change on a table was missed
+    force_scan=ft==GPOINTER_TO_INT(NULL);
+    if (force_scan){
+      if (threads_waiting == 0)
+        continue;
+      threads_waiting--;
       ft=THREAD;
+    }
     trace("refresh_db_queue -> %s (%u loaders waiting)", ft2str(ft), threads_waiting);
     switch (ft){
     case DATA:
@@ -386,7 +570,7 @@ void *control_job_thread(struct configuration *conf){
       break;
     case THREAD:
 //      g_message("Thread is asking for job");
-      giveup = give_me_next_data_job_conf(conf, &rj);
+      giveup = give_me_next_data_job_conf(conf, force_scan, &rj);
       if (rj != NULL){
         trace("job available in give_me_next_data_job_conf");
         trace("data_queue <- %s: %s", rjtype2str(rj->type), rj->dbt ? rj->dbt->table : rj->filename);
@@ -424,6 +608,7 @@ void *control_job_thread(struct configuration *conf){
       trace("Thread control_job_thread: received Default: %d", ft);
       break;
     }
+    g_atomic_int_set(&loaders_waiting, threads_waiting);
   }
   start_innodb_optimize_keys_all_tables();
   trace("Thread control_job_thread finished");
@@ -20,6 +20,9 @@
 
 #include "myloader.h"
 
+/* Bytes of a row when the size of the pending files of a table is unknown */
+#define DATA_COST_BYTES_PER_ROW 100
+
 enum control_job_type { JOB_RESTORE, JOB_WAIT, JOB_SHUTDOWN };
 static inline const char *jtype2str(enum control_job_type jtype)
 {
@@ -53,4 +56,6 @@ void cjt_resume();
 void initialize_control_job (struct configuration *conf);
 void wait_control_job();
 void maybe_shutdown_control_job();
+void update_table_in_ready_queue(struct db_table *dbt);
+void data_job_finished(struct configuration *conf, struct db_table *dbt, guint range);
 #endif
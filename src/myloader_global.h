@@ -41,8 +41,17 @@ enum checksum_modes {
   CHECKSUM_FAIL
 };
 
+enum sorted_ingest_mode {
+  SORTED_INGEST_NONE= 0,
+  SORTED_INGEST_RANGES,
+  SORTED_INGEST_SERIAL
+};
+
 extern gboolean disable_redo_log;
 extern enum checksum_modes checksum_mode;
+extern enum sorted_ingest_mode sorted_ingest;
+extern gchar *sorted_ingest_str;
+extern gboolean ingest_report;
 extern gchar *purge_mode_str;
 extern GString *set_global;
 extern GString *set_global_back;
@@ -92,9 +101,22 @@ extern guint commit_count;
 extern guint errors;
 extern guint max_errors;
 extern guint max_threads_for_index_creation;
+extern guint index_build_budget;
 extern guint max_threads_for_post_creation;
 extern guint max_threads_for_schema_creation;
+extern guint schema_batch_size;
+extern guint split_large_files;
 extern guint max_threads_per_table;
+extern guint read_ahead_threads;
+extern guint read_ahead_files;
+extern guint read_ahead_buffer;
+extern guint memory_budget;
+extern gboolean balance_threads_per_table;
+extern gboolean adaptive_connections;
+extern guint adaptive_connections_interval;
+extern guint adaptive_connections_min;
+extern guint adaptive_connections_max_threads_running;
+extern guint adaptive_connections_max_history_length;
 extern guint retry_count;
 extern guint num_threads;
 extern guint rows;
@@ -119,6 +141,7 @@ extern struct database *database_db;
 extern gchar *innodb_optimize_keys_str;
 extern gchar *checksum_str;
 extern gboolean no_stream;
+extern gboolean null_target;
 extern gchar *ignore_errors;
 extern gboolean kill_at_once;
 extern struct configuration_per_table conf_per_table;
@@ -24,6 +24,7 @@
 #include "myloader_intermediate_queue.h"
 #include "myloader_restore.h"
 #include "myloader_global.h"
+#include "myloader_memory.h"
 //GAsyncQueue * schema_counter=NULL;
 guint schema_counter = 0;
 gboolean intermediate_queue_ended = FALSE;
@@ -168,10 +169,14 @@ enum file_type process_filename(char *filename){
       break;
     case DATA:
       if (!no_data){
-        if (!process_data_filename(filename))
+        if (!process_data_filename(filename)){
+          memory_release_stream_file(filename);
           return DO_NOT_ENQUEUE;
-      }else
+        }
+      }else{
         m_remove(directory,filename);
+        memory_release_stream_file(filename);
+      }
       total_data_sql_files++;
       break;
     case RESUME:
@@ -184,6 +189,7 @@ enum file_type process_filename(char *filename){
       break;
     case LOAD_DATA:
         release_load_data_as_it_is_close(filename);
+        process_load_data_filename(filename);
       break;
     case SHUTDOWN:
       break;
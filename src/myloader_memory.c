@@ -0,0 +1,143 @@
+/*
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+        Authors:    David Ducos, Percona (david dot ducos at percona dot com)
+*/
+#include <glib.h>
+#include "common.h"
+#include "myloader_global.h"
+#include "myloader_memory.h"
+
+/*
+  Global memory budget.
+
+  The producers account the bytes that they keep waiting for a consumer:
+  the statements sent to the restore threads, the statements buffered by the
+  read-ahead threads and the data files received by the stream thread that are
+  not restored yet. When --memory-budget is exceeded, memory_acquire() blocks
+  the producer until a consumer releases memory, and a reader that is blocked
+  also stops its decompressor as the pipe is not read.
+
+  A component that has nothing accounted is always allowed to get memory, even
+  over the budget, as the memory of the other components is released only if
+  this one makes progress: the read-ahead files are consumed by loader threads
+  that need to send statements, and the stream files need to be restored.
+
+  The stream files are accounted without waiting, as a loader may be waiting
+  for a .dat or .ibd file to finish its LOAD DATA. The stream waits with
+  memory_wait() before it starts to read the next .sql data file instead.
+*/
+
+guint memory_budget = 0;
+
+static GMutex *memory_mutex = NULL;
+static GCond *memory_cond = NULL;
+static guint64 memory_used = 0;
+static guint64 component_used[MEMORY_COMPONENTS] = { 0 };
+static guint64 component_waits[MEMORY_COMPONENTS] = { 0 };
+static GHashTable *stream_files = NULL;
+static const gchar *component_names[MEMORY_COMPONENTS] = { "statements", "read_ahead", "stream" };
+
+void initialize_memory_budget(){
+  memory_mutex=g_mutex_new();
+  memory_cond=g_cond_new();
+  stream_files=g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+  if (memory_budget > 0)
+    g_message("Using a memory budget of %u MB", memory_budget);
+}
+
+/* memory_mutex must be locked */
+static
+void wait_for_memory(enum memory_component component, guint64 bytes){
+  guint64 budget=(guint64)memory_budget * 1024 * 1024;
+  gboolean waited=FALSE;
+  while (budget > 0 && component_used[component] > 0 && memory_used + bytes > budget){
+    if (!waited){
+      waited=TRUE;
+      component_waits[component]++;
+      trace("Memory budget exhausted, %s waiting for %"G_GUINT64_FORMAT" bytes", component_names[component], bytes);
+    }
+    g_cond_wait(memory_cond, memory_mutex);
+  }
+}
+
+void memory_acquire(enum memory_component component, guint64 bytes, gboolean force){
+  if (memory_mutex == NULL)
+    return;
+  g_mutex_lock(memory_mutex);
+  if (!force)
+    wait_for_memory(component, bytes);
+  memory_used+=bytes;
+  component_used[component]+=bytes;
+  g_mutex_unlock(memory_mutex);
+}
+
+/* Waits until the bytes fit in the budget, without accounting them */
+void memory_wait(enum memory_component component, guint64 bytes){
+  if (memory_mutex == NULL)
+    return;
+  g_mutex_lock(memory_mutex);
+  wait_for_memory(component, bytes);
+  g_mutex_unlock(memory_mutex);
+}
+
+void memory_release(enum memory_component component, guint64 bytes){
+  if (memory_mutex == NULL || bytes == 0)
+    return;
+  g_mutex_lock(memory_mutex);
+  memory_used-=bytes;
+  component_used[component]-=bytes;
+  g_cond_broadcast(memory_cond);
+  g_mutex_unlock(memory_mutex);
+}
+
+/* The stream files are released by name, when they are restored or discarded */
+void memory_acquire_stream_file(const gchar *filename, guint64 bytes){
+  if (memory_mutex == NULL)
+    return;
+  guint64 *size=g_new(guint64, 1);
+  *size=bytes;
+  memory_acquire(MEMORY_STREAM, bytes, TRUE);
+  g_mutex_lock(memory_mutex);
+  g_hash_table_insert(stream_files, g_strdup(filename), size);
+  g_mutex_unlock(memory_mutex);
+}
+
+void memory_release_stream_file(const gchar *filename){
+  guint64 *size=NULL, bytes=0;
+  if (memory_mutex == NULL || !stream)
+    return;
+  g_mutex_lock(memory_mutex);
+  size=g_hash_table_lookup(stream_files, filename);
+  if (size != NULL){
+    bytes=*size;
+    g_hash_table_remove(stream_files, filename);
+  }
+  g_mutex_unlock(memory_mutex);
+  memory_release(MEMORY_STREAM, bytes);
+}
+
+void append_memory_pmm_entries(GString *content){
+  guint i;
+  if (memory_mutex == NULL)
+    return;
+  g_mutex_lock(memory_mutex);
+  g_string_append_printf(content,"myloader_memory{name=\"budget\"} %"G_GUINT64_FORMAT"\n", (guint64)memory_budget * 1024 * 1024);
+  g_string_append_printf(content,"myloader_memory{name=\"used\"} %"G_GUINT64_FORMAT"\n", memory_used);
+  for (i=0; i < MEMORY_COMPONENTS; i++){
+    g_string_append_printf(content,"myloader_memory{name=\"%s\"} %"G_GUINT64_FORMAT"\n", component_names[i], component_used[i]);
+    g_string_append_printf(content,"myloader_memory_waits{name=\"%s\"} %"G_GUINT64_FORMAT"\n", component_names[i], component_waits[i]);
+  }
+  g_mutex_unlock(memory_mutex);
+}
@@ -0,0 +1,35 @@
+/*
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+        Authors:    David Ducos, Percona (david dot ducos at percona dot com)
+*/
+#ifndef _src_myloader_memory_h
+#define _src_myloader_memory_h
+#include <glib.h>
+
+enum memory_component {
+  MEMORY_STATEMENTS= 0,
+  MEMORY_READ_AHEAD,
+  MEMORY_STREAM,
+  MEMORY_COMPONENTS
+};
+
+void initialize_memory_budget();
+void memory_acquire(enum memory_component component, guint64 bytes, gboolean force);
+void memory_release(enum memory_component component, guint64 bytes);
+void memory_wait(enum memory_component component, guint64 bytes);
+void memory_acquire_stream_file(const gchar *filename, guint64 bytes);
+void memory_release_stream_file(const gchar *filename);
+void append_memory_pmm_entries(GString *content);
+#endif
@@ -25,6 +25,10 @@
 #include <mysql.h>
 #include "myloader.h"
 #include "myloader_global.h"
+#include "myloader_concurrency.h"
+#include "myloader_memory.h"
+#include "myloader_pmm_thread.h"
+#include "metrics.h"
 
 gint kill_pmm = 0;
 
@@ -38,20 +42,23 @@ void append_pmm_entry(GString *content, const gchar *key, GAsyncQueue * queue){
 }
 
 void append_pmm_entry_tables(GString *content,struct configuration *conf){
-  (void) content;
   GHashTableIter iter;
   gchar * lkey;
-  if (conf->table_hash){
+  if (conf->table_hash && conf->table_hash_mutex && metrics_enabled){
+    g_mutex_lock(conf->table_hash_mutex);
     g_hash_table_iter_init ( &iter, conf->table_hash );
     struct db_table *dbt=NULL;
     while ( g_hash_table_iter_next ( &iter, (gpointer *) &lkey, (gpointer *) &dbt ) ) {
 //      g_string_append_printf(content,"myloader_table{name=\"%s\"} %d\n",lkey,stream?(guint)g_list_length(dbt->restore_job_list):(guint)g_async_queue_length(dbt->queue));
+      append_metrics_table(content, "myloader", dbt->database->real_database, dbt->real_table, &(dbt->metrics));
     }
+    g_mutex_unlock(conf->table_hash_mutex);
   }
 }
 
-void write_pmm_entries(const gchar* filename, GString *content, struct configuration* conf){
-  g_string_set_size(content,0);
+/* Used by the PMM thread and by the metrics endpoint */
+void fill_pmm_entries(GString *content, gpointer data){
+  struct configuration* conf=data;
   append_pmm_entry(content,"database_queue",    conf->database_queue);
   append_pmm_entry(content,"table_queue",       conf->table_queue);
   append_pmm_entry(content,"retry_queue",       conf->retry_queue);
@@ -63,6 +70,18 @@ void write_pmm_entries(const gchar* filename, GString *content, struct configura
   append_pmm_entry(content,"stream_queue",      conf->stream_queue);
   append_pmm_entry(content,"ready",             conf->ready);
   append_pmm_entry_tables(content,conf);
+  append_concurrency_pmm_entries(content);
+  append_memory_pmm_entries(content);
+  if (metrics_enabled){
+    append_metrics_threads(content, "myloader");
+    append_metrics_histogram(content, "myloader", METRICS_STATEMENT);
+    append_metrics_histogram(content, "myloader", METRICS_QUEUE_WAIT);
+  }
+}
+
+void write_pmm_entries(const gchar* filename, GString *content, struct configuration* conf){
+  g_string_set_size(content,0);
+  fill_pmm_entries(content, conf);
   g_file_set_contents( filename , content->str, content->len, NULL);
 }
 
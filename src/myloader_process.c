@@ -28,13 +28,16 @@
 //#include "myloader_jobs_manager.h"
 #include "myloader_control_job.h"
 #include "myloader_restore_job.h"
+#include "myloader_memory.h"
 #include "myloader_global.h"
+#include "table_history.h"
 #include <sys/wait.h>
 #include <sys/stat.h>
 
 
 GString *change_master_statement=NULL;
 gboolean append_if_not_exist=FALSE;
+guint split_large_files=0;
 GHashTable *fifo_hash=NULL;
 GMutex *fifo_table_mutex=NULL;
 
@@ -71,6 +74,17 @@ struct db_table* append_new_db_table( struct database *real_db_name, gchar *tabl
       dbt->real_table=dbt->table;
       dbt->rows=number_rows;
       dbt->restore_job_list = NULL;
+      dbt->restore_job_count = 0;
+      dbt->remaining_bytes = 0;
+      dbt->data_bytes = 0;
+      dbt->ready_key = 0;
+      dbt->accounted_cost = 0;
+      dbt->cost_factor = get_history_cost_factor(get_table_history(real_db_name->name, table));
+      dbt->accounted_with_jobs = FALSE;
+      dbt->ready_iter = NULL;
+      dbt->key_ranges = 0;
+      dbt->key_range_next = NULL;
+      dbt->key_range_busy = NULL;
 //      dbt->queue=g_async_queue_new();
       parse_object_to_export(&(dbt->object_to_export),g_hash_table_lookup(conf_per_table.all_object_to_export, lkey));
 			dbt->current_threads=0;
@@ -97,6 +111,9 @@ struct db_table* append_new_db_table( struct database *real_db_name, gchar *tabl
       dbt->triggers_checksum=NULL;
       dbt->indexes_checksum=NULL;
       dbt->data_checksum=NULL;
+      dbt->metrics.rows=0;
+      dbt->metrics.bytes=0;
+      dbt->metrics.usec=0;
       dbt->is_view=FALSE;
       dbt->is_sequence=FALSE;
     }else{
@@ -124,6 +141,8 @@ void free_dbt(struct db_table * dbt){
   g_free(dbt->table);
 //  if (dbt->constraints!=NULL) g_string_free(dbt->constraints,TRUE);
   dbt->constraints = NULL; // It should be free after constraint is executed
+  g_free(dbt->key_range_next);
+  g_free(dbt->key_range_busy);
 //  g_async_queue_unref(dbt->queue);
   g_mutex_clear(dbt->mutex); 
   
@@ -717,7 +736,24 @@ gint cmp_restore_job(gconstpointer rj1, gconstpointer rj2){
     }
     return a%2 > b%2;
   }
-  return ((struct restore_job *)rj1)->data.drj->sub_part > ((struct restore_job *)rj2)->data.drj->sub_part;
+  if (((struct restore_job *)rj1)->data.drj->sub_part != ((struct restore_job *)rj2)->data.drj->sub_part )
+    return ((struct restore_job *)rj1)->data.drj->sub_part > ((struct restore_job *)rj2)->data.drj->sub_part;
+  return ((struct restore_job *)rj1)->data.drj->start > ((struct restore_job *)rj2)->data.drj->start;
+}
+
+/*
+  A big uncompressed data file, usually from a table that was not chunked, is
+  split in pieces of --split-large-files MB. Each piece is a data job with the
+  byte range of the file that it needs to restore, see
+  restore_data_from_file_range(). Compressed files can not be split as they
+  can only be read from the beginning.
+*/
+static
+guint get_amount_of_pieces(const gchar *filename, guint64 size){
+  guint64 piece_size=(guint64)split_large_files * 1024 * 1024;
+  if (piece_size == 0 || stream || size <= piece_size || !g_str_has_suffix(filename, ".sql"))
+    return 1;
+  return (guint)((size + piece_size - 1) / piece_size);
 }
 
 gboolean process_data_filename(char * filename){
@@ -738,19 +774,71 @@ gboolean process_data_filename(char * filename){
 
   struct db_table *dbt=append_new_db_table(real_db_name, table_name,0,NULL);
 	if (!dbt->object_to_export.no_data){
-    struct restore_job *rj = new_data_restore_job( g_strdup(filename), JOB_RESTORE_FILENAME, dbt, part, sub_part);
+    struct stat st;
+    gchar *path = g_build_filename(directory, filename, NULL);
+    guint64 size = g_stat(path, &st) == 0 ? (guint64)st.st_size : 0;
+    g_free(path);
+    guint pieces=get_amount_of_pieces(filename, size), i;
+    guint64 piece_size=(size + pieces - 1) / pieces;
+    guint64 start=0, end=0;
+    struct restore_job *rj = NULL;
+    if (pieces > 1){
+      message("Splitting %s in %u pieces of %"G_GUINT64_FORMAT" bytes", filename, pieces, piece_size);
+      total_data_sql_files+=pieces - 1;
+    }
     g_mutex_lock(dbt->mutex);
-    g_atomic_int_add(&(dbt->remaining_jobs), 1);
-    dbt->count++; 
-    dbt->restore_job_list=g_list_insert_sorted(dbt->restore_job_list,rj,&cmp_restore_job);
+    for (i=0; i < pieces; i++){
+      if (pieces > 1){
+        start=i * piece_size;
+        end=i + 1 < pieces ? start + piece_size : size;
+      }
+      rj = new_data_restore_job( g_strdup(filename), JOB_RESTORE_FILENAME, dbt, part, sub_part, pieces > 1 ? end - start : size);
+      rj->data.drj->start=start;
+      rj->data.drj->end=end;
+      g_atomic_int_add(&(dbt->remaining_jobs), 1);
+      dbt->count++;
+      dbt->restore_job_list=g_list_insert_sorted(dbt->restore_job_list,rj,&cmp_restore_job);
+      dbt->restore_job_count++;
+    }
+    dbt->remaining_bytes+=size;
+    dbt->data_bytes+=size;
+    update_table_in_ready_queue(dbt);
 //  dbt->restore_job_list=g_list_append(dbt->restore_job_list,rj);
     g_mutex_unlock(dbt->mutex);
 	}else{
     g_warning("Ignoring file %s on `%s`.`%s`",filename, dbt->database->name, dbt->table);
+    // There is no job to release it
+    m_remove(directory, filename);
+    memory_release_stream_file(filename);
 	}
   return TRUE;
 }
 
+/*
+  A .dat, .ibd or .cfg file is only read by the LOAD DATA or IMPORT statement
+  in the data file of its table. When that data file is not going to be
+  restored nothing reads it, so it is removed and its stream memory released.
+*/
+void process_load_data_filename(char * filename){
+  gchar *db_name=NULL, *table_name=NULL;
+  guint part=0,sub_part=0;
+  gboolean restored=TRUE;
+  get_database_table_part_name_from_filename(filename,&db_name,&table_name,&part,&sub_part);
+  if (db_name == NULL || table_name == NULL)
+    return;
+  struct database *real_db_name=get_db_hash(db_name,db_name);
+  if (no_data || !eval_table(real_db_name->name, table_name, conf->table_list_mutex) ||
+      (source_db && g_strcmp0(real_db_name->name, source_db)))
+    restored=FALSE;
+  else
+    restored=!append_new_db_table(real_db_name, table_name, 0, NULL)->object_to_export.no_data;
+  if (!restored){
+    trace("%s is not going to be loaded", filename);
+    m_remove(directory, filename);
+    memory_release_stream_file(filename);
+  }
+}
+
 gboolean process_checksum_filename(char * filename){
   gchar *db_name, *table_name;
   // TODO: check if it is a data file
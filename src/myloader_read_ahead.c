@@ -0,0 +1,245 @@
+/*
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+        Authors:    David Ducos, Percona (david dot ducos at percona dot com)
+*/
+#include <glib.h>
+#include <stdio.h>
+#include <errno.h>
+#include <string.h>
+#include "common.h"
+#include "myloader.h"
+#include "myloader_global.h"
+#include "myloader_process.h"
+#include "myloader_restore_job.h"
+#include "myloader_read_ahead.h"
+#include "myloader_memory.h"
+
+/*
+  Read-ahead stage: when a data job is sent to a loader thread, the next
+  --read-ahead-files jobs of the same table are queued to be opened (which
+  starts the decompression) and split into statements by the read-ahead
+  threads. The loader thread that gets one of those jobs sends the statements
+  that are already in memory instead of reading the file. The statements kept
+  in memory are limited by --read-ahead-buffer.
+*/
+
+guint read_ahead_threads = 0;
+guint read_ahead_files = 2;
+guint read_ahead_buffer = 256;
+
+static GThread **read_ahead_t = NULL;
+static GAsyncQueue *read_ahead_queue = NULL;
+static GMutex *read_ahead_mutex = NULL;
+static GCond *read_ahead_cond = NULL;
+static guint64 read_ahead_buffered = 0;
+static struct read_ahead_file end_read_ahead_thread = { NULL, READ_AHEAD_DONE, TRUE, FALSE, 0, NULL };
+
+void *read_ahead_thread(gpointer data);
+
+void initialize_read_ahead(){
+  guint n=0;
+  if (read_ahead_threads == 0)
+    return;
+  read_ahead_queue=g_async_queue_new();
+  read_ahead_mutex=g_mutex_new();
+  read_ahead_cond=g_cond_new();
+  read_ahead_t=g_new(GThread *, read_ahead_threads);
+  for (n=0; n < read_ahead_threads; n++)
+    read_ahead_t[n]=g_thread_new("myloader_read_ahead", (GThreadFunc)read_ahead_thread, GINT_TO_POINTER(n + 1));
+}
+
+void wait_read_ahead_to_finish(){
+  guint n=0;
+  if (read_ahead_threads == 0)
+    return;
+  for (n=0; n < read_ahead_threads; n++)
+    g_async_queue_push(read_ahead_queue, &end_read_ahead_thread);
+  for (n=0; n < read_ahead_threads; n++)
+    g_thread_join(read_ahead_t[n]);
+  g_free(read_ahead_t);
+}
+
+static
+void schedule_read_ahead_from(GList *iter, guint range){
+  guint i=0;
+  struct restore_job *rj=NULL;
+  for (i=0; iter != NULL && i < read_ahead_files; i++, iter=iter->next){
+    rj=iter->data;
+    if (range != G_MAXUINT && rj->data.drj->range != range)
+      break;
+    // The pieces of a split file are read by the loader threads
+    if (rj->type != JOB_RESTORE_FILENAME || rj->read_ahead != NULL || rj->data.drj->end > 0)
+      continue;
+    struct read_ahead_file *raf=g_new0(struct read_ahead_file, 1);
+    raf->filename=rj->filename;
+    raf->state=READ_AHEAD_QUEUED;
+    raf->statements=g_queue_new();
+    rj->read_ahead=raf;
+    trace("read_ahead_queue <- %s", rj->filename);
+    g_async_queue_push(read_ahead_queue, raf);
+  }
+}
+
+/* It must be called with dbt->mutex locked */
+void schedule_read_ahead(struct db_table *dbt){
+  if (read_ahead_threads == 0)
+    return;
+  guint i;
+  if (dbt->key_ranges == 0){
+    schedule_read_ahead_from(dbt->restore_job_list, G_MAXUINT);
+    return;
+  }
+  // With --sorted-ingest, the next files are the next ones of each key range
+  for (i=0; i < dbt->key_ranges; i++)
+    schedule_read_ahead_from(dbt->key_range_next[i], i);
+}
+
+void free_read_ahead_file(struct read_ahead_file *raf){
+  struct read_ahead_statement *st=NULL;
+  g_mutex_lock(read_ahead_mutex);
+  while ((st=g_queue_pop_head(raf->statements)) != NULL){
+    read_ahead_buffered-=st->data->len;
+    memory_release(MEMORY_READ_AHEAD, st->data->len);
+    g_string_free(st->data, TRUE);
+    g_free(st);
+  }
+  g_cond_broadcast(read_ahead_cond);
+  g_mutex_unlock(read_ahead_mutex);
+  g_queue_free(raf->statements);
+  g_free(raf);
+}
+
+/*
+  Called by the loader thread before restoring the file. If the read-ahead
+  has not started yet, the loader thread reads the file by itself and the
+  read-ahead thread discards it.
+*/
+struct read_ahead_file *claim_read_ahead(struct restore_job *rj){
+  struct read_ahead_file *raf=NULL;
+  if (read_ahead_threads == 0 || rj->read_ahead == NULL)
+    return NULL;
+  g_mutex_lock(read_ahead_mutex);
+  raf=rj->read_ahead;
+  rj->read_ahead=NULL;
+  raf->claimed=TRUE;
+  if (raf->state == READ_AHEAD_QUEUED)
+    raf=NULL;
+  g_mutex_unlock(read_ahead_mutex);
+  return raf;
+}
+
+static void push_read_ahead_statement(struct read_ahead_file *raf, GString *data, guint line){
+  struct read_ahead_statement *st=g_new(struct read_ahead_statement, 1);
+  st->data=data;
+  st->line=line;
+  g_mutex_lock(read_ahead_mutex);
+  gboolean first=g_queue_is_empty(raf->statements);
+  g_mutex_unlock(read_ahead_mutex);
+  memory_acquire(MEMORY_READ_AHEAD, data->len, first);
+  g_mutex_lock(read_ahead_mutex);
+  // At least one statement per file is allowed, so the loader thread of this file is never blocked
+  while (read_ahead_buffered > (guint64)read_ahead_buffer * 1024 * 1024 && !g_queue_is_empty(raf->statements))
+    g_cond_wait(read_ahead_cond, read_ahead_mutex);
+  g_queue_push_tail(raf->statements, st);
+  read_ahead_buffered+=data->len;
+  g_cond_broadcast(read_ahead_cond);
+  g_mutex_unlock(read_ahead_mutex);
+}
+
+static void read_ahead_file(struct read_ahead_file *raf){
+  gboolean eof=FALSE;
+  guint line=0;
+  GString *data=g_string_sized_new(256);
+  gchar *path=g_build_filename(directory, raf->filename, NULL);
+  FILE *infile=myl_open(path, "r");
+  gboolean error=infile == NULL;
+  gint error_number=errno;
+  while (!error && !eof){
+    if (read_data(infile, data, &eof, &line)){
+      if (g_strrstr(&data->str[data->len >= 5 ? data->len - 5 : 0], ";\n")) {
+        push_read_ahead_statement(raf, data, line);
+        data=g_string_sized_new(256);
+      }
+    }else{
+      error=TRUE;
+      error_number=errno;
+    }
+  }
+  g_string_free(data, TRUE);
+  // The file is removed by the loader thread once it is restored
+  if (infile != NULL)
+    myl_close(raf->filename, infile, FALSE);
+  g_free(path);
+  g_mutex_lock(read_ahead_mutex);
+  raf->error=error;
+  raf->error_number=error_number;
+  raf->state=READ_AHEAD_DONE;
+  g_cond_broadcast(read_ahead_cond);
+  g_mutex_unlock(read_ahead_mutex);
+}
+
+void *read_ahead_thread(gpointer data){
+  struct read_ahead_file *raf=NULL;
+  set_thread_name("R%02u", GPOINTER_TO_INT(data));
+  trace("Thread read_ahead_thread started");
+  while (TRUE){
+    raf=g_async_queue_pop(read_ahead_queue);
+    if (raf == &end_read_ahead_thread)
+      break;
+    g_mutex_lock(read_ahead_mutex);
+    if (raf->claimed){
+      // The loader thread is already reading this file
+      g_mutex_unlock(read_ahead_mutex);
+      g_queue_free(raf->statements);
+      g_free(raf);
+      continue;
+    }
+    raf->state=READ_AHEAD_READING;
+    g_mutex_unlock(read_ahead_mutex);
+    trace("read_ahead_queue -> %s", raf->filename);
+    read_ahead_file(raf);
+  }
+  trace("Thread read_ahead_thread finished");
+  return NULL;
+}
+
+/* Same as read_data() but it returns the next statement that was read by the read-ahead thread */
+gboolean read_ahead_data(struct read_ahead_file *raf, GString *data, gboolean *eof, guint *line){
+  struct read_ahead_statement *st=NULL;
+  g_mutex_lock(read_ahead_mutex);
+  while (g_queue_is_empty(raf->statements) && raf->state != READ_AHEAD_DONE)
+    g_cond_wait(read_ahead_cond, read_ahead_mutex);
+  st=g_queue_pop_head(raf->statements);
+  if (st != NULL){
+    read_ahead_buffered-=st->data->len;
+    g_cond_broadcast(read_ahead_cond);
+  }
+  g_mutex_unlock(read_ahead_mutex);
+  if (st != NULL){
+    memory_release(MEMORY_READ_AHEAD, st->data->len);
+    g_string_append_len(data, st->data->str, st->data->len);
+    *line=st->line;
+    g_string_free(st->data, TRUE);
+    g_free(st);
+    *eof=FALSE;
+    return TRUE;
+  }
+  *eof=TRUE;
+  if (raf->error){
+    errno=raf->error_number;
+    return FALSE;
+  }
+  return TRUE;
+}
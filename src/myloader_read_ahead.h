@@ -0,0 +1,45 @@
+/*
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+        Authors:    David Ducos, Percona (david dot ducos at percona dot com)
+*/
+#ifndef _src_myloader_read_ahead_h
+#define _src_myloader_read_ahead_h
+#include <glib.h>
+#include <stdio.h>
+#include "myloader_restore_job.h"
+
+enum read_ahead_state { READ_AHEAD_QUEUED, READ_AHEAD_READING, READ_AHEAD_DONE };
+
+struct read_ahead_statement {
+  GString *data;
+  guint line;
+};
+
+struct read_ahead_file {
+  gchar *filename;
+  enum read_ahead_state state;
+  gboolean claimed;
+  gboolean error;
+  gint error_number;
+  GQueue *statements;
+};
+
+void initialize_read_ahead();
+void wait_read_ahead_to_finish();
+void schedule_read_ahead(struct db_table *dbt);
+struct read_ahead_file *claim_read_ahead(struct restore_job *rj);
+gboolean read_ahead_data(struct read_ahead_file *raf, GString *data, gboolean *eof, guint *line);
+void free_read_ahead_file(struct read_ahead_file *raf);
+#endif
@@ -20,9 +20,11 @@
 #include <glib/gstdio.h>
 #include <stdio.h>
 #include <string.h>
+#include <sys/wait.h>
 #include "common.h"
 #include <errno.h>
 #include "myloader.h"
+#include "trace_file.h"
 //#include "myloader_jobs_manager.h"
 #include "myloader_common.h"
 #include "myloader_global.h"
@@ -30,15 +32,20 @@
 #include "myloader_intermediate_queue.h"
 #include "myloader_process.h"
 #include "myloader_restore.h"
+#include "myloader_concurrency.h"
+#include "myloader_read_ahead.h"
+#include "myloader_memory.h"
+#include "tracepoints.h"
 
 struct statement * new_statement();
 gboolean skip_definer = FALSE;
+gboolean null_target = FALSE;
 GAsyncQueue *connection_pool = NULL;
 GAsyncQueue *restore_queues=NULL;
 GAsyncQueue *free_results_queue=NULL;
 
 void *restore_thread(MYSQL *thrconn);
-struct statement release_connection_statement = {0, 0, NULL, NULL, CLOSE, FALSE, NULL, 0};
+struct statement release_connection_statement = {0, 0, NULL, NULL, CLOSE, FALSE, NULL, 0, 0, 0, NULL};
 struct io_restore_result end_restore_thread = { NULL, NULL};
 
 GThread **restore_threads=NULL;
@@ -76,6 +83,9 @@ struct io_restore_result *new_io_restore_result(){
 
 gchar *ignore_errors=NULL;
 
+static GMutex *datadir_mutex = NULL;
+static gchar *server_datadir = NULL;
+
 void initialize_connection_pool(MYSQL *thrconn){
   guint n=0;
   if (ignore_errors){
@@ -86,6 +96,7 @@ void initialize_connection_pool(MYSQL *thrconn){
     }
   }
   connection_pool=g_async_queue_new();
+  datadir_mutex=g_mutex_new();
   restore_queues=g_async_queue_new();
   free_results_queue=g_async_queue_new();
   struct io_restore_result *iors=NULL;
@@ -118,7 +129,20 @@ void reconnect_connection_data(struct connection_data *cd){
 
 int restore_data_in_gstring_by_statement(struct connection_data *cd, GString *data, gboolean is_schema, guint *query_counter)
 {
+  // --null-target: the data statements were read, parsed and split, but they are not sent
+  if (null_target && !is_schema){
+    *query_counter=*query_counter+1;
+    g_string_set_size(data, 0);
+    return 0;
+  }
+  gint64 start_time=adaptive_connections||metrics_enabled?g_get_monotonic_time():0;
+  enum thread_state previous_state=metrics_thread_state(THREAD_STATE_SERVER);
   guint en=mysql_real_query(cd->thrconn, data->str, data->len);
+  metrics_thread_state(previous_state);
+  if (adaptive_connections)
+    concurrency_account_query(g_get_monotonic_time() - start_time);
+  if (metrics_enabled)
+    metrics_observe(METRICS_STATEMENT, g_get_monotonic_time() - start_time);
   if (en) {
     if (is_schema)
       g_warning("Connection %ld - ERROR %d: %s\n%s", cd->thread_id, mysql_errno(cd->thrconn), mysql_error(cd->thrconn), data->str);
@@ -153,6 +177,39 @@ int restore_data_in_gstring_by_statement(struct connection_data *cd, GString *da
   return 0;
 }
 
+/* Sends all the statements of a schema batch in one round trip. ir->executed
+   is the amount of statements that succeeded, as the server stops at the
+   first error */
+int restore_schema_batch_by_statement(struct connection_data *cd, struct statement *ir){
+  MYSQL_RES *res=NULL;
+  int status=0;
+  ir->executed=0;
+  if (mysql_set_server_option(cd->thrconn, MYSQL_OPTION_MULTI_STATEMENTS_ON)){
+    ir->error=g_strdup(mysql_error(cd->thrconn));
+    ir->error_number=mysql_errno(cd->thrconn);
+    return 1;
+  }
+  gint64 start_time=adaptive_connections?g_get_monotonic_time():0;
+  status=mysql_real_query(cd->thrconn, ir->buffer->str, ir->buffer->len);
+  while (status == 0){
+    ir->executed++;
+    res=mysql_store_result(cd->thrconn);
+    if (res)
+      mysql_free_result(res);
+    status=mysql_next_result(cd->thrconn);
+  }
+  if (adaptive_connections)
+    concurrency_account_query(g_get_monotonic_time() - start_time);
+  if (status > 0){
+    ir->error=g_strdup(mysql_error(cd->thrconn));
+    ir->error_number=mysql_errno(cd->thrconn);
+  }
+  mysql_set_server_option(cd->thrconn, MYSQL_OPTION_MULTI_STATEMENTS_OFF);
+  if (status > 0 && mysql_ping(cd->thrconn))
+    reconnect_connection_data(cd);
+  return status > 0 ? 1 : 0;
+}
+
 struct connection_data *close_restore_thread(gboolean return_connection){
   struct connection_data *cd=g_async_queue_pop(connection_pool);
   g_async_queue_push(cd->ready, &end_restore_thread);
@@ -179,7 +236,7 @@ void setup_connection(struct connection_data *cd, struct thread_data *td, struct
     */
     g_warning("Thread %d: New connection %ld established", td->thread_id, cd->thread_id);
   }
-  cd->transaction=start_transaction;
+  cd->transaction=start_transaction && !null_target;
   if (use_database)
     execute_use_if_needs_to(cd, use_database, "request_another_connection");
   if (td){
@@ -196,14 +253,16 @@ void setup_connection(struct connection_data *cd, struct thread_data *td, struct
 }
 
 struct connection_data *wait_for_available_restore_thread(struct thread_data *td, gboolean start_transaction, struct database *use_database){
+  enum thread_state previous_state=metrics_thread_state(THREAD_STATE_QUEUE);
   struct connection_data *cd=g_async_queue_pop(connection_pool);
+  metrics_thread_state(previous_state);
   setup_connection(cd,td,g_async_queue_pop(restore_queues), start_transaction, use_database, NULL);
   return cd;
 }
 
 extern gboolean control_job_ended;
 gboolean request_another_connection(struct thread_data *td, struct io_restore_result *io_restore_result, gboolean start_transaction, struct database *use_database, GString *header){
-  if ( control_job_ended && td->granted_connections < td->dbt->max_threads && g_list_length(td->dbt->restore_job_list)==0 ){
+  if ( control_job_ended && td->granted_connections < td->dbt->max_threads && td->dbt->restore_job_count==0 ){
     g_assert(header);
     struct connection_data *cd=g_async_queue_try_pop(connection_pool);
     if(cd){
@@ -231,8 +290,12 @@ int m_commit_and_start_transaction(struct connection_data *cd, guint* query_coun
   return 0;
 }
 
-int restore_insert(struct connection_data *cd,
-                  GString *data, guint *query_counter, guint offset_line)
+/*
+  Splits the extended INSERT in data into statements of max_rows rows, the
+  rows are the lines after VALUES. execute is called for every statement with
+  the amount of rows and the lines of the file where they come from.
+*/
+int split_insert(GString *data, guint offset_line, guint max_rows, int execute(GString *statement, guint statement_rows, guint from_line, guint to_line, gpointer user_data), gpointer user_data)
 {
   char *next_line=g_strstr_len(data->str,-1,"VALUES") + 6;
   char *insert_statement_prefix=g_strndup(data->str,next_line - data->str);
@@ -256,45 +319,104 @@ int restore_insert(struct connection_data *cd,
       current_line=next_line+1;
       next_line=g_strstr_len(current_line, -1, "\n");
       current_offset_line++;
-    } while ((rows == 0 || current_rows < rows) && next_line != NULL);
-    if (current_rows > 1 || (current_rows==1 && line_len>0) ){
-      tr=restore_data_in_gstring_by_statement(cd, new_insert, FALSE, query_counter);
-
-      if (cd->transaction && *query_counter == commit_count) {
-        tr+=m_commit_and_start_transaction(cd,query_counter);
-      }
-
-      if (tr > 0){
-        g_critical("Connection %ld: Error occurs between lines: %d and %d in a splited INSERT: %s",cd->thread_id, offset_line,current_offset_line,mysql_error(cd->thrconn));
-      }
-      if (mysql_warning_count(cd->thrconn)){
-        g_warning("Connection %ld: Warnings found during INSERT between lines: %d and %d: %s",cd->thread_id, offset_line,current_offset_line, show_warnings_if_possible(cd->thrconn));
-      }
-    }else
+    } while ((max_rows == 0 || current_rows < max_rows) && next_line != NULL);
+    if (current_rows > 1 || (current_rows==1 && line_len>0) )
+      tr=execute(new_insert, current_rows, offset_line, current_offset_line, user_data);
+    else
       tr=0;
     r+=tr;
     offset_line=current_offset_line+1;
     current_line++; // remove trailing ,
   } while (next_line != NULL);
-  cd=NULL;
   g_string_free(new_insert,TRUE);
   g_free(insert_statement_prefix);
   return r;
 }
 
+struct restore_insert_data {
+  struct connection_data *cd;
+  guint *query_counter;
+  struct metrics_counters *table_metrics;
+};
 
+static
+int execute_split_insert(GString *new_insert, guint current_rows, guint offset_line, guint current_offset_line, gpointer user_data){
+  struct restore_insert_data *rid=user_data;
+  struct connection_data *cd=rid->cd;
+  gsize statement_len=new_insert->len;
+  gint64 start_time=metrics_enabled ? g_get_monotonic_time() : 0;
+  guint tr=restore_data_in_gstring_by_statement(cd, new_insert, FALSE, rid->query_counter);
+  if (adaptive_connections && tr == 0)
+    concurrency_account_rows(current_rows);
+  if (metrics_enabled && tr == 0){
+    metrics_thread_add(current_rows, statement_len);
+    if (rid->table_metrics){
+      metrics_counters_add(rid->table_metrics, current_rows, statement_len);
+      metrics_counters_add_time(rid->table_metrics, g_get_monotonic_time() - start_time);
+    }
+  }
+
+  if (cd->transaction && *(rid->query_counter) == commit_count) {
+    tr+=m_commit_and_start_transaction(cd,rid->query_counter);
+  }
+
+  if (tr > 0){
+    g_critical("Connection %ld: Error occurs between lines: %d and %d in a splited INSERT: %s",cd->thread_id, offset_line,current_offset_line,mysql_error(cd->thrconn));
+  }
+  if (mysql_warning_count(cd->thrconn)){
+    g_warning("Connection %ld: Warnings found during INSERT between lines: %d and %d: %s",cd->thread_id, offset_line,current_offset_line, show_warnings_if_possible(cd->thrconn));
+  }
+  return tr;
+}
+
+int restore_insert(struct connection_data *cd,
+                  GString *data, guint *query_counter, guint offset_line, struct metrics_counters *table_metrics)
+{
+  struct restore_insert_data rid={cd, query_counter, table_metrics};
+  return split_insert(data, offset_line, rows, &execute_split_insert, &rid);
+}
+
+
+
+void report_null_target(GList *table_list){
+  struct db_table *dbt=NULL;
+  gdouble load_time;
+  guint64 total_rows=0, total_bytes=0;
+  if (!null_target)
+    return;
+  g_message("Null target report, the data was parsed and discarded:");
+  for (; table_list != NULL; table_list=table_list->next){
+    dbt=table_list->data;
+    if (dbt->is_view || dbt->is_sequence || dbt->start_data_time == NULL)
+      continue;
+    load_time=dbt->finish_data_time != NULL ? (gdouble)g_date_time_difference(dbt->finish_data_time, dbt->start_data_time) / G_TIME_SPAN_SECOND : 0;
+    g_message("%s.%s: %"G_GSIZE_FORMAT" rows, %.1f MB, %.1f MB/s over %.2f seconds",
+              dbt->database->real_database, dbt->real_table, dbt->metrics.rows, (gdouble)dbt->metrics.bytes / 1000000,
+              load_time > 0 ? dbt->metrics.bytes / load_time / 1000000 : 0, load_time);
+    total_rows+=dbt->metrics.rows;
+    total_bytes+=dbt->metrics.bytes;
+  }
+  g_message("Total: %"G_GUINT64_FORMAT" rows, %.1f MB", total_rows, (gdouble)total_bytes / 1000000);
+}
+
+static gint restore_thread_count=0;
 
 void *restore_thread(MYSQL *thrconn){
   struct connection_data *cd=new_connection_data(thrconn);
   struct statement *ir=NULL;
   guint query_counter=0;
+  metrics_register_thread("C%02d", g_atomic_int_add(&restore_thread_count, 1));
 //  g_mutex_lock(cd->in_use);
   while (1){
+    metrics_thread_state(THREAD_STATE_QUEUE);
     cd->queue=g_async_queue_pop(cd->ready);
     if (cd->queue->restore == NULL)
       break;
     while(1) {
+      metrics_thread_state(THREAD_STATE_QUEUE);
       ir=g_async_queue_pop(cd->queue->restore);
+      // Splitting the INSERTs in restore_insert() is accounted as serialize
+      metrics_thread_state(THREAD_STATE_SERIALIZE);
       if (ir->kind_of_statement == CLOSE){
         trace("Releasing connection: %ld", cd->thread_id);
         if (cd->transaction && query_counter > 0)
@@ -304,8 +426,11 @@ void *restore_thread(MYSQL *thrconn){
         ir=NULL;
         break;
       }
+      TRACEPOINT3(myloader, statement__send, cd->thread_id, ir->kind_of_statement, ir->buffer ? ir->buffer->len : 0);
       if (ir->kind_of_statement==INSERT){
-        ir->result=restore_insert(cd, ir->buffer, &query_counter,ir->preline);
+        ir->result=restore_insert(cd, ir->buffer, &query_counter,ir->preline, ir->metrics);
+        memory_release(MEMORY_STATEMENTS, ir->memory);
+        ir->memory=0;
         if (ir->result>0){
           ir->error=g_strdup(mysql_error(cd->thrconn));
           ir->error_number=mysql_errno(cd->thrconn);
@@ -325,6 +450,11 @@ void *restore_thread(MYSQL *thrconn){
             }
           }
         }
+        TRACEPOINT3(myloader, statement__complete, cd->thread_id, ir->kind_of_statement, ir->result);
+        g_async_queue_push(cd->queue->result,ir);
+      }else if (ir->kind_of_statement==SCHEMA_BATCH){
+        ir->result=restore_schema_batch_by_statement(cd, ir);
+        TRACEPOINT3(myloader, statement__complete, cd->thread_id, ir->kind_of_statement, ir->result);
         g_async_queue_push(cd->queue->result,ir);
       }else{
         ir->result=restore_data_in_gstring_by_statement(cd, ir->buffer, ir->is_schema, &query_counter);
@@ -332,6 +462,7 @@ void *restore_thread(MYSQL *thrconn){
           ir->error=g_strdup(mysql_error(cd->thrconn));
           ir->error_number=mysql_errno(cd->thrconn);
         }
+        TRACEPOINT3(myloader, statement__complete, cd->thread_id, ir->kind_of_statement, ir->result);
         g_async_queue_push(cd->queue->result,ir);
       }
     }
@@ -373,6 +504,154 @@ void release_load_data_as_it_is_close( gchar * filename ){
   g_mutex_unlock(load_data_list_mutex);
 }
 
+/*
+  Tables dumped with mydumper --transportable-tables. The DISCARD statement
+  is preceded by the deferred indexes, as the tablespace needs the same
+  indexes than the exported table, and the files in the IMPORT statement are
+  copied, or decompressed, into the datadir before executing it.
+*/
+static
+gchar *get_server_datadir(){
+  MYSQL *conn=NULL;
+  MYSQL_RES *res=NULL;
+  MYSQL_ROW row;
+  g_mutex_lock(datadir_mutex);
+  if (server_datadir == NULL){
+    conn=mysql_init(NULL);
+    m_connect(conn);
+    if (mysql_query(conn, "SELECT @@datadir") || !(res=mysql_store_result(conn)))
+      m_critical("Could not get the datadir: %s", mysql_error(conn));
+    row=mysql_fetch_row(res);
+    server_datadir=g_strdup(row && row[0] ? row[0] : "");
+    mysql_free_result(res);
+    mysql_close(conn);
+  }
+  g_mutex_unlock(datadir_mutex);
+  return server_datadir;
+}
+
+static
+gboolean copy_file(const gchar *source, const gchar *destination){
+  gchar buffer[65536];
+  size_t bytes;
+  gboolean r=TRUE;
+  FILE *in=g_fopen(source, "r");
+  FILE *out=NULL;
+  if (in == NULL)
+    return FALSE;
+  out=g_fopen(destination, "w");
+  if (out == NULL){
+    fclose(in);
+    return FALSE;
+  }
+  while ((bytes=fread(buffer, 1, sizeof(buffer), in)) > 0)
+    if (fwrite(buffer, 1, bytes, out) != bytes){
+      r=FALSE;
+      break;
+    }
+  if (ferror(in))
+    r=FALSE;
+  fclose(in);
+  if (fclose(out))
+    r=FALSE;
+  return r;
+}
+
+/* path is the one of the discarded tablespace, without extension */
+static
+gboolean copy_tablespace_file_into_datadir(gchar *path, gchar *filename){
+  gchar **command=NULL;
+  gchar *basename=NULL, *destination=NULL;
+  GMutex *mutex=NULL;
+  int status=0;
+  gboolean r=TRUE;
+  // Wait until the file is completely received, like LOAD DATA
+  if (load_data_mutex_locate(filename, &mutex))
+    g_mutex_lock(mutex);
+  gboolean is_compressed=get_command_and_basename(filename, &command, &basename);
+  destination=g_strdup_printf("%s%s", path, g_str_has_suffix(basename, ".cfg") ? ".cfg" : ".ibd");
+  if (is_compressed){
+    int pid=execute_file_per_thread(filename, destination, command);
+    r=waitpid(pid, &status, 0) > 0 && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+  }else
+    r=copy_file(filename, destination);
+  if (r){
+    trace("%s copied into %s", filename, destination);
+    m_remove(NULL, filename);
+  }else
+    g_critical("Could not copy %s into %s", filename, destination);
+  memory_release_stream_file(filename);
+  g_free(destination);
+  g_free(basename);
+  return r;
+}
+
+/* --null-target: the file is received, but the tablespace is not imported */
+static
+void skip_tablespace_file(gchar *filename){
+  GMutex *mutex=NULL;
+  if (load_data_mutex_locate(filename, &mutex))
+    g_mutex_lock(mutex);
+  m_remove(NULL, filename);
+  memory_release_stream_file(filename);
+}
+
+static
+void skip_tablespace_files(gchar *statement){
+  gchar *from=g_strstr_len(statement, -1, IMPORT_TABLESPACE_FILES) + strlen(IMPORT_TABLESPACE_FILES);
+  gchar *to=NULL, *filename=NULL;
+  while ((from=g_strstr_len(from, -1, "'")) != NULL){
+    from++;
+    to=g_strstr_len(from, -1, "'");
+    if (to == NULL)
+      break;
+    filename=g_strndup(from, to-from);
+    skip_tablespace_file(filename);
+    g_free(filename);
+    from=to+1;
+  }
+}
+
+static
+gboolean copy_tablespace_files_into_datadir(struct db_table *dbt, gchar *statement){
+  gchar *from=g_strstr_len(statement, -1, IMPORT_TABLESPACE_FILES) + strlen(IMPORT_TABLESPACE_FILES);
+  gchar *to=NULL, *filename=NULL, *path=NULL;
+  gboolean r=TRUE;
+  MYSQL *conn=mysql_init(NULL);
+  m_connect(conn);
+  path=get_tablespace_path(conn, dbt->database->real_database, dbt->real_table, get_server_datadir());
+  mysql_close(conn);
+  if (path == NULL){
+    g_critical("Could not find the discarded tablespace of %s.%s in the server", dbt->database->real_database, dbt->real_table);
+    r=FALSE;
+  }
+  while ((from=g_strstr_len(from, -1, "'")) != NULL){
+    from++;
+    to=g_strstr_len(from, -1, "'");
+    if (to == NULL)
+      break;
+    filename=g_strndup(from, to-from);
+    if (path != NULL)
+      r&=copy_tablespace_file_into_datadir(path, filename);
+    else
+      memory_release_stream_file(filename);
+    g_free(filename);
+    from=to+1;
+  }
+  g_free(path);
+  return r;
+}
+
+static
+GString *take_deferred_indexes(struct db_table *dbt){
+  GString *indexes=NULL;
+  g_mutex_lock(dbt->mutex);
+  indexes=dbt->indexes;
+  dbt->indexes=NULL;
+  g_mutex_unlock(dbt->mutex);
+  return indexes;
+}
+
 void free_statement(struct statement *statement){
   g_string_free(statement->buffer, TRUE);
   g_free(statement->error);
@@ -406,7 +685,10 @@ void assing_statement(struct statement *ir, gchar *stmt, guint preline, gboolean
 
 
 guint process_result_vstatement_pop(GAsyncQueue * get_insert_result_queue, struct statement **ir, void log_fun(const char *, ...) , const char *fmt, va_list args, void * g_async_queue_pop_fun(GAsyncQueue *) ){
+  // The statements in flight are being executed by the connection
+  enum thread_state previous_state=metrics_thread_state(THREAD_STATE_SERVER);
   *ir=g_async_queue_pop_fun(get_insert_result_queue);
+  metrics_thread_state(previous_state);
   if (*ir==NULL)
     return 0;
   if ((*ir)->kind_of_statement!=CLOSE && (*ir)->result>0){
@@ -429,18 +711,80 @@ guint process_result_statement(GAsyncQueue * get_insert_result_queue, struct sta
   return r;
 }
 
-int restore_data_from_file(struct thread_data *td, const char *filename, gboolean is_schema, struct database *use_database){
+/*
+  Moves infile to the first INSERT statement that starts between start and end.
+  Rows are written one per line and new lines inside the values are escaped, so
+  a line that starts with INSERT or REPLACE is always the start of a statement.
+*/
+gboolean seek_to_next_statement(FILE *infile, guint64 start, guint64 end){
+  GString *data=g_string_sized_new(256);
+  gboolean eof=FALSE, found=FALSE;
+  guint line=0;
+  off_t offset=0;
+  // If a line starts at start, we only skip the new line of the previous one
+  if (fseeko(infile, start - 1, SEEK_SET) || !read_data(infile, data, &eof, &line)){
+    g_string_free(data, TRUE);
+    return FALSE;
+  }
+  while (!eof){
+    offset=ftello(infile);
+    if (offset < 0 || (guint64)offset >= end)
+      break;
+    g_string_set_size(data, 0);
+    if (!read_data(infile, data, &eof, &line))
+      break;
+    if (g_str_has_prefix(data->str, "INSERT") || g_str_has_prefix(data->str, "REPLACE")){
+      found=fseeko(infile, offset, SEEK_SET) == 0;
+      break;
+    }
+  }
+  g_string_free(data, TRUE);
+  return found;
+}
+
+/*
+  read_data() for a piece of a split file, which restores the statements that
+  start between start and end. The header of the file is read by every piece,
+  and when the first INSERT is found, the piece moves to its own statements.
+  @return FALSE when the piece is completed, data_read is FALSE on read errors
+*/
+gboolean read_piece_data(FILE *infile, GString *data, gboolean *eof, guint *line, struct file_piece *piece, gboolean *data_read){
+  gboolean statement_start=FALSE;
+  off_t offset=0;
+  for (;;){
+    statement_start= data->len == 0;
+    if (statement_start){
+      offset=ftello(infile);
+      if (offset < 0 || (guint64)offset >= piece->end)
+        return FALSE;
+    }
+    *data_read=read_data(infile, data, eof, line);
+    if (*data_read && statement_start && piece->seek_pending && (g_str_has_prefix(data->str, "INSERT") || g_str_has_prefix(data->str, "REPLACE"))){
+      // The statements from here to start belong to the previous pieces
+      piece->seek_pending=FALSE;
+      g_string_set_size(data, 0);
+      if (!seek_to_next_statement(infile, piece->start, piece->end))
+        return FALSE;
+      continue;
+    }
+    return TRUE;
+  }
+}
+
+static
+int restore_data_from_file_internal(struct thread_data *td, const char *filename, gboolean is_schema, struct database *use_database, struct read_ahead_file *read_ahead, guint64 start, guint64 end){
 
   FILE *infile=NULL;
   gboolean eof = FALSE;
   GString *data = g_string_sized_new(256);
   guint line=0,preline=0;
   gchar *path = g_build_filename(directory, filename, NULL);
-  infile=myl_open(path,"r");
+  if (read_ahead == NULL)
+    infile=myl_open(path,"r");
 
   g_log_set_always_fatal(G_LOG_LEVEL_ERROR|G_LOG_LEVEL_CRITICAL);
 
-  if (!infile) {
+  if (!infile && read_ahead == NULL) {
     g_critical("cannot open file %s (%d)", filename, errno);
     errors++;
     return 1;
@@ -460,8 +804,21 @@ int restore_data_from_file(struct thread_data *td, const char *filename, gboolea
   gboolean results_added=FALSE;
   //  g_assert(ir->kind_of_statement!=CLOSE);
   GString *header=g_string_sized_new(256);
+  // A piece of a split file restores the statements that start between start and end
+  gboolean is_piece= end > 0 && infile != NULL;
+  struct file_piece piece={ start, end, is_piece && start > 0 };
+  gboolean data_read=FALSE;
   while (eof == FALSE) {
-    if (read_data(infile, data, &eof, &line)) {
+    metrics_thread_state(THREAD_STATE_READ);
+    if (is_piece){
+      if (!read_piece_data(infile, data, &eof, &line, &piece, &data_read)){
+        metrics_thread_state(THREAD_STATE_SERIALIZE);
+        break;
+      }
+    }else
+      data_read=read_ahead ? read_ahead_data(read_ahead, data, &eof, &line) : read_data(infile, data, &eof, &line);
+    metrics_thread_state(THREAD_STATE_SERIALIZE);
+    if (data_read) {
       if (g_strrstr(&data->str[data->len >= 5 ? data->len - 5 : 0], ";\n")) {
         if ( skip_definer && g_str_has_prefix(data->str,"CREATE")){
           remove_definer(data);
@@ -477,6 +834,10 @@ int restore_data_from_file(struct thread_data *td, const char *filename, gboolea
             }
           } 
           assing_statement(ir, data->str, preline, FALSE, INSERT);
+          ir->metrics=td->dbt ? &(td->dbt->metrics) : NULL;
+          // Released by the restore thread once the statement is executed
+          ir->memory=ir->buffer->len;
+          memory_acquire(MEMORY_STATEMENTS, ir->memory, FALSE);
 /*          initialize_statement(ir);
           GString *tmp=data;
           data=ir->buffer;
@@ -500,7 +861,8 @@ int restore_data_from_file(struct thread_data *td, const char *filename, gboolea
             g_mutex_lock(mutex);
 	      // TODO we need to free filename and mutex from the hash.
           gchar **command=NULL;
-          gboolean is_fifo = get_command_and_basename(load_data_filename, &command, &load_data_fifo_filename);
+          // --null-target does not read the file, so it is not decompressed into a fifo
+          gboolean is_fifo = get_command_and_basename(load_data_filename, &command, &load_data_fifo_filename) && !null_target;
           if (is_fifo){ 
             if (fifo_directory != NULL){
               new_data = g_string_new_len(data->str, from - data->str);
@@ -539,6 +901,34 @@ int restore_data_from_file(struct thread_data *td, const char *filename, gboolea
             m_remove0(NULL, load_data_fifo_filename);
           else
             m_remove(NULL, load_data_filename);
+          memory_release_stream_file(load_data_filename);
+        }else if (null_target && td->dbt && (g_strstr_len(data->str, -1, DISCARD_TABLESPACE) || g_strstr_len(data->str, -1, IMPORT_TABLESPACE_FILES))){
+          // Nothing is sent, and the tablespace files are not copied into the datadir
+          if (g_strstr_len(data->str, -1, IMPORT_TABLESPACE_FILES))
+            skip_tablespace_files(data->str);
+          initialize_statement(ir);
+        }else if (td->dbt && g_strstr_len(data->str, -1, DISCARD_TABLESPACE)){
+          GString *indexes=take_deferred_indexes(td->dbt);
+          if (indexes != NULL){
+            message("Thread %d: Creating indexes of %s.%s before importing its tablespace", td->thread_id, td->dbt->database->real_database, td->dbt->real_table);
+            assing_statement(ir, indexes->str, preline, FALSE, OTHER);
+            g_async_queue_push(cd->queue->restore,ir);
+            ir=NULL;
+            process_result_statement(cd->queue->result, &ir, m_critical, "(2)Error occurs processing file %s", filename);
+            r|= ir->result;
+            g_string_free(indexes, TRUE);
+          }
+          assing_statement(ir, data->str, preline, FALSE, OTHER);
+          g_async_queue_push(cd->queue->restore,ir);
+          ir=NULL;
+          process_result_statement(cd->queue->result, &ir, m_critical, "(2)Error occurs processing file %s", filename);
+        }else if (td->dbt && g_strstr_len(data->str, -1, IMPORT_TABLESPACE_FILES)){
+          if (!copy_tablespace_files_into_datadir(td->dbt, data->str))
+            errors++;
+          assing_statement(ir, data->str, preline, FALSE, OTHER);
+          g_async_queue_push(cd->queue->restore,ir);
+          ir=NULL;
+          process_result_statement(cd->queue->result, &ir, m_critical, "(2)Error occurs processing file %s", filename);
         }else{
           if (g_strrstr_len(data->str,3,"/*!")){
             gchar *from_equal=g_strstr_len(data->str, strlen(data->str),"=");
@@ -594,11 +984,33 @@ int restore_data_from_file(struct thread_data *td, const char *filename, gboolea
   g_string_free(data, TRUE);
   g_free(load_data_filename);
 
-  myl_close(filename, infile, TRUE);
+  if (read_ahead){
+    free_read_ahead_file(read_ahead);
+    m_remove(NULL, filename);
+  }else
+    myl_close(filename, infile, TRUE);
   g_free(path);
   return r;
 }
 
+int restore_data_from_file(struct thread_data *td, const char *filename, gboolean is_schema, struct database *use_database, struct read_ahead_file *read_ahead){
+  trace_event_begin(is_schema ? "schema" : "data", "%s", filename);
+  TRACEPOINT4(myloader, file__begin, td->thread_id, filename, 0, 0);
+  int r=restore_data_from_file_internal(td, filename, is_schema, use_database, read_ahead, 0, 0);
+  TRACEPOINT3(myloader, file__end, td->thread_id, filename, r);
+  trace_event_end();
+  return r;
+}
+
+int restore_data_from_file_range(struct thread_data *td, const char *filename, struct database *use_database, struct read_ahead_file *read_ahead, guint64 start, guint64 end){
+  trace_event_begin("data", "%s [%"G_GUINT64_FORMAT", %"G_GUINT64_FORMAT")", filename, start, end);
+  TRACEPOINT4(myloader, file__begin, td->thread_id, filename, start, end);
+  int r=restore_data_from_file_internal(td, filename, FALSE, use_database, read_ahead, start, end);
+  TRACEPOINT3(myloader, file__end, td->thread_id, filename, r);
+  trace_event_end();
+  return r;
+}
+
 int restore_data_in_gstring_extended(struct thread_data *td, GString *data, gboolean is_schema, struct database *use_database, void log_fun(const char *, ...) , const char *fmt, ...){
   va_list    args;
   va_start(args, fmt);
@@ -634,6 +1046,29 @@ int restore_data_in_gstring_extended(struct thread_data *td, GString *data, gboo
 }
 
 
+int restore_schema_batch(struct thread_data *td, GString *data, struct database *use_database, guint *executed, guint *error_number, gchar **error){
+  struct connection_data *cd=wait_for_available_restore_thread(td, FALSE, use_database);
+  struct io_restore_result *queue= cd->queue;
+  cd=NULL;
+  struct statement *ir=g_async_queue_pop(free_results_queue);
+  int r=0;
+  assing_statement(ir, data->str, 0, TRUE, SCHEMA_BATCH);
+  g_async_queue_push(queue->restore,ir);
+  ir=g_async_queue_pop(queue->result);
+  r=ir->result;
+  *executed=ir->executed;
+  *error_number=ir->error_number;
+  *error=ir->error;
+  ir->error=NULL;
+  g_async_queue_push(free_results_queue,ir);
+  g_async_queue_push(queue->restore,&release_connection_statement);
+  td->granted_connections--;
+  ir=g_async_queue_pop(queue->result);
+  g_assert(ir->kind_of_statement==CLOSE);
+  g_async_queue_push(restore_queues, queue);
+  return r;
+}
+
 int restore_data_in_gstring(struct thread_data *td, GString *data, gboolean is_schema, struct database *use_database){
   return restore_data_in_gstring_extended(td, data, is_schema, use_database, m_warning, "Failed to execute statement", NULL);
 }
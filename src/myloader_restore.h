@@ -15,7 +15,12 @@
         Authors:    David Ducos, Percona (david dot ducos at percona dot com)
 */
 
-enum kind_of_statement { NOT_DEFINED, INSERT, OTHER, CLOSE};
+#define DISCARD_TABLESPACE "DISCARD TABLESPACE;"
+#define IMPORT_TABLESPACE_FILES "IMPORT TABLESPACE /* FILES "
+
+enum kind_of_statement { NOT_DEFINED, INSERT, OTHER, CLOSE, SCHEMA_BATCH};
+
+struct read_ahead_file;
 
 struct statement{
   guint result;
@@ -26,15 +31,31 @@ struct statement{
   gboolean is_schema;
   gchar *error;
   guint error_number;
+  guint executed;
+  guint64 memory;
+  struct metrics_counters *metrics;
 //  struct thread_data *td;
 };
 
 void initialize_connection_pool(MYSQL *thrconn);
+int split_insert(GString *data, guint offset_line, guint max_rows, int execute(GString *statement, guint statement_rows, guint from_line, guint to_line, gpointer user_data), gpointer user_data);
 
 int restore_data_in_gstring(struct thread_data *td, GString *data, gboolean is_schema, struct database *use_database);
+int restore_schema_batch(struct thread_data *td, GString *data, struct database *use_database, guint *executed, guint *error_number, gchar **error);
 int restore_data_in_gstring_extended(struct thread_data *td, GString *data, gboolean is_schema, struct database *use_database, void log_fun(const char *, ...) , const char *fmt, ...);
-int restore_data_from_file(struct thread_data *td, const char *filename, gboolean is_schema, struct database *use_database);
+int restore_data_from_file(struct thread_data *td, const char *filename, gboolean is_schema, struct database *use_database, struct read_ahead_file *read_ahead);
+/* The statements of a split file that start between start and end */
+struct file_piece {
+  guint64 start;
+  guint64 end;
+  // The header is read, but not the statements before start
+  gboolean seek_pending;
+};
+gboolean seek_to_next_statement(FILE *infile, guint64 start, guint64 end);
+gboolean read_piece_data(FILE *infile, GString *data, gboolean *eof, guint *line, struct file_piece *piece, gboolean *data_read);
+int restore_data_from_file_range(struct thread_data *td, const char *filename, struct database *use_database, struct read_ahead_file *read_ahead, guint64 start, guint64 end);
 
 void release_load_data_as_it_is_close( gchar * filename );
 struct connection_data *close_restore_thread(gboolean return_connection);
 void wait_restore_threads_to_close();
+void report_null_target(GList *table_list);
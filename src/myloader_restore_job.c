@@ -32,6 +32,8 @@ unsigned long long int total_data_sql_files = 0;
 #include "myloader_control_job.h"
 #include "myloader_worker_loader.h"
 #include "myloader_worker_index.h"
+#include "myloader_read_ahead.h"
+#include "myloader_memory.h"
 
 gboolean shutdown_triggered=FALSE;
 GAsyncQueue *file_list_to_do=NULL;
@@ -65,11 +67,15 @@ void initialize_restore_job(gchar * pm_str){
   else purge_mode=FAIL; // This means that if -o is not set and CREATE TABLE statement fails, myloader will stop. 
 }
 
-struct data_restore_job * new_data_restore_job_internal( guint index, guint part, guint sub_part){
+struct data_restore_job * new_data_restore_job_internal( guint index, guint part, guint sub_part, guint64 size){
   struct data_restore_job *drj = g_new(struct data_restore_job, 1);
   drj->index    = index;
   drj->part     = part;
   drj->sub_part = sub_part;
+  drj->size     = size;
+  drj->range    = 0;
+  drj->start    = 0;
+  drj->end      = 0;
   return drj;
 }
 
@@ -86,12 +92,13 @@ struct restore_job * new_restore_job( char * filename, struct db_table * dbt, en
   rj->filename  = filename;
   rj->dbt       = dbt;
   rj->type      = type;
+  rj->read_ahead= NULL;
   return rj;
 }
 
-struct restore_job * new_data_restore_job( char * filename, enum restore_job_type type, struct db_table * dbt, guint part, guint sub_part){
+struct restore_job * new_data_restore_job( char * filename, enum restore_job_type type, struct db_table * dbt, guint part, guint sub_part, guint64 size){
   struct restore_job *rj = new_restore_job(filename, dbt, type);
-  rj->data.drj=new_data_restore_job_internal( dbt->count + 1, part, sub_part);
+  rj->data.drj=new_data_restore_job_internal( dbt->count + 1, part, sub_part, size);
   return rj;
 }
 
@@ -296,7 +303,10 @@ int process_restore_job(struct thread_data *td, struct restore_job *rj){
         }
         if (serial_tbl_creation) g_mutex_unlock(single_threaded_create_table);
       }
+      g_mutex_lock(dbt->mutex);
       dbt->schema_state=CREATED;
+      update_table_in_ready_queue(dbt);
+      g_mutex_unlock(dbt->mutex);
       free_schema_restore_job(rj->data.srj);
       break;
     case JOB_RESTORE_FILENAME:
@@ -307,11 +317,12 @@ int process_restore_job(struct thread_data *td, struct restore_job *rj){
           message("Thread %d: restoring %s.%s part %d of %d from %s | Progress %llu of %llu. Tables %d of %d completed", td->thread_id,
                     dbt->database->real_database, dbt->real_table, rj->data.drj->index, dbt->count, rj->filename, progress,total_data_sql_files, total , g_hash_table_size(td->conf->table_hash));
           g_mutex_unlock(progress_mutex);
-          if (restore_data_from_file(td, rj->filename, FALSE, dbt->database) > 0){
+          if (restore_data_from_file_range(td, rj->filename, dbt->database, claim_read_ahead(rj), rj->data.drj->start, rj->data.drj->end) > 0){
             g_atomic_int_inc(&(detailed_errors.data_errors));
             g_critical("Thread : issue restoring %s", rj->filename);
           }
       }
+      memory_release_stream_file(rj->filename);
       g_atomic_int_dec_and_test(&(dbt->remaining_jobs));
       g_free(rj->data.drj);
       break;
@@ -323,12 +334,16 @@ int process_restore_job(struct thread_data *td, struct restore_job *rj){
                     rj->data.srj->database->real_database, rj->filename, total , g_hash_table_size(td->conf->table_hash));
           if (dbt)
             dbt->schema_state= CREATING;
-          if ( restore_data_from_file(td, rj->filename, TRUE, g_strcmp0(rj->data.srj->object, CREATE_DATABASE) ? rj->data.srj->database : NULL ) > 0 ) {
+          if ( restore_data_from_file(td, rj->filename, TRUE, g_strcmp0(rj->data.srj->object, CREATE_DATABASE) ? rj->data.srj->database : NULL, NULL ) > 0 ) {
             increse_object_error(rj->data.srj->object);
             if (dbt)
               dbt->schema_state= NOT_CREATED;
-          } else if (dbt)
+          } else if (dbt){
+            g_mutex_lock(dbt->mutex);
             dbt->schema_state= CREATED;
+            update_table_in_ready_queue(dbt);
+            g_mutex_unlock(dbt->mutex);
+          }
         }
       }
       free_schema_restore_job(rj->data.srj);
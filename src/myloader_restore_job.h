@@ -42,6 +42,10 @@ struct data_restore_job{
   guint index;
   guint part;
   guint sub_part;
+  guint64 size;
+  guint range;
+  guint64 start;
+  guint64 end;
 };
 
 struct schema_restore_job{
@@ -61,13 +65,16 @@ struct restore_job {
   union restore_job_data data;
   char *filename;
   struct db_table *dbt;
+  struct read_ahead_file *read_ahead;
 };
 
 void initialize_restore_job();
 //struct restore_job * new_restore_job( char * filename, /*char * database,*/ struct db_table * dbt, GString * statement, guint part, guint sub_part, enum restore_job_type type, const char *object);
-struct restore_job * new_data_restore_job( char * filename, enum restore_job_type type, struct db_table * dbt, guint part, guint sub_part);
+struct restore_job * new_data_restore_job( char * filename, enum restore_job_type type, struct db_table * dbt, guint part, guint sub_part, guint64 size);
 struct restore_job * new_schema_restore_job( char * filename, enum restore_job_type type, struct db_table * dbt, struct database * database, GString * statement, const char *object);
 int process_restore_job(struct thread_data *td, struct restore_job *rj);
+void free_schema_restore_job(struct schema_restore_job *srj);
+void get_total_created(struct configuration * conf, guint *total);
 void restore_job_finish();
 void stop_signal_thread();
 void *signal_thread(void *data);
@@ -0,0 +1,203 @@
+/*
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+        Authors:    David Ducos, Percona (david dot ducos at percona dot com)
+*/
+#include <mysql.h>
+#include <glib.h>
+#include <stdlib.h>
+#include <string.h>
+#include "common.h"
+#include "myloader.h"
+#include "myloader_global.h"
+#include "myloader_restore_job.h"
+#include "myloader_sorted_ingest.h"
+
+/*
+  Sorted-key ingest.
+
+  mydumper numbers the chunks of a table in a way that cmp_restore_job() sorts
+  restore_job_list in primary key order. By default, the threads of a table
+  take the next jobs of that list, so they are inserting rows in consecutive
+  chunks at the same time, and every page at the boundary between two chunks
+  is split while it is being filled from both sides.
+
+  With --sorted-ingest=RANGES, once all the files of the table are known, the
+  list is split in as many contiguous key ranges of similar size as threads the
+  table can use. Only one job per range is sent at a time and always the next
+  one of the range, so each connection appends at the right edge of its own
+  range. With --sorted-ingest=SERIAL there is only one range, the whole table is
+  loaded in key order by one connection at a time, which on a freshly created
+  table means that every insert is an append.
+
+  --ingest-report prints the load time and the size of the data and indexes of
+  every table at the end, so the same dump can be compared with and without
+  --sorted-ingest.
+*/
+
+enum sorted_ingest_mode sorted_ingest = SORTED_INGEST_NONE;
+gchar *sorted_ingest_str = NULL;
+gboolean ingest_report = FALSE;
+
+void initialize_sorted_ingest(){
+  if (sorted_ingest == SORTED_INGEST_NONE)
+    return;
+  if (stream){
+    // Files arrive while they are being loaded, the ranges can not be known in advance
+    g_warning("--sorted-ingest is not compatible with --stream, it will be ignored");
+    sorted_ingest=SORTED_INGEST_NONE;
+    return;
+  }
+  ingest_report=TRUE;
+  g_message("Using sorted ingest: %s", sorted_ingest == SORTED_INGEST_SERIAL ? "one connection per table loading in key order" : "one key range per connection");
+}
+
+static
+guint job_range(GList *node){
+  return ((struct restore_job *)node->data)->data.drj->range;
+}
+
+/* It must be called with dbt->mutex locked and after all the jobs of the table were enqueued */
+void split_table_into_key_ranges(struct db_table *dbt, guint ranges){
+  GList *iter=dbt->restore_job_list;
+  guint64 total=0, accumulated=0, size;
+  guint range=0;
+  if (ranges == 0)
+    ranges=1;
+  if (ranges > dbt->restore_job_count)
+    ranges=dbt->restore_job_count;
+  for (; iter != NULL; iter=iter->next)
+    // Files without size are counted as one byte, so they are split by amount of files
+    total+=((struct restore_job *)iter->data)->data.drj->size + 1;
+  dbt->key_ranges=ranges;
+  dbt->key_range_next=g_new0(GList *, ranges);
+  dbt->key_range_busy=g_new0(gboolean, ranges);
+  for (iter=dbt->restore_job_list; iter != NULL; iter=iter->next){
+    size=((struct restore_job *)iter->data)->data.drj->size + 1;
+    if (range + 1 < ranges && accumulated > 0 && accumulated + size / 2 > total * (range + 1) / ranges)
+      range++;
+    if (dbt->key_range_next[range] == NULL)
+      dbt->key_range_next[range]=iter;
+    ((struct restore_job *)iter->data)->data.drj->range=range;
+    accumulated+=size;
+  }
+  message("%s.%s: %u files split in %u key ranges", dbt->database->real_database, dbt->real_table, dbt->restore_job_count, dbt->key_ranges);
+}
+
+/* It must be called with dbt->mutex locked */
+gboolean has_idle_key_range(struct db_table *dbt){
+  guint i;
+  for (i=0; i < dbt->key_ranges; i++)
+    if (!dbt->key_range_busy[i] && dbt->key_range_next[i] != NULL)
+      return TRUE;
+  return FALSE;
+}
+
+/* It must be called with dbt->mutex locked and has_idle_key_range() being TRUE */
+struct restore_job *take_next_job_in_key_order(struct db_table *dbt){
+  guint i;
+  GList *node=NULL, *next=NULL;
+  for (i=0; i < dbt->key_ranges; i++)
+    if (!dbt->key_range_busy[i] && dbt->key_range_next[i] != NULL)
+      break;
+  if (i == dbt->key_ranges)
+    return NULL;
+  node=dbt->key_range_next[i];
+  next=node->next;
+  // Ranges are contiguous, when the next job is not in this range, the range is completed
+  dbt->key_range_next[i]=next != NULL && job_range(next) == i ? next : NULL;
+  dbt->key_range_busy[i]=TRUE;
+  struct restore_job *job=node->data;
+  dbt->restore_job_list=g_list_delete_link(dbt->restore_job_list, node);
+  return job;
+}
+
+/* It must be called with dbt->mutex locked */
+void key_range_job_finished(struct db_table *dbt, guint range){
+  if (range < dbt->key_ranges)
+    dbt->key_range_busy[range]=FALSE;
+}
+
+static
+gboolean get_table_sizes(MYSQL *conn, struct db_table *dbt, guint64 *table_rows, guint64 *data_length, guint64 *index_length, guint64 *data_free){
+  MYSQL_RES *res=NULL;
+  MYSQL_ROW row;
+  const char q= identifier_quote_character;
+  gchar *escaped_database=g_new(gchar, strlen(dbt->database->real_database) * 2 + 1);
+  gchar *escaped_table=g_new(gchar, strlen(dbt->real_table) * 2 + 1);
+  mysql_real_escape_string(conn, escaped_database, dbt->database->real_database, strlen(dbt->database->real_database));
+  mysql_real_escape_string(conn, escaped_table, dbt->real_table, strlen(dbt->real_table));
+  // The sizes in information_schema are only updated when the statistics are recalculated
+  gchar *query=g_strdup_printf("ANALYZE NO_WRITE_TO_BINLOG TABLE %c%s%c.%c%s%c", q, dbt->database->real_database, q, q, dbt->real_table, q);
+  if (mysql_query(conn, query))
+    g_warning("Ingest report: ANALYZE TABLE failed on %s.%s: %s", dbt->database->real_database, dbt->real_table, mysql_error(conn));
+  else{
+    res=mysql_store_result(conn);
+    if (res)
+      mysql_free_result(res);
+  }
+  g_free(query);
+  query=g_strdup_printf("SELECT TABLE_ROWS, DATA_LENGTH, INDEX_LENGTH, DATA_FREE FROM information_schema.TABLES WHERE TABLE_SCHEMA='%s' AND TABLE_NAME='%s'", escaped_database, escaped_table);
+  g_free(escaped_database);
+  g_free(escaped_table);
+  if (mysql_query(conn, query)){
+    g_warning("Ingest report: failed to get the size of %s.%s: %s", dbt->database->real_database, dbt->real_table, mysql_error(conn));
+    g_free(query);
+    return FALSE;
+  }
+  g_free(query);
+  res=mysql_store_result(conn);
+  if (!res)
+    return FALSE;
+  row=mysql_fetch_row(res);
+  if (row == NULL){
+    mysql_free_result(res);
+    return FALSE;
+  }
+  *table_rows=row[0] ? g_ascii_strtoull(row[0], NULL, 10) : 0;
+  *data_length=row[1] ? g_ascii_strtoull(row[1], NULL, 10) : 0;
+  *index_length=row[2] ? g_ascii_strtoull(row[2], NULL, 10) : 0;
+  *data_free=row[3] ? g_ascii_strtoull(row[3], NULL, 10) : 0;
+  mysql_free_result(res);
+  return TRUE;
+}
+
+void report_ingest(GList *table_list, MYSQL *conn){
+  struct db_table *dbt=NULL;
+  guint64 table_rows=0, data_length=0, index_length=0, data_free=0;
+  guint64 total_data_length=0, total_index_length=0, total_data_free=0;
+  gdouble load_time;
+  if (!ingest_report)
+    return;
+  // Since MySQL 8.0, information_schema.TABLES is cached for a day by default
+  if (mysql_query(conn, "SET SESSION information_schema_stats_expiry=0"))
+    trace("information_schema_stats_expiry is not supported: %s", mysql_error(conn));
+  g_message("Ingest report (%s):", sorted_ingest == SORTED_INGEST_SERIAL ? "sorted ingest SERIAL" : sorted_ingest == SORTED_INGEST_RANGES ? "sorted ingest RANGES" : "default ingest");
+  for (; table_list != NULL; table_list=table_list->next){
+    dbt=table_list->data;
+    if (dbt->is_view || dbt->is_sequence || dbt->start_data_time == NULL)
+      continue;
+    if (!get_table_sizes(conn, dbt, &table_rows, &data_length, &index_length, &data_free))
+      continue;
+    load_time=dbt->finish_data_time != NULL ? (gdouble)g_date_time_difference(dbt->finish_data_time, dbt->start_data_time) / G_TIME_SPAN_SECOND : 0;
+    g_message("%s.%s | Data load: %.2f seconds | Key ranges: %u | Rows: %"G_GUINT64_FORMAT" | Data length: %.2f MB | Index length: %.2f MB | Data free: %.2f MB",
+              dbt->database->real_database, dbt->real_table, load_time, dbt->key_ranges, table_rows,
+              (gdouble)data_length / 1048576, (gdouble)index_length / 1048576, (gdouble)data_free / 1048576);
+    total_data_length+=data_length;
+    total_index_length+=index_length;
+    total_data_free+=data_free;
+  }
+  g_message("Total | Data length: %.2f MB | Index length: %.2f MB | Data free: %.2f MB",
+            (gdouble)total_data_length / 1048576, (gdouble)total_index_length / 1048576, (gdouble)total_data_free / 1048576);
+}
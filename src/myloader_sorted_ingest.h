@@ -0,0 +1,30 @@
+/*
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+        Authors:    David Ducos, Percona (david dot ducos at percona dot com)
+*/
+#ifndef _src_myloader_sorted_ingest_h
+#define _src_myloader_sorted_ingest_h
+#include <mysql.h>
+#include <glib.h>
+#include "myloader.h"
+#include "myloader_restore_job.h"
+
+void initialize_sorted_ingest();
+void split_table_into_key_ranges(struct db_table *dbt, guint ranges);
+gboolean has_idle_key_range(struct db_table *dbt);
+struct restore_job *take_next_job_in_key_order(struct db_table *dbt);
+void key_range_job_finished(struct db_table *dbt, guint range);
+void report_ingest(GList *table_list, MYSQL *conn);
+#endif
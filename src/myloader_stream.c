@@ -21,6 +21,7 @@
 #include "myloader_control_job.h"
 #include "myloader_intermediate_queue.h"
 #include "myloader_global.h"
+#include "myloader_memory.h"
 
 GThread *stream_thread = NULL;
 void *process_stream();
@@ -33,10 +34,10 @@ void wait_stream_to_finish(){
   g_thread_join(stream_thread);
 }
 
-size_t read_stream_line(char *buffer, gboolean *eof,FILE *file,int c_to_read){
+size_t read_stream_line(FILE *input, char *buffer, gboolean *eof,FILE *file,int c_to_read){
 (void) file;
 (void) eof;
-    size_t bytes = fread(buffer, sizeof(char), c_to_read, stdin);
+    size_t bytes = fread(buffer, sizeof(char), c_to_read, input);
 /*    if (file != NULL && feof(stdin)){
       g_message("EOF!!");
       *eof = TRUE;
@@ -58,6 +59,19 @@ void flush(char *buffer, int from, int to, FILE *file, guint *total_size){
   }
 }
 
+/*
+  Data files wait on disk until they are restored. They are accounted without
+  waiting, as a loader can be waiting for them, and before they are handed to
+  the loaders, so they can not be released before they are accounted.
+*/
+static
+void stream_file_received(gchar *filename, guint size){
+  enum file_type ft=get_file_type(filename);
+  if (ft == DATA || ft == LOAD_DATA)
+    memory_acquire_stream_file(filename, size);
+  intermediate_queue_new(filename);
+}
+
 gboolean has_mydumper_suffix(gchar *line){
   return
     m_filename_has_suffix(line,".dat") ||
@@ -66,8 +80,11 @@ gboolean has_mydumper_suffix(gchar *line){
     g_str_has_prefix(line,"metadata");
 }
 
-void *process_stream(struct configuration *stream_conf){
-  set_thread_name("STT");
+/*
+  Writes the files that come in the stream read from input into directory.
+  file_received is called when a file is complete.
+*/
+void receive_stream(FILE *input, void file_received(gchar *filename, guint size)){
   char * filename=NULL,*real_filename=NULL,* previous_filename=NULL;
   char *buffer=g_new(char, STREAM_BUFFER_SIZE);
   FILE *file=NULL;
@@ -76,12 +93,12 @@ void *process_stream(struct configuration *stream_conf){
   int diff=0, i=0, line_from=0, line_end=0; 
   int initial_pos=0;
   guint total_size=0;
-  guint b=0;
+  guint b=0, previous_b=0;
   for(i=0;i<STREAM_BUFFER_SIZE;i++){
     buffer[i]='\0';
   }
   do {
-read_more:    buffer_len=read_stream_line(&(buffer[diff]),&eof,file,STREAM_BUFFER_SIZE-1-diff)+diff;
+read_more:    buffer_len=read_stream_line(input, &(buffer[diff]),&eof,file,STREAM_BUFFER_SIZE-1-diff)+diff;
 //    g_message("Reading more byte(%d) with diff %d : |%s|\nWith buffer: |%s|", buffer_len, diff, &(buffer[diff]), buffer);
     if (buffer_len==diff){
 //      g_message("Char in byte1 = %d %d == %d", buffer[0], buffer_len, diff);
@@ -139,6 +156,7 @@ read_more:    buffer_len=read_stream_line(&(buffer[diff]),&eof,file,STREAM_BUFFE
                   m_critical("Different file size in %s. Should be: 0 | Written: %d", filename, total_size);
               }
               previous_filename=g_strdup(filename);
+              previous_b=b;
               g_free(filename);
             }
 //g_message("Pos: %d Line_end: %d line_from %d last_pos: %d next_line_from: %d filename_sapce: %d", pos,line_end, line_from, last_pos, next_line_from, GPOINTER_TO_INT(filename_space->next->data));
@@ -153,9 +171,12 @@ read_more:    buffer_len=read_stream_line(&(buffer[diff]),&eof,file,STREAM_BUFFE
               m_close(file);
             }
             if (previous_filename){
-              intermediate_queue_new(previous_filename);
+              file_received(previous_filename, previous_b);
 	      previous_filename=NULL;
 	    }
+            // Over the memory budget, the stream stops before the next .sql data file, never before a .dat or .ibd
+            if (get_file_type(filename) == DATA)
+              memory_wait(MEMORY_STREAM, b);
             if (g_file_test(real_filename, G_FILE_TEST_EXISTS)){
               if (no_stream){
                  if (total_size>0)
@@ -224,8 +245,14 @@ read_more:    buffer_len=read_stream_line(&(buffer[diff]),&eof,file,STREAM_BUFFE
   if (file) 
     m_close(file);
   if (!no_stream && filename)
-    intermediate_queue_new(g_strdup(filename));
+    file_received(g_strdup(filename), b);
   g_free(filename);
+  g_free(buffer);
+}
+
+void *process_stream(struct configuration *stream_conf){
+  set_thread_name("STT");
+  receive_stream(stdin, &stream_file_received);
   intermediate_queue_end();
   guint n=0;
   for (n = 0; n < num_threads ; n++) {
@@ -17,3 +17,4 @@
 #include "myloader.h"
 void initialize_stream (struct configuration *conf);
 void wait_stream_to_finish();
+void receive_stream(FILE *input, void file_received(gchar *filename, guint size));
@@ -24,6 +24,7 @@
 #include "common.h"
 #include "server_detect.h"
 #include "myloader.h"
+#include "trace_file.h"
 #include "myloader_common.h"
 #include "myloader_process.h"
 //#include "myloader_jobs_manager.h"
@@ -41,12 +42,21 @@ GAsyncQueue * innodb_optimize_keys_all_tables_queue=NULL;
 GThread **index_threads = NULL;
 struct thread_data *index_td = NULL;
 static GMutex *init_connection_mutex=NULL;
+static GMutex *index_build_mutex=NULL;
+static GSequence *index_build_queue=NULL;
+static guint running_index_builds=0;
+static guint64 running_index_cost=0;
+static guint pending_index_shutdowns=0;
+guint index_build_budget=0;
+extern gboolean control_job_ended;
 void *worker_index_thread(struct thread_data *td);
 
 void initialize_worker_index(struct configuration *conf){
   guint n=0;
 //  index_mutex = g_mutex_new();
   init_connection_mutex = g_mutex_new();
+  index_build_mutex = g_mutex_new();
+  index_build_queue = g_sequence_new(NULL);
   index_threads = g_new(GThread *, max_threads_for_index_creation);
   index_td = g_new(struct thread_data, max_threads_for_index_creation);
   innodb_optimize_keys_all_tables_queue=g_async_queue_new();
@@ -57,24 +67,121 @@ void initialize_worker_index(struct configuration *conf){
   }
 }
 
-gboolean process_index(struct thread_data * td){
-  struct control_job *job=g_async_queue_pop(td->conf->index_queue);
-  if (job->type==JOB_SHUTDOWN)
-  {
-    trace("index_queue -> %s", jtype2str(job->type));
-    return FALSE;
+/*
+  Index builds are not run in the order that they are enqueued. They are kept
+  in index_build_queue ordered by their estimated cost, as the most expensive
+  builds are the ones that are going to define when the restore ends. While
+  data is still being loaded, the builds that run at the same time are
+  limited by --index-build-budget to not starve the data loads.
+*/
+static guint count_indexes(GString *indexes){
+  guint n=0;
+  gchar *p=indexes?indexes->str:NULL;
+  while (p != NULL && (p=g_strstr_len(p, -1, "\n ADD")) != NULL){
+    n++;
+    p+=5;
   }
+  return n;
+}
+
+/* Estimated cost in MB: data that needs to be read times the amount of indexes to build */
+static guint64 estimate_index_cost(struct db_table *dbt, guint indexes){
+  guint64 bytes=dbt->data_bytes>0 ? dbt->data_bytes : dbt->rows * INDEX_COST_BYTES_PER_ROW;
+  return (bytes / (1024 * 1024) + 1) * (indexes > 0 ? indexes : 1);
+}
 
+static gint cmp_index_build(gconstpointer a, gconstpointer b, gpointer user_data){
+  (void) user_data;
+  const struct index_build *ib_a=a, *ib_b=b;
+  if (ib_a->cost != ib_b->cost)
+    return ib_a->cost < ib_b->cost ? 1 : -1;
+  return 0;
+}
+
+static void enqueue_index_build(struct control_job *job){
+  if (job->type==JOB_SHUTDOWN){
+    trace("index_queue -> %s", jtype2str(job->type));
+    pending_index_shutdowns++;
+    g_free(job);
+    return;
+  }
   g_assert(job->type == JOB_RESTORE);
-  struct db_table *dbt=job->data.restore_job->dbt;
-  trace("index_queue -> %s: %s.%s", rjtype2str(job->data.restore_job->type), dbt->database->real_database, dbt->table);
+  struct index_build *ib=g_new(struct index_build, 1);
+  ib->job=job;
+  ib->dbt=job->data.restore_job->dbt;
+  ib->indexes=count_indexes(ib->dbt->indexes);
+  ib->cost=estimate_index_cost(ib->dbt, ib->indexes);
+  trace("index_queue -> %s: %s.%s, %u indexes, cost %"G_GUINT64_FORMAT, rjtype2str(job->data.restore_job->type), ib->dbt->database->real_database, ib->dbt->table, ib->indexes, ib->cost);
+  g_sequence_insert_sorted(index_build_queue, ib, &cmp_index_build, NULL);
+}
+
+static gboolean fits_index_build_budget(guint64 cost){
+  // One build is always allowed, otherwise an expensive build will never start
+  if (running_index_builds == 0 || index_build_budget == 0 || control_job_ended)
+    return TRUE;
+  return running_index_cost + cost <= index_build_budget;
+}
+
+/* @return the next index build to run or NULL if the thread needs to shutdown */
+static struct index_build *next_index_build(struct configuration *conf){
+  struct control_job *job=NULL;
+  struct index_build *ib=NULL;
+  GSequenceIter *iter=NULL;
+  while (TRUE){
+    g_mutex_lock(index_build_mutex);
+    while ((job=g_async_queue_try_pop(conf->index_queue)) != NULL)
+      enqueue_index_build(job);
+    iter=g_sequence_get_begin_iter(index_build_queue);
+    while (!g_sequence_iter_is_end(iter)){
+      ib=g_sequence_get(iter);
+      if (fits_index_build_budget(ib->cost)){
+        g_sequence_remove(iter);
+        running_index_builds++;
+        running_index_cost+=ib->cost;
+        g_mutex_unlock(index_build_mutex);
+        return ib;
+      }
+      iter=g_sequence_iter_next(iter);
+    }
+    if (g_sequence_get_length(index_build_queue) == 0 && pending_index_shutdowns > 0){
+      pending_index_shutdowns--;
+      g_mutex_unlock(index_build_mutex);
+      return NULL;
+    }
+    g_mutex_unlock(index_build_mutex);
+    // We wake up every second as the budget might be released
+    job=g_async_queue_timeout_pop(conf->index_queue, G_USEC_PER_SEC);
+    if (job != NULL){
+      g_mutex_lock(index_build_mutex);
+      enqueue_index_build(job);
+      g_mutex_unlock(index_build_mutex);
+    }
+  }
+  return NULL;
+}
+
+gboolean process_index(struct thread_data * td){
+  struct index_build *ib=next_index_build(td->conf);
+  if (ib == NULL)
+    return FALSE;
+
+  struct db_table *dbt=ib->dbt;
   dbt->start_index_time=g_date_time_new_now_local();
-  g_message("restoring index: %s.%s", dbt->database->name, dbt->table);
-  process_job(td, job, NULL);
+  g_message("restoring index: %s.%s. Indexes: %u | Estimated cost: %"G_GUINT64_FORMAT" MB", dbt->database->name, dbt->table, ib->indexes, ib->cost);
+  trace_event_begin("index", "%s.%s", dbt->database->real_database, dbt->real_table);
+  process_job(td, ib->job, NULL);
+  trace_event_end();
   dbt->finish_time=g_date_time_new_now_local();
+  g_mutex_lock(index_build_mutex);
+  running_index_builds--;
+  running_index_cost-=ib->cost;
+  g_mutex_unlock(index_build_mutex);
+  g_message("Index build on %s.%s completed. Indexes: %u | Time: %.2f seconds", dbt->database->name, dbt->table, ib->indexes,
+            (gdouble)g_date_time_difference(dbt->finish_time, dbt->start_index_time) / G_TIME_SPAN_SECOND);
   g_mutex_lock(dbt->mutex);
   dbt->schema_state=ALL_DONE;
   g_mutex_unlock(dbt->mutex);
+  g_free(ib);
   return TRUE;
 }
 
@@ -16,6 +16,15 @@
 */
 #include "myloader.h"
 
+#define INDEX_COST_BYTES_PER_ROW 100
+
+struct index_build {
+  struct control_job *job;
+  struct db_table *dbt;
+  guint indexes;
+  guint64 cost;
+};
+
 void initialize_worker_index(struct configuration *conf);
 void wait_index_worker_to_finish();
 void create_index_shutdown_job(struct configuration *conf);
@@ -109,11 +109,18 @@ void *process_loader_thread(struct thread_data * td) {
   struct restore_job *rj=NULL;
 //  guint pass=0;
   struct db_table * dbt = NULL;
+  guint range=0;
+  gint64 start_time=0;
   while (cont){
     // control job threads needs to know that I'm ready to receive another job
     trace("refresh_db_queue <- %s", ft2str(THREAD));
     g_async_queue_push(refresh_db_queue, GINT_TO_POINTER(THREAD));
+    start_time=metrics_enabled?g_get_monotonic_time():0;
+    metrics_thread_state(THREAD_STATE_QUEUE);
     ft=(enum file_type)GPOINTER_TO_INT(g_async_queue_pop(here_is_your_job));
+    metrics_thread_state(THREAD_STATE_OTHER);
+    if (metrics_enabled)
+      metrics_observe(METRICS_QUEUE_WAIT, g_get_monotonic_time() - start_time);
     trace("here_is_your_job -> %s", ft2str(ft));
     switch (ft){
     case DATA:
@@ -122,13 +129,12 @@ void *process_loader_thread(struct thread_data * td) {
       trace("data_queue -> %s: %s.%s, threads %u", rjtype2str(rj->type), dbt->database->real_database, dbt->real_table, dbt->current_threads);
       job=new_control_job(JOB_RESTORE,rj, dbt->database);
       td->dbt=dbt;
+      // rj is freed by process_job()
+      range=rj->data.drj->range;
 //      td->use_database=job->use_database;
 //      execute_use_if_needs_to(&(td->connection_data), job->use_database, "Restoring tables (2)");
       cont=process_job(td, job, NULL);
-      g_mutex_lock(dbt->mutex);
-      dbt->current_threads--;
-      trace("%s.%s: done job, threads %u", dbt->database->real_database, dbt->real_table, dbt->current_threads);
-      g_mutex_unlock(dbt->mutex);
+      data_job_finished(td->conf, dbt, range);
       break;
     case SHUTDOWN:
       cont=FALSE;
@@ -153,6 +159,7 @@ void *loader_thread(struct thread_data *td) {
   g_async_queue_push(conf->ready, GINT_TO_POINTER(1));
 
   set_thread_name("T%02u", td->thread_id);
+  metrics_register_thread("T%02u", td->thread_id);
   trace("Thread %u: Starting import", td->thread_id);
   process_loader_thread(td);
 
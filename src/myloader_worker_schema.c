@@ -24,6 +24,7 @@
 #include "common.h"
 #include "server_detect.h"
 #include "myloader.h"
+#include "trace_file.h"
 #include "myloader_common.h"
 #include "myloader_process.h"
 //#include "myloader_jobs_manager.h"
@@ -39,6 +40,7 @@
 /* refresh_db_queue2 is for schemas creation */
 GAsyncQueue *refresh_db_queue2 = NULL;
 struct thread_data *schema_td = NULL;
+guint schema_batch_size = 0;
 
 void schema_queue_push(enum file_type current_ft){
   trace("refresh_db_queue2 <- %s", ft2str(current_ft));
@@ -80,14 +82,210 @@ void set_table_schema_state_to_created (struct configuration *conf){
   while (iter != NULL){
     dbt=iter->data;
     g_mutex_lock(dbt->mutex);
-    if (dbt->schema_state == NOT_FOUND )
+    if (dbt->schema_state == NOT_FOUND ){
       dbt->schema_state = CREATED;
+      update_table_in_ready_queue(dbt);
+    }
     g_mutex_unlock(dbt->mutex);
     iter=iter->next;
   }
   g_mutex_unlock(conf->table_list_mutex);
 }
 
+/* @return FALSE when the job was a JOB_SHUTDOWN */
+static
+gboolean process_table_queue_job(struct thread_data *td, struct control_job *job, enum file_type ft, const char *qname){
+  const gboolean restore= (job->type == JOB_RESTORE);
+  gboolean retry= FALSE;
+  gboolean ret=TRUE;
+  char *filename=NULL;
+  if (restore) {
+    filename= job->data.restore_job->filename;
+//    execute_use_if_needs_to(&(td->connection_data), job->use_database, "Restoring table structure");
+    trace("%s -> %s: %s", qname, ft2str(ft), filename);
+  } else
+    trace("%s -> %s", qname, jtype2str(job->type));
+  ret= process_job(td, job, &retry);
+  if (retry) {
+    g_assert(restore);
+    trace("retry_queue <- %s: %s", ft2str(ft), filename);
+    g_async_queue_push(td->conf->retry_queue, job);
+    refresh_db_and_jobs(ft);
+    return ret;
+  }
+  if (ft == SCHEMA_TABLE) { /* TODO: for spoof view table don't do DATA */
+    refresh_db_and_jobs(DATA);
+  } else if (restore) {
+    g_assert(ft == SCHEMA_SEQUENCE && sequences_processed < sequences);
+    g_mutex_lock(&sequences_mutex);
+    ++sequences_processed;
+    trace("Processed sequence: %s (%u of %u)", filename, sequences_processed, sequences);
+    g_mutex_unlock(&sequences_mutex);
+  }
+  return ret;
+}
+
+/*
+  Schema batches: with --schema-batch-size the CREATE TABLE jobs of the same
+  database that are already in table_queue are sent in a single multi
+  statement round trip. Every job in table_queue has its own SCHEMA_TABLE
+  token in refresh_db_queue2, so the tokens of the jobs taken by a batch are
+  counted in batched_tokens and skipped when they are popped.
+  A job is taken by a batch and counted under batched_tokens_mutex, and a
+  token either skips or takes its job under the same mutex, so a thread never
+  waits on table_queue for a job that a batch already took.
+*/
+static GMutex batched_tokens_mutex;
+static guint batched_tokens=0;
+
+static
+struct control_job *take_table_queue_job(struct thread_data *td){
+  struct control_job *job=NULL;
+  g_mutex_lock(&batched_tokens_mutex);
+  if (batched_tokens > 0){
+    // Its job was already created in a batch
+    batched_tokens--;
+    g_mutex_unlock(&batched_tokens_mutex);
+    return NULL;
+  }
+  job=g_async_queue_try_pop(td->conf->table_queue);
+  g_mutex_unlock(&batched_tokens_mutex);
+  if (job == NULL)
+    job=g_async_queue_pop(td->conf->table_queue);
+  return job;
+}
+
+static
+struct control_job *take_job_for_batch(struct thread_data *td){
+  struct control_job *job=NULL;
+  g_mutex_lock(&batched_tokens_mutex);
+  job=g_async_queue_try_pop(td->conf->table_queue);
+  if (job)
+    batched_tokens++;
+  g_mutex_unlock(&batched_tokens_mutex);
+  return job;
+}
+
+/* A JOB_SHUTDOWN is delayed while there are jobs to retry */
+static
+struct control_job *retry_before_shutdown(struct thread_data *td, struct control_job *job, const char **qname){
+  struct control_job *rjob=NULL;
+  *qname= "table_queue";
+  if (job->type == JOB_SHUTDOWN) {
+    rjob= g_async_queue_try_pop(td->conf->retry_queue);
+    if (rjob) {
+      g_async_queue_push(td->conf->table_queue, job);
+      *qname= "retry_queue";
+      return rjob;
+    }
+  }
+  return job;
+}
+
+static
+gboolean is_batchable(struct control_job *job){
+  if (job->type != JOB_RESTORE)
+    return FALSE;
+  struct restore_job *rj=job->data.restore_job;
+  if (rj->type != JOB_TO_CREATE_TABLE)
+    return FALSE;
+  // Overwrite and serialized creation need the per table path
+  return !overwrite_tables && !serial_tbl_creation && !no_schemas && !rj->dbt->object_to_export.no_schema &&
+         (!source_db || g_strcmp0(rj->dbt->database->name,source_db)==0);
+}
+
+static
+guint append_statements_to_batch(GString *batch, GString *statement){
+  guint n=0, i;
+  gchar** line=g_strsplit(statement->str, ";\n", -1);
+  for (i=0; line[i] != NULL; i++){
+    // Same split than restore_data_in_gstring()
+    if (strlen(line[i])>2){
+      g_string_append(batch, line[i]);
+      g_string_append(batch, ";\n");
+      n++;
+    }
+  }
+  g_strfreev(line);
+  return n;
+}
+
+/*
+  The first job that can not be in the batch is kept and processed after the
+  batch, as pushing it back would send it to the tail of table_queue. Only
+  tables are in table_queue at this point, as they are queued once all the
+  sequences are created, so its token is a SCHEMA_TABLE one.
+  @return FALSE when that job was a JOB_SHUTDOWN
+*/
+static
+gboolean process_schema_batch(struct thread_data *td, struct control_job *first){
+  GPtrArray *jobs=g_ptr_array_new();
+  struct database *database=first->data.restore_job->data.srj->database;
+  struct control_job *job=first, *next=NULL;
+  struct restore_job *rj=NULL;
+  const char *qname=NULL;
+  guint *statements_per_job=NULL;
+  guint i, executed=0, done=0, error_number=0, total=0;
+  gboolean ret=TRUE;
+  gchar *error=NULL;
+
+  g_ptr_array_add(jobs, first);
+  while (jobs->len < schema_batch_size && (job=take_job_for_batch(td)) != NULL){
+    if (!is_batchable(job) || job->data.restore_job->data.srj->database != database){
+      next=job;
+      break;
+    }
+    g_ptr_array_add(jobs, job);
+  }
+
+  GString *batch=g_string_sized_new(jobs->len * 1024);
+  statements_per_job=g_new(guint, jobs->len);
+  for (i=0; i<jobs->len; i++){
+    rj=((struct control_job *)g_ptr_array_index(jobs, i))->data.restore_job;
+    g_mutex_lock(rj->dbt->mutex);
+    rj->dbt->schema_state=CREATING;
+    g_mutex_unlock(rj->dbt->mutex);
+    statements_per_job[i]=append_statements_to_batch(batch, rj->data.srj->statement);
+  }
+  message("Thread %d: Creating %u tables on %s in one batch", td->thread_id, jobs->len, database->real_database);
+  trace_event_begin("schema", "batch of %u tables on %s", jobs->len, database->real_database);
+  if (restore_schema_batch(td, batch, database, &executed, &error_number, &error))
+    g_warning("Thread %d: Batch of %u tables on %s stopped after %u statements. ERROR %u: %s", td->thread_id, jobs->len, database->real_database, executed, error_number, error);
+  trace_event_end();
+  g_free(error);
+
+  for (i=0; i<jobs->len; i++){
+    job=g_ptr_array_index(jobs, i);
+    rj=job->data.restore_job;
+    if (done + statements_per_job[i] > executed){
+      // The batch failed here, this table and the next ones follow the per table path, which reports and retries each statement
+      g_mutex_lock(rj->dbt->mutex);
+      rj->dbt->schema_state=NOT_CREATED;
+      g_mutex_unlock(rj->dbt->mutex);
+      process_table_queue_job(td, job, SCHEMA_TABLE, "batch");
+      continue;
+    }
+    done+=statements_per_job[i];
+    g_mutex_lock(rj->dbt->mutex);
+    rj->dbt->schema_state=CREATED;
+    update_table_in_ready_queue(rj->dbt);
+    g_mutex_unlock(rj->dbt->mutex);
+    get_total_created(td->conf, &total);
+    message("Thread %d: Table %s.%s created. Tables that pass created stage: %d of %d", td->thread_id, rj->dbt->database->real_database, rj->dbt->real_table, total , g_hash_table_size(td->conf->table_hash));
+    free_schema_restore_job(rj->data.srj);
+    g_free(job);
+    refresh_db_and_jobs(DATA);
+  }
+  g_free(statements_per_job);
+  g_string_free(batch, TRUE);
+  g_ptr_array_free(jobs, TRUE);
+  if (next){
+    next=retry_before_shutdown(td, next, &qname);
+    ret=process_table_queue_job(td, next, SCHEMA_TABLE, qname);
+  }
+  return ret;
+}
+
 gboolean second_round=FALSE;
 /* @return TRUE: continue worker_schema_thread() loop */
 gboolean process_schema(struct thread_data * td){
@@ -120,42 +318,18 @@ gboolean process_schema(struct thread_data * td){
     case SCHEMA_TABLE:
     case SCHEMA_SEQUENCE: {
       const char *qname;
-      job= g_async_queue_pop(td->conf->table_queue);
-      qname= "table_queue";
-      if (job->type == JOB_SHUTDOWN) {
-        struct control_job *rjob= g_async_queue_try_pop(td->conf->retry_queue);
-        if (rjob) {
-          g_async_queue_push(td->conf->table_queue, job);
-          job= rjob;
-          qname= "retry_queue";
-        }
-      }
-      const gboolean restore= (job->type == JOB_RESTORE);
-      gboolean retry= FALSE;
-      char *filename;
-      if (restore) {
-        filename= job->data.restore_job->filename;
-//        execute_use_if_needs_to(&(td->connection_data), job->use_database, "Restoring table structure");
-        trace("%s -> %s: %s", qname, ft2str(ft), filename);
-      } else
-        trace("%s -> %s", qname, jtype2str(job->type));
-      ret= process_job(td, job, &retry);
-      if (retry) {
-        g_assert(restore);
-        trace("retry_queue <- %s: %s", ft2str(ft), filename);
-        g_async_queue_push(td->conf->retry_queue, job);
-        refresh_db_and_jobs(ft);
+      if (ft == SCHEMA_TABLE){
+        job= take_table_queue_job(td);
+        if (job == NULL)
+          break;
+      }else
+        job= g_async_queue_pop(td->conf->table_queue);
+      job= retry_before_shutdown(td, job, &qname);
+      if (schema_batch_size > 1 && ft != SCHEMA_SEQUENCE && is_batchable(job)) {
+        ret= process_schema_batch(td, job);
         break;
       }
-      if (ft == SCHEMA_TABLE) { /* TODO: for spoof view table don't do DATA */
-        refresh_db_and_jobs(DATA);
-      } else if (restore) {
-        g_assert(ft == SCHEMA_SEQUENCE && sequences_processed < sequences);
-        g_mutex_lock(&sequences_mutex);
-        ++sequences_processed;
-        trace("Processed sequence: %s (%u of %u)", filename, sequences_processed, sequences);
-        g_mutex_unlock(&sequences_mutex);
-      }
+      ret= process_table_queue_job(td, job, ft, qname);
       break;
     }
     case INTERMEDIATE_ENDED:
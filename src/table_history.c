@@ -0,0 +1,205 @@
+/*
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+        Authors:    David Ducos, Percona (david dot ducos at percona dot com)
+*/
+#include <glib.h>
+#include <string.h>
+#include "table_history.h"
+
+/*
+  Statistics of the tables in the previous runs, for --history-file.
+
+  The file is a key file with a [program `database`.`table`] group per table
+  and program, with the rows, the bytes, the seconds spent on its data jobs
+  and the last integer chunk step. mydumper and myloader can share the file:
+  each one loads its own groups before a run, and at the end it rewrites its
+  groups with the tables of the run. The tables that were not part of it and
+  the groups of the other program are kept as they were.
+*/
+
+gchar *history_file = NULL;
+
+static GMutex *history_mutex = NULL;
+static GHashTable *history = NULL;
+static GHashTable *current = NULL;
+static const gchar *history_program = NULL;
+static gdouble total_seconds = 0;
+static guint64 total_bytes = 0;
+
+/* The group of a table, the key of history and current prefixed by the program */
+static
+gchar *get_history_group(const gchar *key){
+  return g_strdup_printf("%s %s", history_program, key);
+}
+
+/* The key of the group of a table of this program, NULL for the other groups */
+static
+const gchar *get_history_key(const gchar *group){
+  gsize length=strlen(history_program);
+  if (strncmp(group, history_program, length) || group[length] != ' ')
+    return NULL;
+  return group + length + 1;
+}
+
+void load_history(const gchar *program){
+  GKeyFile *kf=NULL;
+  GError *error=NULL;
+  gchar **groups=NULL;
+  const gchar *key=NULL;
+  struct table_history *th=NULL;
+  guint i;
+  if (history_file == NULL)
+    return;
+  if (history_mutex == NULL)
+    history_mutex=g_mutex_new();
+  // In daemon mode, every run loads what the previous one saved
+  if (history != NULL){
+    g_hash_table_unref(history);
+    g_hash_table_unref(current);
+  }
+  history=g_hash_table_new_full(g_str_hash, g_str_equal, &g_free, &g_free);
+  current=g_hash_table_new_full(g_str_hash, g_str_equal, &g_free, &g_free);
+  history_program=program;
+  total_seconds=0;
+  total_bytes=0;
+  if (!g_file_test(history_file, G_FILE_TEST_EXISTS)){
+    g_message("History file %s not found, it will be created at the end", history_file);
+    return;
+  }
+  kf=g_key_file_new();
+  if (!g_key_file_load_from_file(kf, history_file, G_KEY_FILE_NONE, &error)){
+    g_warning("Could not load the history file %s: %s", history_file, error->message);
+    g_error_free(error);
+    g_key_file_free(kf);
+    return;
+  }
+  groups=g_key_file_get_groups(kf, NULL);
+  for (i=0; groups[i] != NULL; i++){
+    if ((key=get_history_key(groups[i])) == NULL)
+      continue;
+    th=g_new0(struct table_history, 1);
+    th->rows=g_key_file_get_uint64(kf, groups[i], "rows", NULL);
+    th->bytes=g_key_file_get_uint64(kf, groups[i], "bytes", NULL);
+    th->seconds=g_key_file_get_double(kf, groups[i], "seconds", NULL);
+    th->step=g_key_file_get_uint64(kf, groups[i], "step", NULL);
+    th->runs=g_key_file_get_integer(kf, groups[i], "runs", NULL);
+    total_seconds+=th->seconds;
+    total_bytes+=th->bytes;
+    g_hash_table_insert(history, g_strdup(key), th);
+  }
+  g_message("Loaded the %s history of %u tables from %s", program, g_hash_table_size(history), history_file);
+  g_strfreev(groups);
+  g_key_file_free(kf);
+}
+
+struct table_history *get_table_history(const gchar *database, const gchar *table){
+  if (history == NULL)
+    return NULL;
+  gchar *key=g_strdup_printf("`%s`.`%s`", database, table);
+  struct table_history *th=g_hash_table_lookup(history, key);
+  g_free(key);
+  return th;
+}
+
+/* Share of the time of the last runs that was spent on the table */
+gdouble get_history_share(struct table_history *th){
+  if (th == NULL || total_seconds <= 0)
+    return 0;
+  return th->seconds / total_seconds;
+}
+
+/* How much slower than the average byte the bytes of the table were, between 0.1 and 10 */
+gdouble get_history_cost_factor(struct table_history *th){
+  gdouble factor;
+  if (th == NULL || th->bytes == 0 || th->seconds <= 0 || total_seconds <= 0 || total_bytes == 0)
+    return 1;
+  factor=(th->seconds / th->bytes) / (total_seconds / total_bytes);
+  return factor < 0.1 ? 0.1 : factor > 10 ? 10 : factor;
+}
+
+void update_table_history(const gchar *database, const gchar *table, guint64 rows, guint64 bytes, gdouble seconds, guint64 step){
+  if (current == NULL)
+    return;
+  struct table_history *th=g_new0(struct table_history, 1);
+  struct table_history *previous=get_table_history(database, table);
+  th->rows=rows;
+  th->bytes=bytes;
+  th->seconds=seconds;
+  th->step=step;
+  th->runs=previous ? previous->runs + 1 : 1;
+  g_mutex_lock(history_mutex);
+  g_hash_table_replace(current, g_strdup_printf("`%s`.`%s`", database, table), th);
+  g_mutex_unlock(history_mutex);
+}
+
+static
+void set_table_history(GKeyFile *kf, const gchar *group, struct table_history *th){
+  g_key_file_set_uint64(kf, group, "rows", th->rows);
+  g_key_file_set_uint64(kf, group, "bytes", th->bytes);
+  g_key_file_set_double(kf, group, "seconds", th->seconds);
+  g_key_file_set_uint64(kf, group, "rows_per_second", th->seconds > 0 ? (guint64)(th->rows / th->seconds) : 0);
+  g_key_file_set_uint64(kf, group, "step", th->step);
+  g_key_file_set_integer(kf, group, "runs", th->runs);
+}
+
+static
+void set_history_group(GKeyFile *kf, const gchar *key, struct table_history *th){
+  gchar *group=get_history_group(key);
+  set_table_history(kf, group, th);
+  g_free(group);
+}
+
+void save_history(){
+  GKeyFile *kf=NULL;
+  GHashTableIter iter;
+  gchar *key=NULL, *data=NULL, **groups=NULL;
+  struct table_history *th=NULL;
+  GError *error=NULL;
+  gsize length=0;
+  guint i;
+  if (history_file == NULL || current == NULL)
+    return;
+  kf=g_key_file_new();
+  // The file is read again, to keep what the other program saved in the meantime
+  if (g_file_test(history_file, G_FILE_TEST_EXISTS) &&
+      !g_key_file_load_from_file(kf, history_file, G_KEY_FILE_KEEP_COMMENTS, &error)){
+    g_warning("Could not load the history file %s, it is not overwritten: %s", history_file, error->message);
+    g_error_free(error);
+    g_key_file_free(kf);
+    return;
+  }
+  groups=g_key_file_get_groups(kf, NULL);
+  for (i=0; groups[i] != NULL; i++)
+    if (get_history_key(groups[i]) != NULL)
+      g_key_file_remove_group(kf, groups[i], NULL);
+  g_strfreev(groups);
+  g_mutex_lock(history_mutex);
+  g_hash_table_iter_init(&iter, history);
+  while (g_hash_table_iter_next(&iter, (gpointer *) &key, (gpointer *) &th))
+    if (g_hash_table_lookup(current, key) == NULL)
+      set_history_group(kf, key, th);
+  g_hash_table_iter_init(&iter, current);
+  while (g_hash_table_iter_next(&iter, (gpointer *) &key, (gpointer *) &th))
+    set_history_group(kf, key, th);
+  g_mutex_unlock(history_mutex);
+  data=g_key_file_to_data(kf, &length, NULL);
+  if (!g_file_set_contents(history_file, data, length, &error)){
+    g_warning("Could not write the history file %s: %s", history_file, error->message);
+    g_error_free(error);
+  }else
+    g_message("%s history of %u tables saved in %s", history_program, g_hash_table_size(current), history_file);
+  g_free(data);
+  g_key_file_free(kf);
+}
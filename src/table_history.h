@@ -0,0 +1,39 @@
+/*
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+        Authors:    David Ducos, Percona (david dot ducos at percona dot com)
+*/
+#ifndef _src_table_history_h
+#define _src_table_history_h
+#include <glib.h>
+
+struct table_history {
+  guint64 rows;
+  guint64 bytes;
+  // Time of the data jobs of the table, summed over its threads
+  gdouble seconds;
+  // Last integer chunk step, 0 when the table was not split by integer
+  guint64 step;
+  guint runs;
+};
+
+extern gchar *history_file;
+
+void load_history(const gchar *program);
+struct table_history *get_table_history(const gchar *database, const gchar *table);
+gdouble get_history_share(struct table_history *th);
+gdouble get_history_cost_factor(struct table_history *th);
+void update_table_history(const gchar *database, const gchar *table, guint64 rows, guint64 bytes, gdouble seconds, guint64 step);
+void save_history();
+#endif
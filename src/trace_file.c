@@ -0,0 +1,233 @@
+/*
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+        Authors:    David Ducos, Percona (david dot ducos at percona dot com)
+*/
+#include <mysql.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <errno.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "common.h"
+#include "trace_file.h"
+
+/*
+  Job timeline in Chrome trace format, which can be opened with Perfetto or
+  chrome://tracing.
+
+  Every thread appends its begin and end events to its own ring buffer, the
+  owner is the only writer of head and the flush thread is the only writer of
+  tail, so no lock is needed to record an event. The flush thread writes the
+  pending events every TRACE_FLUSH_INTERVAL microseconds. When a ring is full
+  the owner waits for the flush thread, as dropping an event would unbalance
+  the begin and end pairs.
+*/
+
+gchar *trace_file = NULL;
+
+struct trace_event {
+  gint64 ts;
+  gchar phase;
+  const gchar *category;
+  gchar *name;
+};
+
+struct trace_ring {
+  guint tid;
+  gchar *thread_name;
+  gboolean described;
+  gint head;
+  gint tail;
+  struct trace_event events[TRACE_RING_SIZE];
+};
+
+static gboolean trace_events_enabled = FALSE;
+static FILE *trace_output = NULL;
+static gboolean first_event = TRUE;
+static gint64 trace_start = 0;
+static GMutex *rings_mutex = NULL;
+static GPtrArray *rings = NULL;
+static GThread *flush_t = NULL;
+static GAsyncQueue *flush_stop = NULL;
+static __thread struct trace_ring *current_ring = NULL;
+
+static inline
+gint64 now_ns(){
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (gint64)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static
+void write_json_string(const gchar *str){
+  const gchar *c;
+  fputc('"', trace_output);
+  for (c=str; *c; c++){
+    if (*c == '"' || *c == '\\')
+      fprintf(trace_output, "\\%c", *c);
+    else if ((guchar)*c < 0x20)
+      fprintf(trace_output, "\\u%04x", (guchar)*c);
+    else
+      fputc(*c, trace_output);
+  }
+  fputc('"', trace_output);
+}
+
+static
+void write_separator(){
+  if (first_event)
+    first_event=FALSE;
+  else
+    fputs(",\n", trace_output);
+}
+
+static
+void write_thread_name(struct trace_ring *ring){
+  write_separator();
+  fprintf(trace_output, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%u,\"args\":{\"name\":", getpid(), ring->tid);
+  write_json_string(ring->thread_name);
+  fputs("}}", trace_output);
+}
+
+static
+void write_event(struct trace_ring *ring, struct trace_event *e){
+  write_separator();
+  // The timestamps are in microseconds, the decimals keep the nanoseconds
+  fprintf(trace_output, "{\"ph\":\"%c\",\"ts\":%"G_GINT64_FORMAT".%03d,\"pid\":%d,\"tid\":%u",
+          e->phase, e->ts / 1000, (gint)(e->ts % 1000), getpid(), ring->tid);
+  if (e->name){
+    fputs(",\"cat\":", trace_output);
+    write_json_string(e->category);
+    fputs(",\"name\":", trace_output);
+    write_json_string(e->name);
+  }
+  fputc('}', trace_output);
+}
+
+static
+void flush_rings(){
+  struct trace_ring *ring=NULL;
+  guint i;
+  gint head, tail;
+  g_mutex_lock(rings_mutex);
+  for (i=0; i<rings->len; i++){
+    ring=g_ptr_array_index(rings, i);
+    if (!ring->described){
+      write_thread_name(ring);
+      ring->described=TRUE;
+    }
+    head=g_atomic_int_get(&(ring->head));
+    for (tail=ring->tail; tail != head; tail++){
+      struct trace_event *e=&(ring->events[(guint)tail % TRACE_RING_SIZE]);
+      write_event(ring, e);
+      g_free(e->name);
+      e->name=NULL;
+    }
+    g_atomic_int_set(&(ring->tail), tail);
+  }
+  g_mutex_unlock(rings_mutex);
+  fflush(trace_output);
+}
+
+static
+void *flush_thread(void *data){
+  (void) data;
+  set_thread_name("TRC");
+  while (g_async_queue_timeout_pop(flush_stop, TRACE_FLUSH_INTERVAL) == NULL)
+    flush_rings();
+  flush_rings();
+  return NULL;
+}
+
+static
+struct trace_ring *get_current_ring(){
+  if (current_ring == NULL){
+    struct trace_ring *ring=g_new0(struct trace_ring, 1);
+    const gchar *name=get_thread_name();
+    g_mutex_lock(rings_mutex);
+    ring->tid=rings->len + 1;
+    ring->thread_name=name ? g_strdup(name) : g_strdup_printf("thread %u", ring->tid);
+    g_ptr_array_add(rings, ring);
+    g_mutex_unlock(rings_mutex);
+    current_ring=ring;
+  }
+  return current_ring;
+}
+
+static
+void push_event(gchar phase, const gchar *category, gchar *name){
+  struct trace_ring *ring=get_current_ring();
+  gint head=ring->head;
+  while ((guint)(head - g_atomic_int_get(&(ring->tail))) >= TRACE_RING_SIZE)
+    g_usleep(1000);
+  struct trace_event *e=&(ring->events[(guint)head % TRACE_RING_SIZE]);
+  e->ts=now_ns() - trace_start;
+  e->phase=phase;
+  e->category=category;
+  e->name=name;
+  // Publishes the event to the flush thread
+  g_atomic_int_set(&(ring->head), head + 1);
+}
+
+void trace_event_begin(const gchar *category, const char *format, ...){
+  if (!trace_events_enabled)
+    return;
+  va_list args;
+  va_start(args, format);
+  gchar *name=g_strdup_vprintf(format, args);
+  va_end(args);
+  push_event('B', category, name);
+}
+
+void trace_event_end(){
+  if (!trace_events_enabled)
+    return;
+  push_event('E', NULL, NULL);
+}
+
+void initialize_trace_file(const gchar *program){
+  if (trace_file == NULL)
+    return;
+  trace_output=g_fopen(trace_file, "w");
+  if (trace_output == NULL)
+    m_critical("Could not open trace file %s: %s", trace_file, g_strerror(errno));
+  fputs("[\n", trace_output);
+  write_separator();
+  fprintf(trace_output, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"args\":{\"name\":", getpid());
+  write_json_string(program);
+  fputs("}}", trace_output);
+  trace_start=now_ns();
+  rings_mutex=g_mutex_new();
+  rings=g_ptr_array_new();
+  flush_stop=g_async_queue_new();
+  trace_events_enabled=TRUE;
+  flush_t=g_thread_new("trace_file", (GThreadFunc)flush_thread, NULL);
+  g_message("Writing the job timeline into %s", trace_file);
+}
+
+/* Events recorded after this are ignored */
+void finish_trace_file(){
+  if (!trace_events_enabled)
+    return;
+  trace_events_enabled=FALSE;
+  g_async_queue_push(flush_stop, GINT_TO_POINTER(1));
+  g_thread_join(flush_t);
+  fputs("\n]\n", trace_output);
+  fclose(trace_output);
+  trace_output=NULL;
+}
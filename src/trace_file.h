@@ -0,0 +1,30 @@
+/*
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+        Authors:    David Ducos, Percona (david dot ducos at percona dot com)
+*/
+#ifndef _src_trace_file_h
+#define _src_trace_file_h
+#include <glib.h>
+
+#define TRACE_RING_SIZE 4096
+#define TRACE_FLUSH_INTERVAL 200000
+
+extern gchar *trace_file;
+
+void initialize_trace_file(const gchar *program);
+void finish_trace_file();
+void trace_event_begin(const gchar *category, const char *format, ...);
+void trace_event_end();
+#endif
@@ -0,0 +1,47 @@
+/*
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+        Authors:    David Ducos, Percona (david dot ducos at percona dot com)
+*/
+#ifndef _src_tracepoints_h
+#define _src_tracepoints_h
+#include "config.h"
+
+/*
+  USDT probes, for bpftrace, perf or SystemTap on a production binary:
+
+    bpftrace -e 'usdt:./mydumper:mydumper:chunk__query__end { @[str(arg1), str(arg2)] = sum(arg3); }'
+
+  A probe is a single nop in the code and a note in the ELF, the tracer
+  replaces the nop with a breakpoint when it attaches. The arguments must be
+  values that are already at hand, as they are evaluated even when no tracer
+  is attached. Without sys/sdt.h, or with -DWITH_USDT=OFF, they compile to
+  nothing.
+*/
+#ifdef WITH_USDT
+#include <sys/sdt.h>
+#define TRACEPOINT(provider, name) DTRACE_PROBE(provider, name)
+#define TRACEPOINT1(provider, name, a1) DTRACE_PROBE1(provider, name, a1)
+#define TRACEPOINT2(provider, name, a1, a2) DTRACE_PROBE2(provider, name, a1, a2)
+#define TRACEPOINT3(provider, name, a1, a2, a3) DTRACE_PROBE3(provider, name, a1, a2, a3)
+#define TRACEPOINT4(provider, name, a1, a2, a3, a4) DTRACE_PROBE4(provider, name, a1, a2, a3, a4)
+#else
+// The arguments are still referenced, so the variables kept for the probes are not unused
+#define TRACEPOINT(provider, name) do {} while (0)
+#define TRACEPOINT1(provider, name, a1) do { (void)(a1); } while (0)
+#define TRACEPOINT2(provider, name, a1, a2) do { (void)(a1); (void)(a2); } while (0)
+#define TRACEPOINT3(provider, name, a1, a2, a3) do { (void)(a1); (void)(a2); (void)(a3); } while (0)
+#define TRACEPOINT4(provider, name, a1, a2, a3, a4) do { (void)(a1); (void)(a2); (void)(a3); (void)(a4); } while (0)
+#endif
+#endif
@@ -0,0 +1,384 @@
+/*
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+        Authors:    David Ducos, Percona (david dot ducos at percona dot com)
+*/
+#include <mysql.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include "common.h"
+#include "myloader.h"
+#include "myloader_global.h"
+#include "myloader_common.h"
+#include "myloader_process.h"
+#include "myloader_restore.h"
+#include "myloader_restore_job.h"
+#include "myloader_sorted_ingest.h"
+#include "myloader_memory.h"
+
+/*
+  Tests of the myloader code that does not need a server: the pieces of the
+  split data files, the key ranges of --sorted-ingest and the release of the
+  memory accounted to the stream files. They are linked with the sources of
+  myloader like the benchmarks, and run with ctest.
+*/
+
+#define TEST_HEADER_STATEMENTS 3
+
+struct split_file {
+  gchar *path;
+  guint64 size;
+  GPtrArray *inserts;
+};
+
+/* Same layout than mydumper: the header, then one row per line, with the new lines escaped */
+static
+struct split_file *new_split_file(){
+  struct split_file *sf=g_new0(struct split_file, 1);
+  GString *content=g_string_new(
+      "/*!40101 SET NAMES binary*/;\n"
+      "/*!40014 SET FOREIGN_KEY_CHECKS=0*/;\n"
+      "/*!40103 SET TIME_ZONE='+00:00' */;\n");
+  GString *statement=g_string_new("");
+  GError *error=NULL;
+  guint s, r, id=0;
+  gint fd=g_file_open_tmp("myloader_test_XXXXXX.sql", &(sf->path), &error);
+  g_assert_no_error(error);
+  close(fd);
+  sf->inserts=g_ptr_array_new_with_free_func(g_free);
+  for (s=0; s<40; s++){
+    g_string_assign(statement, s % 3 ? "INSERT INTO `t` VALUES" : "REPLACE INTO `t` VALUES");
+    // From one row up to 7, the values look like the start of a statement
+    for (r=0; r <= s % 7; r++, id++)
+      g_string_append_printf(statement, "%s(%u,'INSERT INTO `t` VALUES\\n%u;\\n')", r ? "\n," : "", id, id);
+    g_string_append(statement, ";\n");
+    g_ptr_array_add(sf->inserts, g_strdup(statement->str));
+    g_string_append(content, statement->str);
+  }
+  g_file_set_contents(sf->path, content->str, content->len, &error);
+  g_assert_no_error(error);
+  sf->size=content->len;
+  g_string_free(statement, TRUE);
+  g_string_free(content, TRUE);
+  return sf;
+}
+
+static
+void free_split_file(struct split_file *sf){
+  g_remove(sf->path);
+  g_free(sf->path);
+  g_ptr_array_free(sf->inserts, TRUE);
+  g_free(sf);
+}
+
+/* The same loop than restore_data_from_file_internal(), the statements are collected instead of sent */
+static
+void read_piece(struct split_file *sf, guint64 start, guint64 end, GPtrArray *inserts){
+  FILE *infile=g_fopen(sf->path, "r");
+  GString *data=g_string_new("");
+  struct file_piece piece={ start, end, start > 0 };
+  gboolean eof=FALSE, data_read=FALSE;
+  guint line=0, header=0, previous_len=inserts->len;
+  g_assert_nonnull(infile);
+  while (!eof && read_piece_data(infile, data, &eof, &line, &piece, &data_read)){
+    g_assert_true(data_read);
+    if (g_strrstr(&data->str[data->len >= 5 ? data->len - 5 : 0], ";\n")){
+      if (g_str_has_prefix(data->str, "INSERT") || g_str_has_prefix(data->str, "REPLACE"))
+        g_ptr_array_add(inserts, g_strdup(data->str));
+      else
+        header++;
+      g_string_set_size(data, 0);
+    }
+  }
+  // The header of the file is executed once before the first INSERT of every piece
+  if (inserts->len > previous_len)
+    g_assert_cmpuint(header, ==, TEST_HEADER_STATEMENTS);
+  else
+    g_assert_cmpuint(header, <=, TEST_HEADER_STATEMENTS);
+  g_string_free(data, TRUE);
+  fclose(infile);
+}
+
+static
+void assert_same_inserts(GPtrArray *expected, GPtrArray *inserts){
+  guint i;
+  g_assert_cmpuint(inserts->len, ==, expected->len);
+  for (i=0; i<expected->len; i++)
+    g_assert_cmpstr(g_ptr_array_index(inserts, i), ==, g_ptr_array_index(expected, i));
+}
+
+/* Two pieces split at every offset of the file */
+static
+void test_split_file_every_boundary(){
+  struct split_file *sf=new_split_file();
+  GPtrArray *inserts=NULL;
+  guint64 boundary;
+  for (boundary=1; boundary < sf->size; boundary++){
+    inserts=g_ptr_array_new_with_free_func(g_free);
+    read_piece(sf, 0, boundary, inserts);
+    read_piece(sf, boundary, sf->size, inserts);
+    assert_same_inserts(sf->inserts, inserts);
+    g_ptr_array_free(inserts, TRUE);
+  }
+  free_split_file(sf);
+}
+
+/* The pieces of the same size that process_data_filename() enqueues */
+static
+void test_split_file_pieces(){
+  struct split_file *sf=new_split_file();
+  GPtrArray *inserts=NULL;
+  guint pieces, i;
+  guint64 piece_size, start;
+  for (pieces=1; pieces <= 64; pieces++){
+    inserts=g_ptr_array_new_with_free_func(g_free);
+    piece_size=(sf->size + pieces - 1) / pieces;
+    for (i=0; i < pieces; i++){
+      start=i * piece_size;
+      if (start < sf->size)
+        read_piece(sf, start, i + 1 < pieces ? start + piece_size : sf->size, inserts);
+    }
+    assert_same_inserts(sf->inserts, inserts);
+    g_ptr_array_free(inserts, TRUE);
+  }
+  free_split_file(sf);
+}
+
+static
+void test_seek_to_next_statement(){
+  struct split_file *sf=new_split_file();
+  FILE *infile=g_fopen(sf->path, "r");
+  GString *data=g_string_new("");
+  gboolean eof=FALSE;
+  guint line=0;
+  // The offset of the second statement, right after the header and the first one
+  guint64 second=sf->size;
+  guint i;
+  for (i=1; i < sf->inserts->len; i++)
+    second-=strlen(g_ptr_array_index(sf->inserts, i));
+  g_assert_true(seek_to_next_statement(infile, second, sf->size));
+  g_assert_cmpint(ftello(infile), ==, second);
+  g_assert_true(seek_to_next_statement(infile, second - 1, sf->size));
+  g_assert_cmpint(ftello(infile), ==, second);
+  // The first line of the next statement is found from the middle of the previous one
+  g_assert_true(seek_to_next_statement(infile, second - 10, sf->size));
+  read_data(infile, data, &eof, &line);
+  g_assert_true(g_str_has_prefix(g_ptr_array_index(sf->inserts, 1), data->str));
+  // There is no statement that starts in the last bytes of the file
+  g_assert_false(seek_to_next_statement(infile, sf->size - 3, sf->size));
+  g_string_free(data, TRUE);
+  fclose(infile);
+  free_split_file(sf);
+}
+
+static
+struct db_table *new_test_table(guint64 *sizes, guint jobs){
+  struct db_table *dbt=g_new0(struct db_table, 1);
+  struct restore_job *rj=NULL;
+  guint i;
+  dbt->database=g_new0(struct database, 1);
+  dbt->database->real_database=g_strdup("test");
+  dbt->real_table=g_strdup("t");
+  for (i=0; i<jobs; i++){
+    rj=g_new0(struct restore_job, 1);
+    rj->data.drj=g_new0(struct data_restore_job, 1);
+    rj->data.drj->size=sizes[i];
+    rj->data.drj->part=i;
+    dbt->restore_job_list=g_list_append(dbt->restore_job_list, rj);
+  }
+  dbt->restore_job_count=jobs;
+  return dbt;
+}
+
+static
+void free_test_table(struct db_table *dbt){
+  g_free(dbt->key_range_next);
+  g_free(dbt->key_range_busy);
+  g_free(dbt->database->real_database);
+  g_free(dbt->database);
+  g_free(dbt->real_table);
+  g_free(dbt);
+}
+
+/* With files of the same size, all_used says that every range gets files */
+static
+void check_key_ranges(guint64 *sizes, guint jobs, guint ranges, gboolean all_used){
+  struct db_table *dbt=new_test_table(sizes, jobs);
+  struct restore_job *rj=NULL;
+  GList *iter=NULL;
+  GQueue *running=g_queue_new();
+  guint64 *range_size=NULL, total=0, max_size=0;
+  guint i, previous=0, taken=0, *next_part=NULL, *range_running=NULL;
+  split_table_into_key_ranges(dbt, ranges);
+  g_assert_cmpuint(dbt->key_ranges, ==, MIN(MAX(ranges, 1), jobs));
+  range_size=g_new0(guint64, dbt->key_ranges);
+  // The ranges are contiguous and in the order of the list
+  for (iter=dbt->restore_job_list, i=0; iter != NULL; iter=iter->next, i++){
+    rj=iter->data;
+    g_assert_cmpuint(rj->data.drj->range, >=, previous);
+    g_assert_cmpuint(rj->data.drj->range, <=, previous + 1);
+    if (i == 0 || rj->data.drj->range != previous)
+      g_assert_true(dbt->key_range_next[rj->data.drj->range] == iter);
+    previous=rj->data.drj->range;
+    range_size[previous]+=sizes[i] + 1;
+    total+=sizes[i] + 1;
+    max_size=MAX(max_size, sizes[i] + 1);
+  }
+  if (all_used)
+    g_assert_cmpuint(previous, ==, dbt->key_ranges - 1);
+  // A range only goes over its share by less than one file
+  for (i=0; i<=previous; i++){
+    g_assert_cmpuint(range_size[i], >, 0);
+    g_assert_cmpuint(range_size[i], <=, total / dbt->key_ranges + max_size);
+  }
+  // One job per range at a time, in the order of the range
+  next_part=g_new0(guint, dbt->key_ranges);
+  range_running=g_new0(guint, dbt->key_ranges);
+  for (i=0; i<=previous; i++)
+    next_part[i]=((struct restore_job *)dbt->key_range_next[i]->data)->data.drj->part;
+  while (taken < jobs || !g_queue_is_empty(running)){
+    while (has_idle_key_range(dbt)){
+      rj=take_next_job_in_key_order(dbt);
+      g_assert_nonnull(rj);
+      g_assert_cmpuint(range_running[rj->data.drj->range], ==, 0);
+      g_assert_cmpuint(rj->data.drj->part, ==, next_part[rj->data.drj->range]);
+      range_running[rj->data.drj->range]++;
+      next_part[rj->data.drj->range]++;
+      g_queue_push_tail(running, rj);
+      taken++;
+    }
+    // The first job that was sent finishes
+    rj=g_queue_pop_head(running);
+    g_assert_nonnull(rj);
+    range_running[rj->data.drj->range]--;
+    key_range_job_finished(dbt, rj->data.drj->range);
+    g_free(rj->data.drj);
+    g_free(rj);
+  }
+  g_assert_null(dbt->restore_job_list);
+  g_queue_free(running);
+  g_free(range_running);
+  g_free(next_part);
+  g_free(range_size);
+  free_test_table(dbt);
+}
+
+static
+void test_key_ranges(){
+  guint64 equal[16], growing[16], skewed[16], empty[16];
+  guint i, ranges;
+  for (i=0; i<16; i++){
+    equal[i]=1000;
+    growing[i]=(i + 1) * 100;
+    skewed[i]=i == 3 ? 100000 : 10;
+    empty[i]=0;
+  }
+  for (ranges=0; ranges <= 20; ranges++){
+    check_key_ranges(equal, 16, ranges, TRUE);
+    check_key_ranges(growing, 16, ranges, FALSE);
+    check_key_ranges(skewed, 16, ranges, FALSE);
+    check_key_ranges(empty, 16, ranges, TRUE);
+    check_key_ranges(equal, 1, ranges, TRUE);
+  }
+}
+
+static
+guint64 get_memory_used(const gchar *name){
+  GString *content=g_string_new("");
+  gchar *key=g_strdup_printf("myloader_memory{name=\"%s\"} ", name);
+  gchar *value=NULL;
+  guint64 used=0;
+  append_memory_pmm_entries(content);
+  value=g_strstr_len(content->str, -1, key);
+  g_assert_nonnull(value);
+  used=g_ascii_strtoull(value + strlen(key), NULL, 10);
+  g_free(key);
+  g_string_free(content, TRUE);
+  return used;
+}
+
+static
+gpointer memory_wait_thread(gint *waited){
+  memory_wait(MEMORY_STREAM, 1024);
+  g_atomic_int_set(waited, 1);
+  return NULL;
+}
+
+static
+void test_memory_stream_files(){
+  GThread *thread=NULL;
+  gint waited=0;
+
+  // Accounted without waiting, even over the budget, and released once by name
+  memory_acquire_stream_file("test.t.00000.sql", 2 * 1024 * 1024);
+  g_assert_cmpuint(get_memory_used("stream"), ==, 2 * 1024 * 1024);
+  memory_release_stream_file("test.t.00000.sql");
+  g_assert_cmpuint(get_memory_used("stream"), ==, 0);
+  memory_release_stream_file("test.t.00000.sql");
+  memory_release_stream_file("test.t.00001.sql");
+  g_assert_cmpuint(get_memory_used("used"), ==, 0);
+
+  // The stream waits for the next file until the previous ones are released
+  memory_acquire_stream_file("test.t.00002.sql", 1024 * 1024);
+  thread=g_thread_new("memory_wait", (GThreadFunc)memory_wait_thread, &waited);
+  g_usleep(100000);
+  g_assert_cmpint(g_atomic_int_get(&waited), ==, 0);
+  memory_release_stream_file("test.t.00002.sql");
+  g_thread_join(thread);
+  g_assert_cmpint(waited, ==, 1);
+  g_assert_cmpuint(get_memory_used("used"), ==, 0);
+}
+
+/* A .dat file that no LOAD DATA is going to read is removed and released when it is received */
+static
+void test_memory_unread_load_data_file(){
+  GError *error=NULL;
+  gchar *path=NULL, *filename=NULL;
+  no_delete=FALSE;
+  no_data=TRUE;
+  directory=g_dir_make_tmp("myloader_test_XXXXXX", &error);
+  g_assert_no_error(error);
+  path=g_build_filename(directory, "test.t.00000.dat", NULL);
+  g_file_set_contents(path, "1\t2\n", -1, &error);
+  g_assert_no_error(error);
+  memory_acquire_stream_file("test.t.00000.dat", 4);
+  g_assert_cmpuint(get_memory_used("stream"), ==, 4);
+  filename=g_strdup("test.t.00000.dat");
+  process_load_data_filename(filename);
+  g_assert_cmpuint(get_memory_used("stream"), ==, 0);
+  g_assert_false(g_file_test(path, G_FILE_TEST_EXISTS));
+  no_data=FALSE;
+  g_rmdir(directory);
+  g_free(filename);
+  g_free(path);
+}
+
+int main(int argc, char *argv[]){
+  g_test_init(&argc, &argv, NULL);
+  initialize_common();
+  // The stream files are only released with --stream
+  stream=TRUE;
+  memory_budget=1;
+  initialize_memory_budget();
+  g_test_add_func("/myloader/split_file/every_boundary", test_split_file_every_boundary);
+  g_test_add_func("/myloader/split_file/pieces", test_split_file_pieces);
+  g_test_add_func("/myloader/split_file/seek_to_next_statement", test_seek_to_next_statement);
+  g_test_add_func("/myloader/sorted_ingest/key_ranges", test_key_ranges);
+  g_test_add_func("/myloader/memory/stream_files", test_memory_stream_files);
+  g_test_add_func("/myloader/memory/unread_load_data_file", test_memory_unread_load_data_file);
+  return g_test_run();
+}